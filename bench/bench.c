@@ -0,0 +1,271 @@
+#include "common.h"
+#include "core/download_engine.h"
+#include "core/format_planner.h"
+#include "core/metadata_fetcher.h"
+#include "core/ytdlp_manager.h"
+#include "utils/string_utils.h"
+#include <stdatomic.h>
+#include <time.h>
+
+// Micro-benchmarks for the hot paths: yt-dlp output parsing, argument
+// building, format planning, metadata JSON parsing and the string helpers.
+// Inputs are the recorded fixtures in bench/fixtures, so runs are offline
+// and repeatable.
+//
+// Usage: datareel-bench [FILTER]
+// Only benchmarks whose name contains FILTER are run. The fixture
+// directory can be overridden with DATAREEL_BENCH_FIXTURES.
+
+#define BENCH_MIN_TIME_NS (200 * 1000 * 1000LL)
+
+typedef void (*BenchFunc)(gpointer ctx);
+
+// Allocation counting by interposing the C allocator. GLib allocates
+// through malloc, so this covers g_malloc, g_strdup and friends.
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static _Atomic uint64_t allocation_count;
+
+void *malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t allocations(void) {
+    return atomic_load_explicit(&allocation_count, memory_order_relaxed);
+}
+#define HAVE_ALLOCATION_COUNT 1
+#else
+static uint64_t allocations(void) {
+    return 0;
+}
+#define HAVE_ALLOCATION_COUNT 0
+#endif
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Run func repeatedly for at least BENCH_MIN_TIME_NS. Each call performs
+// ops_per_call operations (e.g. lines of a log), results are per operation.
+static void bench_run(const char *filter, const char *name, BenchFunc func,
+                      gpointer ctx, int ops_per_call) {
+    if (filter && !strstr(name, filter)) return;
+
+    func(ctx);  // Warm up caches and lazily initialised state
+
+    int64_t iterations = 1;
+    int64_t elapsed;
+    uint64_t allocated;
+
+    for (;;) {
+        uint64_t alloc_start = allocations();
+        int64_t start = now_ns();
+        for (int64_t i = 0; i < iterations; i++) {
+            func(ctx);
+        }
+        elapsed = now_ns() - start;
+        allocated = allocations() - alloc_start;
+
+        if (elapsed >= BENCH_MIN_TIME_NS) break;
+        iterations *= 2;
+    }
+
+    double ops = (double)iterations * ops_per_call;
+    if (HAVE_ALLOCATION_COUNT) {
+        printf("%-28s %12.1f ns/op %10.2f allocs/op %12.0f ops\n",
+               name, elapsed / ops, allocated / ops, ops);
+    } else {
+        printf("%-28s %12.1f ns/op %16s %12.0f ops\n", name, elapsed / ops, "n/a", ops);
+    }
+}
+
+static char* load_fixture(const char *name, gsize *length) {
+    const char *dir = g_getenv("DATAREEL_BENCH_FIXTURES");
+    char *path = g_build_filename(dir ? dir : BENCH_FIXTURE_DIR, name, NULL);
+    char *contents = NULL;
+    GError *error = NULL;
+
+    if (!g_file_get_contents(path, &contents, length, &error)) {
+        g_printerr("Cannot load fixture: %s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+
+    g_free(path);
+    return contents;
+}
+
+// Progress parsing
+
+typedef struct {
+    char **lines;
+    int n_lines;
+    DownloadItem *item;
+} ProgressBench;
+
+static void bench_progress_lines(gpointer ctx) {
+    ProgressBench *bench = ctx;
+    for (int i = 0; i < bench->n_lines; i++) {
+        download_engine_parse_line(bench->item, bench->lines[i]);
+    }
+    // Each op starts from the same state, the tracked files don't pile up
+    if (bench->item->partial_files) {
+        g_ptr_array_set_size(bench->item->partial_files, 0);
+    }
+}
+
+// Argument building
+
+static void bench_build_args(gpointer ctx) {
+    DownloadOptions *opts = ctx;
+    int argc;
+    char **args = ytdlp_build_args("https://www.youtube.com/watch?v=dQw4w9WgXcQ",
+                                   "/tmp/datareel-bench", opts, NULL, &argc);
+    ytdlp_free_args(args);
+}
+
+// Format planning
+
+typedef struct {
+    GList *formats;
+    DownloadOptions *opts;
+} PlanBench;
+
+static void bench_format_plan(gpointer ctx) {
+    PlanBench *bench = ctx;
+    format_plan_free(format_planner_plan(bench->formats, bench->opts));
+}
+
+// Metadata parsing
+
+typedef struct {
+    char *json;
+    gsize length;
+} MetadataBench;
+
+static void bench_metadata_parse(gpointer ctx) {
+    MetadataBench *bench = ctx;
+    VideoMetadata *meta = metadata_parse_json(bench->json, bench->length, NULL);
+    metadata_free(meta);
+}
+
+static void bench_metadata_copy(gpointer ctx) {
+    metadata_free(metadata_copy(ctx));
+}
+
+// String utilities
+
+static const char *sample_title =
+    "Benchmark Fixture: Long Conference Talk | Full Session <4K> \"Remastered\"?";
+static const char *sample_url =
+    "https://www.youtube.com/watch?v=dQw4w9WgXcQ&list=PL0123456789&index=4";
+
+static void bench_sanitize_filename(gpointer ctx) {
+    (void)ctx;
+    g_free(string_sanitize_filename(sample_title));
+}
+
+static void bench_format_size(gpointer ctx) {
+    (void)ctx;
+    g_free(string_format_size(1857912345));
+}
+
+static void bench_extract_domain(gpointer ctx) {
+    (void)ctx;
+    g_free(string_extract_domain(sample_url));
+}
+
+static void bench_shell_escape(gpointer ctx) {
+    (void)ctx;
+    g_free(string_shell_escape(sample_title));
+}
+
+static void bench_replace_all(gpointer ctx) {
+    (void)ctx;
+    g_free(string_replace_all(sample_title, " ", "_"));
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+
+    // Keep the user's config out of the measurements
+    char *config_home = g_build_filename(g_get_tmp_dir(), "datareel-bench-config", NULL);
+    g_setenv("XDG_CONFIG_HOME", config_home, TRUE);
+    g_free(config_home);
+
+    gsize length;
+    char *log = load_fixture("progress.log", &length);
+    ProgressBench progress = { 0 };
+    // Lines keep their "\n", as g_io_channel_read_line() returns them
+    char **log_lines = g_strsplit(log, "\n", -1);
+    int n_log_lines = g_strv_length(log_lines);
+    if (n_log_lines > 0 && *log_lines[n_log_lines - 1] == '\0') {
+        n_log_lines--;
+    }
+    progress.lines = g_new0(char *, n_log_lines + 1);
+    for (int i = 0; i < n_log_lines; i++) {
+        progress.lines[i] = g_strconcat(log_lines[i], "\n", NULL);
+    }
+    progress.n_lines = n_log_lines;
+    g_strfreev(log_lines);
+    g_free(log);
+
+    DownloadOptions *item_opts = g_malloc0(sizeof(DownloadOptions));
+    progress.item = download_item_new(sample_url, "/tmp", item_opts);
+    progress.item->status = DOWNLOAD_STATUS_DOWNLOADING;
+
+    DownloadOptions opts = {
+        .quality = QUALITY_1080P,
+        .format = FORMAT_MKV,
+        .subtitles = TRUE,
+        .embed_thumbnail = TRUE,
+        .time_range_start = "00:01:30",
+        .time_range_end = "00:05:00",
+        .output_template = "%(title)s [%(id)s].%(ext)s",
+        .rate_limit = 4 * 1024 * 1024,
+        .concurrent_fragments = 4,
+        .http_chunk_size = 10 * 1024 * 1024,
+    };
+
+    MetadataBench metadata = { 0 };
+    metadata.json = load_fixture("metadata_large.json", &metadata.length);
+    VideoMetadata *parsed = metadata_parse_json(metadata.json, metadata.length, NULL);
+    if (!parsed) {
+        g_printerr("metadata_large.json does not parse\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_run(filter, "progress/line", bench_progress_lines, &progress, progress.n_lines);
+    bench_run(filter, "args/build", bench_build_args, &opts, 1);
+    PlanBench plan = { parsed->formats, &opts };
+    bench_run(filter, "format/plan", bench_format_plan, &plan, 1);
+    bench_run(filter, "metadata/parse", bench_metadata_parse, &metadata, 1);
+    bench_run(filter, "metadata/copy", bench_metadata_copy, parsed, 1);
+    bench_run(filter, "string/sanitize_filename", bench_sanitize_filename, NULL, 1);
+    bench_run(filter, "string/format_size", bench_format_size, NULL, 1);
+    bench_run(filter, "string/extract_domain", bench_extract_domain, NULL, 1);
+    bench_run(filter, "string/shell_escape", bench_shell_escape, NULL, 1);
+    bench_run(filter, "string/replace_all", bench_replace_all, NULL, 1);
+
+    metadata_free(parsed);
+    g_free(metadata.json);
+    download_item_free(progress.item);
+    g_strfreev(progress.lines);
+
+    return EXIT_SUCCESS;
+}
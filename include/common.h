@@ -42,11 +42,19 @@ typedef enum {
     DOWNLOAD_STATUS_QUEUED,
     DOWNLOAD_STATUS_DOWNLOADING,
     DOWNLOAD_STATUS_PROCESSING,
+    DOWNLOAD_STATUS_PAUSED,
     DOWNLOAD_STATUS_COMPLETED,
     DOWNLOAD_STATUS_FAILED,
     DOWNLOAD_STATUS_CANCELLED
 } DownloadStatus;
 
+// Priority class, used by the "priority" queue policy
+typedef enum {
+    DOWNLOAD_PRIORITY_NORMAL,
+    DOWNLOAD_PRIORITY_HIGH,
+    DOWNLOAD_PRIORITY_LOW
+} DownloadPriority;
+
 // Download options structure
 typedef struct {
     VideoQuality quality;
@@ -58,8 +66,14 @@ typedef struct {
     char *custom_format;
     char *time_range_start;  // e.g., "00:01:30"
     char *time_range_end;    // e.g., "00:05:00"
+    char **clips;            // "START-END" ranges cut from one download, NULL = none
     int max_downloads;       // For playlists
     char *output_template;
+    int64_t rate_limit;      // bytes per second, 0 = unlimited
+    int concurrent_fragments; // DASH/HLS fragments fetched in parallel, 0 = auto
+    int64_t http_chunk_size; // bytes per HTTP range request, 0 = not chunked
+    int64_t buffer_size;     // download buffer in bytes, 0 = yt-dlp default
+    DownloadPriority priority;
 } DownloadOptions;
 
 // Format information from yt-dlp
@@ -90,6 +104,8 @@ typedef struct {
     char *format_note;
     GList *formats;         // List of FormatInfo*
     char **available_qualities; // NULL-terminated array of quality strings
+    char *info_json;        // Raw --dump-json output of a prefetch, for --load-info-json
+    gint64 info_json_time;  // Monotonic time info_json was fetched
 } VideoMetadata;
 
 // Download item
@@ -107,6 +123,41 @@ typedef struct {
     int read_fd;           // For reading stdout/stderr
     GIOChannel *io_channel;
     guint io_watch_id;
+    guint child_watch_id;
+    gboolean child_exited;
+    int wait_status;       // Raw status from the child watch
+    int attempts;          // Number of times the process was started
+    gint64 next_attempt_time; // Monotonic time before which a retry must wait
+    const char *wait_reason;  // Why an item is held back, NULL if it isn't
+    gboolean stage_suspended; // Stopped until a slot in its stage frees up
+    const char *processing_step; // Current post-processor, e.g. "merging formats"
+    int fragment_concurrency; // Fragments chosen by the scheduler when options say auto
+    int64_t bytes_downloaded; // Transferred by the current attempt, all files
+    int64_t file_bytes;       // Transferred of the file currently downloading
+    gint64 added_time;        // Monotonic time the item was first queued
+    gint64 queued_time;       // Monotonic time the item last entered the queue
+    gint64 start_time;        // Monotonic time the process was started
+    gint64 first_output_time; // First output line, 0 until seen
+    gint64 first_progress_time; // First progress report, 0 until seen
+    gint64 last_progress_time;
+    gint64 last_activity_time; // Last sign of life seen by the stall watchdog
+    gint64 window_start_time;  // Start of the current throughput window
+    int64_t window_start_bytes;
+    gboolean cancel_requested; // SIGTERM sent, waiting for the group to exit
+    gboolean remove_partial;   // Delete partial files once cancellation completes
+    guint kill_timer_id;       // Escalates a pending cancellation to SIGKILL
+    GPtrArray *partial_files;  // Output files of the current entry, for cleanup
+    gboolean pause_requested;  // Terminated for a pause, finishes as PAUSED
+    DownloadStatus paused_stage; // Status to return to when a paused item resumes
+    gboolean resuming;         // Restarted after a pause, continues the .part files
+    char *domain;              // Host of the URL without "www.", NULL if unparsable
+    gboolean schedule_paused;  // Paused by a download window, not by the user
+    int64_t scheduled_rate_limit; // Rate set by a download window, -1 = the item's own
+    int queue_policy;          // QueuePolicy that picked the item, for metrics
+    char *info_json_path;      // Prefetched info handed to yt-dlp, removed when it exits
+    const struct DownloadBackend *backend; // Running the transfer, NULL while not started
+    gpointer backend_data;     // Owned by the backend while it runs
+    char *output_file;         // Final file of the current entry, as yt-dlp reported it
 } DownloadItem;
 
 // yt-dlp version info
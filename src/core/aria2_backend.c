@@ -0,0 +1,1718 @@
+#include "aria2_backend.h"
+#include "ytdlp_manager.h"
+#include "spawn.h"
+#include "resource_control.h"
+#include "work_pool.h"
+#include "../utils/config.h"
+#include "../utils/string_utils.h"
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define POLL_INTERVAL_MS 500
+#define WAITING_POLL_LIMIT 10000         // Queued parts asked for per poll, fragments included
+#define CONNECT_RETRY_MS 200
+#define CONNECT_ATTEMPTS 50             // 10 s for the daemon to start listening
+#define DAEMON_RETRY_US (60 * G_USEC_PER_SEC)
+#define MAX_RPC_PAYLOAD (64 * 1024 * 1024)
+#define JOIN_BUFFER_SIZE (1024 * 1024)
+
+typedef enum {
+    DAEMON_STOPPED,
+    DAEMON_STARTING,
+    DAEMON_READY
+} DaemonState;
+
+typedef enum {
+    TRANSFER_RESOLVING,     // yt-dlp picks the formats and their URLs
+    TRANSFER_WAITING,       // For the daemon to come up
+    TRANSFER_ADDING,        // addUri calls on their way
+    TRANSFER_RUNNING,       // The daemon downloads
+    TRANSFER_JOINING,       // Fragments are concatenated into their stream
+    TRANSFER_MERGING        // ffmpeg muxes the streams
+} TransferStage;
+
+typedef struct Aria2Transfer Aria2Transfer;
+
+// One file in the daemon: a whole stream, or one fragment of a DASH stream
+typedef struct {
+    Aria2Transfer *transfer;
+    char *url;
+    char *path;
+    char **headers;         // Borrowed from the stream
+    char *gid;              // Set while the daemon has it
+    int64_t completed;
+    int64_t counted;        // Part of completed reported to the item, -1 = not seen yet
+    int64_t total;
+    int64_t speed;
+    gboolean waiting;       // Queued in the daemon behind other downloads
+    gboolean done;
+} Aria2Part;
+
+typedef struct {
+    char *path;
+    char **headers;         // "Name: value"
+    int64_t size;           // From yt-dlp, 0 = unknown
+    gboolean fragmented;
+    GPtrArray *parts;       // Aria2Part, fragments in order
+} Aria2Stream;
+
+// A started item. Every pending callback holds a reference, so the
+// transfer outlives the item when that is freed mid-way.
+struct Aria2Transfer {
+    int refs;
+    DownloadItem *item;     // NULL once released
+    TransferStage stage;
+    gboolean stopping;
+    gboolean suspended;
+    gboolean finished;
+    GError *error;          // First failure
+
+    int64_t rate_limit;     // Per file, 0 = unlimited
+    char *path;             // Final file
+    GPtrArray *streams;     // Aria2Stream
+    int parts_active;       // Added to the daemon and not stopped yet
+
+    // yt-dlp resolving or ffmpeg merging
+    void (*process_done)(Aria2Transfer *transfer, gboolean success, const char *output);
+    pid_t pid;
+    GIOChannel *output;
+    GString *output_text;
+    guint output_watch_id;
+    guint child_watch_id;
+    gboolean child_exited;
+    gint wait_status;
+
+    GCancellable *cancellable;  // Joining
+    char *temp_path;            // Merging
+};
+
+typedef void (*RpcReplyFunc)(JsonNode *result, const char *error, gpointer user_data);
+
+typedef struct {
+    RpcReplyFunc func;
+    gpointer user_data;
+    GDestroyNotify destroy;
+} RpcCall;
+
+typedef struct {
+    Aria2Transfer *transfer;
+    GPtrArray *parts;       // Aria2Part, in the order of the calls
+} AddRequest;
+
+typedef struct {
+    char *path;
+    GPtrArray *fragments;   // Paths, in order
+} JoinJob;
+
+static DaemonState daemon_state = DAEMON_STOPPED;
+static GSubprocess *daemon_process = NULL;
+static char *daemon_secret = NULL;
+static char *daemon_conf_path = NULL;   // Holds the secret until aria2 has read it
+static int daemon_port = 0;
+static int connect_attempts = 0;
+static gint64 daemon_failed_until = 0;
+static SoupSession *rpc_session = NULL;
+static SoupWebsocketConnection *rpc_connection = NULL;
+static GHashTable *rpc_calls = NULL;    // Request id -> RpcCall
+static guint64 rpc_next_id = 1;
+static GHashTable *parts_by_gid = NULL; // Borrowed gid -> Aria2Part
+static GPtrArray *running = NULL;       // Aria2Transfer with parts in the daemon
+static GQueue waiting = G_QUEUE_INIT;   // Aria2Transfer, for the daemon to come up
+static guint poll_id = 0;
+static guint config_watch_id = 0;
+
+static void daemon_start(void);
+static void transfer_add(Aria2Transfer *transfer);
+static void transfer_check(Aria2Transfer *transfer);
+static void transfer_stop(Aria2Transfer *transfer, gboolean force);
+
+// --- Transfers ---
+
+static void part_free(Aria2Part *part) {
+    g_free(part->url);
+    g_free(part->path);
+    g_free(part->gid);
+    g_free(part);
+}
+
+static void stream_free(Aria2Stream *stream) {
+    g_ptr_array_unref(stream->parts);
+    g_strfreev(stream->headers);
+    g_free(stream->path);
+    g_free(stream);
+}
+
+static Aria2Transfer *transfer_ref(Aria2Transfer *transfer) {
+    transfer->refs++;
+    return transfer;
+}
+
+static void transfer_unref(Aria2Transfer *transfer) {
+    if (--transfer->refs > 0) return;
+
+    if (transfer->output_text) {
+        g_string_free(transfer->output_text, TRUE);
+    }
+    g_clear_object(&transfer->cancellable);
+    g_clear_error(&transfer->error);
+    if (transfer->streams) {
+        g_ptr_array_unref(transfer->streams);
+    }
+    g_free(transfer->temp_path);
+    g_free(transfer->path);
+    g_free(transfer);
+}
+
+static void transfer_for_each_part(Aria2Transfer *transfer, GFunc func, gpointer data) {
+    for (guint i = 0; transfer->streams && i < transfer->streams->len; i++) {
+        Aria2Stream *stream = g_ptr_array_index(transfer->streams, i);
+        g_ptr_array_foreach(stream->parts, func, data);
+    }
+}
+
+// The daemon no longer has the part, whatever the reason
+static void part_forget(gpointer data, gpointer user_data) {
+    Aria2Part *part = data;
+    (void)user_data;
+
+    if (!part->gid) return;
+    if (parts_by_gid) {
+        g_hash_table_remove(parts_by_gid, part->gid);
+    }
+    g_clear_pointer(&part->gid, g_free);
+    part->speed = 0;
+    part->transfer->parts_active--;
+}
+
+static void transfer_set_error(Aria2Transfer *transfer, GError *error) {
+    if (transfer->error) {
+        g_error_free(error);
+    } else {
+        transfer->error = error;
+    }
+}
+
+// Hand the outcome to the engine, once
+static void transfer_finish(Aria2Transfer *transfer) {
+    if (transfer->finished) return;
+    transfer->finished = TRUE;
+
+    transfer_for_each_part(transfer, part_forget, NULL);
+    if (g_queue_remove(&waiting, transfer)) {
+        transfer_unref(transfer);
+    }
+    if (running && g_ptr_array_remove(running, transfer)) {
+        transfer_unref(transfer);
+    }
+
+    if (!transfer->error && transfer->stopping) {
+        transfer->error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Interrupted");
+    }
+
+    DownloadItem *item = transfer->item;
+    if (item) {
+        item->process_id = -1;
+        item->backend_data = NULL;
+        item->speed = 0;
+        download_engine_backend_finished(item, transfer->error);
+    }
+
+    // The reference taken at the start
+    transfer_unref(transfer);
+}
+
+static gboolean transfer_finish_idle(gpointer data) {
+    Aria2Transfer *transfer = data;
+    transfer_finish(transfer);
+    transfer_unref(transfer);
+    return G_SOURCE_REMOVE;
+}
+
+static void transfer_finish_later(Aria2Transfer *transfer) {
+    g_idle_add(transfer_finish_idle, transfer_ref(transfer));
+}
+
+// Give the item to yt-dlp instead, e.g. for HLS formats
+static void transfer_fall_back(Aria2Transfer *transfer) {
+    DownloadItem *item = transfer->item;
+    if (!item) {
+        transfer_finish(transfer);
+        return;
+    }
+
+    transfer->finished = TRUE;
+    if (g_queue_remove(&waiting, transfer)) {
+        transfer_unref(transfer);
+    }
+    item->backend_data = NULL;
+    download_engine_fall_back(item);
+    transfer_unref(transfer);
+}
+
+// --- Helper processes (yt-dlp, ffmpeg) ---
+
+// Called once the output is drained and the child reaped
+static void process_maybe_done(Aria2Transfer *transfer) {
+    if (!transfer->child_exited || transfer->output_watch_id > 0) return;
+
+    transfer->pid = 0;
+    if (transfer->item) {
+        transfer->item->process_id = -1;
+    }
+
+    char *output = g_string_free(transfer->output_text, FALSE);
+    transfer->output_text = NULL;
+    gboolean success = g_spawn_check_wait_status(transfer->wait_status, NULL);
+
+    transfer->process_done(transfer, success, output);
+    g_free(output);
+    transfer_unref(transfer);
+}
+
+static gboolean on_process_output(GIOChannel *channel, GIOCondition cond, gpointer user_data) {
+    Aria2Transfer *transfer = user_data;
+
+    if (cond & G_IO_IN) {
+        char buffer[4096];
+        gsize length = 0;
+        GIOStatus status = g_io_channel_read_chars(channel, buffer, sizeof(buffer), &length, NULL);
+
+        if (status == G_IO_STATUS_NORMAL) {
+            g_string_append_len(transfer->output_text, buffer, length);
+            return TRUE;
+        } else if (status == G_IO_STATUS_AGAIN) {
+            return TRUE;
+        }
+    } else if (!(cond & (G_IO_HUP | G_IO_ERR))) {
+        return TRUE;
+    }
+
+    transfer->output_watch_id = 0;
+    g_io_channel_unref(transfer->output);
+    transfer->output = NULL;
+    process_maybe_done(transfer);
+    return FALSE;
+}
+
+static void on_process_exited(GPid pid, gint wait_status, gpointer user_data) {
+    Aria2Transfer *transfer = user_data;
+
+    // Nothing of a stopped group may outlive its leader
+    if (transfer->stopping) {
+        kill(-pid, SIGKILL);
+    }
+
+    transfer->child_watch_id = 0;
+    transfer->child_exited = TRUE;
+    transfer->wait_status = wait_status;
+    process_maybe_done(transfer);
+}
+
+// In its own process group like yt-dlp downloads, so resource control and
+// signals reach everything it starts
+static gboolean transfer_spawn(Aria2Transfer *transfer, char **argv, DownloadStatus stage,
+                               void (*done)(Aria2Transfer *, gboolean, const char *),
+                               GError **error) {
+    pid_t pid;
+    int output_fd;
+    if (!spawn_with_output(argv, &pid, &output_fd, error)) {
+        return FALSE;
+    }
+
+    transfer->pid = pid;
+    transfer->process_done = done;
+    transfer->child_exited = FALSE;
+    transfer->output_text = g_string_new(NULL);
+    transfer->output = g_io_channel_unix_new(output_fd);
+    g_io_channel_set_close_on_unref(transfer->output, TRUE);
+    g_io_channel_set_encoding(transfer->output, NULL, NULL);
+    g_io_channel_set_buffered(transfer->output, FALSE);
+
+    transfer_ref(transfer);
+    transfer->output_watch_id = g_io_add_watch(transfer->output, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                               on_process_output, transfer);
+    transfer->child_watch_id = g_child_watch_add(pid, on_process_exited, transfer);
+
+    if (transfer->item) {
+        transfer->item->process_id = pid;
+    }
+    resource_control_apply(pid, stage);
+    if (transfer->suspended) {
+        kill(-pid, SIGSTOP);
+    }
+    return TRUE;
+}
+
+// Last "ERROR:" line of yt-dlp, else the last line, e.g. ffmpeg's. yt-dlp's
+// reason is kept unprefixed, as the yt-dlp backend reports it.
+static GError *process_error(const char *program, const char *output) {
+    char **lines = g_strsplit(output, "\n", -1);
+    const char *reason = NULL;
+    gboolean error_line = FALSE;
+
+    for (int i = 0; lines[i] != NULL; i++) {
+        char *line = g_strstrip(lines[i]);
+        if (g_str_has_prefix(line, "ERROR:")) {
+            reason = g_strchug(line + strlen("ERROR:"));
+            error_line = TRUE;
+        } else if (*line && !error_line) {
+            reason = line;
+        }
+    }
+
+    GError *error = program
+        ? g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "%s: %s", program, reason ? reason : "failed")
+        : g_error_new_literal(G_IO_ERROR, G_IO_ERROR_FAILED, reason ? reason : "yt-dlp failed");
+    g_strfreev(lines);
+    return error;
+}
+
+// --- RPC ---
+
+static void rpc_call_free(RpcCall *call) {
+    if (call->destroy) {
+        call->destroy(call->user_data);
+    }
+    g_free(call);
+}
+
+static JsonArray *rpc_params_new(void) {
+    JsonArray *params = json_array_new();
+    char *token = g_strconcat("token:", daemon_secret, NULL);
+    json_array_add_string_element(params, token);
+    g_free(token);
+    return params;
+}
+
+// params is taken. Without a connection func is told so right away.
+static void rpc_call(const char *method, JsonArray *params, RpcReplyFunc func,
+                     gpointer user_data, GDestroyNotify destroy) {
+    RpcCall *call = g_malloc0(sizeof(RpcCall));
+    call->func = func;
+    call->user_data = user_data;
+    call->destroy = destroy;
+
+    if (daemon_state != DAEMON_READY) {
+        json_array_unref(params);
+        if (func) {
+            func(NULL, "aria2 is not running", user_data);
+        }
+        rpc_call_free(call);
+        return;
+    }
+
+    char *id = g_strdup_printf("%" G_GUINT64_FORMAT, rpc_next_id++);
+    JsonObject *request = json_object_new();
+    json_object_set_string_member(request, "jsonrpc", "2.0");
+    json_object_set_string_member(request, "id", id);
+    json_object_set_string_member(request, "method", method);
+    json_object_set_array_member(request, "params", params);
+
+    JsonNode *root = json_node_init_object(json_node_alloc(), request);
+    char *text = json_to_string(root, FALSE);
+    soup_websocket_connection_send_text(rpc_connection, text);
+    g_free(text);
+    json_node_unref(root);
+    json_object_unref(request);
+
+    g_hash_table_insert(rpc_calls, id, call);
+}
+
+// The same method for many gids in one round trip
+static void rpc_call_each(const char *method, GPtrArray *gids) {
+    if (gids->len == 0) return;
+
+    JsonArray *calls = json_array_new();
+    for (guint i = 0; i < gids->len; i++) {
+        JsonArray *params = rpc_params_new();
+        json_array_add_string_element(params, g_ptr_array_index(gids, i));
+
+        JsonObject *call = json_object_new();
+        json_object_set_string_member(call, "methodName", method);
+        json_object_set_array_member(call, "params", params);
+        json_array_add_object_element(calls, call);
+    }
+
+    JsonArray *params = json_array_new();
+    json_array_add_array_element(params, calls);
+    rpc_call("system.multicall", params, NULL, NULL, NULL);
+}
+
+static void collect_gid(gpointer data, gpointer user_data) {
+    Aria2Part *part = data;
+    if (part->gid) {
+        g_ptr_array_add(user_data, part->gid);
+    }
+}
+
+static void transfer_call_each(Aria2Transfer *transfer, const char *method) {
+    GPtrArray *gids = g_ptr_array_new();
+    transfer_for_each_part(transfer, collect_gid, gids);
+    rpc_call_each(method, gids);
+    g_ptr_array_unref(gids);
+}
+
+static int64_t json_int64_string(JsonObject *object, const char *member) {
+    const char *value = json_object_get_string_member_with_default(object, member, NULL);
+    return value ? g_ascii_strtoll(value, NULL, 10) : 0;
+}
+
+// aria2 words HTTP failures as "... status=403"; yt-dlp's wording keeps
+// the failure classification the same for both
+static GError *part_error(JsonObject *status) {
+    const char *message = json_object_get_string_member_with_default(status, "errorMessage",
+                                                                     "aria2 download failed");
+    const char *code = strstr(message, "status=");
+    if (code) {
+        return g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "HTTP Error %d: %s",
+                           atoi(code + strlen("status=")), message);
+    }
+    return g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "aria2: %s", message);
+}
+
+static void on_part_status(JsonNode *result, const char *error, gpointer user_data) {
+    Aria2Part *part = user_data;
+    Aria2Transfer *transfer = part->transfer;
+    if (transfer->finished) return;
+
+    JsonObject *status = result && JSON_NODE_HOLDS_OBJECT(result) ? json_node_get_object(result) : NULL;
+    const char *state = status ? json_object_get_string_member_with_default(status, "status", "") : "";
+
+    if (g_str_equal(state, "complete")) {
+        part->total = json_int64_string(status, "totalLength");
+        part->completed = part->total;
+        part->done = TRUE;
+
+        // Kept by force-save for resuming, useless now
+        char *control = g_strconcat(part->path, ".aria2", NULL);
+        unlink(control);
+        g_free(control);
+    } else if (!transfer->stopping) {
+        transfer_set_error(transfer, status ? part_error(status)
+                                            : g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                          "aria2: %s", error ? error : "no status"));
+    }
+
+    if (part->gid) {
+        JsonArray *params = rpc_params_new();
+        json_array_add_string_element(params, part->gid);
+        rpc_call("aria2.removeDownloadResult", params, NULL, NULL, NULL);
+    }
+    part_forget(part, NULL);
+
+    if (transfer->error && !transfer->stopping) {
+        transfer_stop(transfer, TRUE);
+    }
+    transfer_check(transfer);
+}
+
+static void part_call_done(gpointer data) {
+    transfer_unref(((Aria2Part *)data)->transfer);
+}
+
+static void on_rpc_notification(const char *method, JsonObject *message) {
+    JsonArray *params = json_object_has_member(message, "params")
+        ? json_object_get_array_member(message, "params") : NULL;
+    if (!params || json_array_get_length(params) == 0) return;
+
+    JsonObject *event = json_array_get_object_element(params, 0);
+    const char *gid = json_object_get_string_member_with_default(event, "gid", NULL);
+    Aria2Part *part = gid ? g_hash_table_lookup(parts_by_gid, gid) : NULL;
+    if (!part) return;
+
+    if (g_str_equal(method, "aria2.onDownloadComplete") ||
+        g_str_equal(method, "aria2.onDownloadError")) {
+        JsonArray *status_params = rpc_params_new();
+        json_array_add_string_element(status_params, gid);
+        JsonArray *keys = json_array_new();
+        json_array_add_string_element(keys, "status");
+        json_array_add_string_element(keys, "totalLength");
+        json_array_add_string_element(keys, "errorMessage");
+        json_array_add_array_element(status_params, keys);
+
+        // The part lives as long as its transfer
+        transfer_ref(part->transfer);
+        rpc_call("aria2.tellStatus", status_params, on_part_status, part, part_call_done);
+    } else if (g_str_equal(method, "aria2.onDownloadStop")) {
+        Aria2Transfer *transfer = part->transfer;
+        part_forget(part, NULL);
+        transfer_check(transfer);
+    }
+}
+
+static void on_rpc_message(SoupWebsocketConnection *connection, gint type, GBytes *message,
+                           gpointer user_data) {
+    (void)connection;
+    (void)user_data;
+    if (type != SOUP_WEBSOCKET_DATA_TEXT) return;
+
+    gsize length = 0;
+    const char *data = g_bytes_get_data(message, &length);
+    JsonParser *parser = json_parser_new();
+
+    if (json_parser_load_from_data(parser, data, length, NULL) &&
+        JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        JsonObject *object = json_node_get_object(json_parser_get_root(parser));
+        const char *method = json_object_get_string_member_with_default(object, "method", NULL);
+        const char *id = json_object_get_string_member_with_default(object, "id", NULL);
+        RpcCall *call = NULL;
+
+        if (method) {
+            on_rpc_notification(method, object);
+        } else if (id && g_hash_table_steal_extended(rpc_calls, id, NULL, (gpointer *)&call)) {
+            const char *error = NULL;
+            if (json_object_has_member(object, "error")) {
+                JsonObject *fault = json_object_get_object_member(object, "error");
+                error = json_object_get_string_member_with_default(fault, "message", "RPC error");
+            }
+            if (call->func) {
+                call->func(error ? NULL : json_object_get_member(object, "result"), error,
+                           call->user_data);
+            }
+            rpc_call_free(call);
+        }
+    }
+
+    g_object_unref(parser);
+}
+
+// --- Progress ---
+
+typedef struct {
+    int64_t bytes;
+    int64_t speed;
+    gboolean running;       // A part is in the daemon's active list or not known yet
+    gboolean waiting;
+} PartTotals;
+
+static void sum_part(gpointer data, gpointer user_data) {
+    Aria2Part *part = data;
+    PartTotals *totals = user_data;
+
+    if (part->counted < 0) {
+        // Resumed: bytes from the earlier run aren't new
+        part->counted = part->completed;
+    }
+    totals->bytes += part->completed;
+    totals->speed += part->speed;
+    totals->running |= !part->done && !part->waiting;
+    totals->waiting |= part->waiting;
+}
+
+// Share of a stream that is done: bytes for a whole file, parts for fragments
+static double stream_fraction(Aria2Stream *stream) {
+    double sum = 0;
+    for (guint i = 0; i < stream->parts->len; i++) {
+        Aria2Part *part = g_ptr_array_index(stream->parts, i);
+        if (part->done) {
+            sum += 1.0;
+        } else if (part->total > 0) {
+            sum += (double)part->completed / part->total;
+        }
+    }
+    return stream->parts->len > 0 ? sum / stream->parts->len : 1.0;
+}
+
+static void transfer_report(Aria2Transfer *transfer) {
+    DownloadItem *item = transfer->item;
+    if (!item) return;
+
+    // New bytes of every part, then totals
+    int64_t delta = 0;
+    PartTotals totals = { 0 };
+    gboolean sizes_known = TRUE;
+    for (guint i = 0; i < transfer->streams->len; i++) {
+        Aria2Stream *stream = g_ptr_array_index(transfer->streams, i);
+        g_ptr_array_foreach(stream->parts, sum_part, &totals);
+        for (guint j = 0; j < stream->parts->len; j++) {
+            Aria2Part *part = g_ptr_array_index(stream->parts, j);
+            delta += part->completed - part->counted;
+            part->counted = part->completed;
+        }
+        sizes_known &= stream->size > 0;
+    }
+
+    if (delta > 0) {
+        download_engine_add_bytes(item, delta);
+    } else if (!totals.running && totals.waiting) {
+        // Queued inside the daemon behind other downloads, not stalled. An
+        // active part without speed is a stall the watchdog has to see.
+        item->last_activity_time = g_get_monotonic_time();
+    }
+    item->file_bytes = totals.bytes;
+    item->speed = totals.speed;
+
+    // Streams weighted by their size when yt-dlp knows them all
+    double done = 0, weight = 0, remaining = 0;
+    for (guint i = 0; i < transfer->streams->len; i++) {
+        Aria2Stream *stream = g_ptr_array_index(transfer->streams, i);
+        double stream_weight = sizes_known ? stream->size : 1.0;
+        double fraction = stream_fraction(stream);
+        done += stream_weight * fraction;
+        weight += stream_weight;
+        remaining += stream_weight * (1.0 - fraction);
+    }
+    item->progress = weight > 0 ? 100.0 * done / weight : 0;
+
+    g_free(item->eta);
+    item->eta = sizes_known && item->speed >= 1.0
+        ? string_format_duration((int)(remaining / item->speed))
+        : NULL;
+}
+
+static void reset_speed(gpointer data, gpointer user_data) {
+    (void)user_data;
+    ((Aria2Part *)data)->speed = 0;
+}
+
+static JsonArray *status_keys_new(void) {
+    JsonArray *keys = json_array_new();
+    json_array_add_string_element(keys, "gid");
+    json_array_add_string_element(keys, "status");
+    json_array_add_string_element(keys, "completedLength");
+    json_array_add_string_element(keys, "totalLength");
+    json_array_add_string_element(keys, "downloadSpeed");
+    return keys;
+}
+
+static void update_part(JsonObject *status) {
+    const char *gid = json_object_get_string_member_with_default(status, "gid", NULL);
+    Aria2Part *part = gid ? g_hash_table_lookup(parts_by_gid, gid) : NULL;
+    if (!part) return;
+
+    part->waiting = g_strcmp0(json_object_get_string_member_with_default(status, "status", NULL),
+                              "waiting") == 0;
+    part->completed = json_int64_string(status, "completedLength");
+    part->total = json_int64_string(status, "totalLength");
+    part->speed = json_int64_string(status, "downloadSpeed");
+}
+
+static void on_active_status(JsonNode *result, const char *error, gpointer user_data) {
+    (void)user_data;
+    if (error || !result || !JSON_NODE_HOLDS_ARRAY(result) || !running) return;
+
+    JsonArray *active = json_node_get_array(result);
+    for (guint i = 0; i < json_array_get_length(active); i++) {
+        update_part(json_array_get_object_element(active, i));
+    }
+
+    for (guint i = 0; i < running->len; i++) {
+        transfer_report(g_ptr_array_index(running, i));
+    }
+}
+
+static void reset_waiting(gpointer data, gpointer user_data) {
+    (void)user_data;
+    ((Aria2Part *)data)->waiting = FALSE;
+}
+
+// The queue first, then the active list, so both are from the same poll
+static void on_waiting_status(JsonNode *result, const char *error, gpointer user_data) {
+    (void)user_data;
+    if (!running) return;
+
+    for (guint i = 0; i < running->len; i++) {
+        Aria2Transfer *transfer = g_ptr_array_index(running, i);
+        transfer_for_each_part(transfer, reset_speed, NULL);
+        transfer_for_each_part(transfer, reset_waiting, NULL);
+    }
+
+    if (!error && result && JSON_NODE_HOLDS_ARRAY(result)) {
+        JsonArray *queued = json_node_get_array(result);
+        for (guint i = 0; i < json_array_get_length(queued); i++) {
+            update_part(json_array_get_object_element(queued, i));
+        }
+    }
+
+    JsonArray *params = rpc_params_new();
+    json_array_add_array_element(params, status_keys_new());
+    rpc_call("aria2.tellActive", params, on_active_status, NULL, NULL);
+}
+
+// Two calls cover every running item: the daemon's queue, then its active list
+static gboolean on_poll(gpointer user_data) {
+    (void)user_data;
+    if (!running || running->len == 0) {
+        poll_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    JsonArray *params = rpc_params_new();
+    json_array_add_int_element(params, 0);
+    json_array_add_int_element(params, WAITING_POLL_LIMIT);
+    json_array_add_array_element(params, status_keys_new());
+    rpc_call("aria2.tellWaiting", params, on_waiting_status, NULL, NULL);
+    return G_SOURCE_CONTINUE;
+}
+
+// --- Joining and merging ---
+
+static void transfer_merge(Aria2Transfer *transfer);
+
+static void join_job_free(JoinJob *job) {
+    g_ptr_array_unref(job->fragments);
+    g_free(job->path);
+    g_free(job);
+}
+
+static gboolean join_fragments(JoinJob *job, GCancellable *cancellable, GError **error) {
+    char *part_path = g_strconcat(job->path, ".part", NULL);
+    FILE *out = fopen(part_path, "wb");
+    gboolean ok = out != NULL;
+    guint8 *buffer = g_malloc(JOIN_BUFFER_SIZE);
+
+    if (!out) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "Can't create %s: %s",
+                    part_path, g_strerror(errno));
+    }
+
+    for (guint i = 0; ok && i < job->fragments->len; i++) {
+        if (g_cancellable_set_error_if_cancelled(cancellable, error)) {
+            ok = FALSE;
+            break;
+        }
+
+        const char *fragment = g_ptr_array_index(job->fragments, i);
+        FILE *in = fopen(fragment, "rb");
+        if (!in) {
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "Can't read %s: %s",
+                        fragment, g_strerror(errno));
+            ok = FALSE;
+            break;
+        }
+
+        size_t length;
+        while (ok && (length = fread(buffer, 1, JOIN_BUFFER_SIZE, in)) > 0) {
+            if (fwrite(buffer, 1, length, out) != length) {
+                g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "Can't write: %s",
+                            g_strerror(errno));
+                ok = FALSE;
+            }
+        }
+        fclose(in);
+    }
+
+    if (out && fclose(out) != 0 && ok) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "Can't write: %s",
+                    g_strerror(errno));
+        ok = FALSE;
+    }
+    if (ok && rename(part_path, job->path) != 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "Can't rename %s: %s",
+                    part_path, g_strerror(errno));
+        ok = FALSE;
+    }
+
+    if (ok) {
+        for (guint i = 0; i < job->fragments->len; i++) {
+            unlink(g_ptr_array_index(job->fragments, i));
+        }
+    } else {
+        unlink(part_path);
+    }
+
+    g_free(buffer);
+    g_free(part_path);
+    return ok;
+}
+
+static void join_thread(GTask *task, gpointer source, gpointer task_data,
+                        GCancellable *cancellable) {
+    (void)source;
+    GPtrArray *jobs = task_data;
+    GError *error = NULL;
+
+    for (guint i = 0; i < jobs->len; i++) {
+        if (!join_fragments(g_ptr_array_index(jobs, i), cancellable, &error)) {
+            g_task_return_error(task, error);
+            return;
+        }
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_joined(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;
+    Aria2Transfer *transfer = user_data;
+    GError *error = NULL;
+
+    if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+        transfer_set_error(transfer, error);
+    }
+    if (transfer->error || transfer->stopping) {
+        transfer_finish(transfer);
+    } else {
+        transfer_merge(transfer);
+    }
+    transfer_unref(transfer);
+}
+
+// Concatenate DASH fragments into their stream off the main thread
+static void transfer_join(Aria2Transfer *transfer) {
+    GPtrArray *jobs = g_ptr_array_new_with_free_func((GDestroyNotify)join_job_free);
+
+    for (guint i = 0; i < transfer->streams->len; i++) {
+        Aria2Stream *stream = g_ptr_array_index(transfer->streams, i);
+        if (!stream->fragmented) continue;
+
+        JoinJob *job = g_malloc0(sizeof(JoinJob));
+        job->path = g_strdup(stream->path);
+        job->fragments = g_ptr_array_new_with_free_func(g_free);
+        for (guint j = 0; j < stream->parts->len; j++) {
+            Aria2Part *part = g_ptr_array_index(stream->parts, j);
+            g_ptr_array_add(job->fragments, g_strdup(part->path));
+        }
+        g_ptr_array_add(jobs, job);
+    }
+
+    if (jobs->len == 0) {
+        g_ptr_array_unref(jobs);
+        transfer_merge(transfer);
+        return;
+    }
+
+    transfer->stage = TRANSFER_JOINING;
+    transfer->cancellable = g_cancellable_new();
+    GTask *task = g_task_new(NULL, transfer->cancellable, on_joined, transfer_ref(transfer));
+    g_task_set_task_data(task, jobs, (GDestroyNotify)g_ptr_array_unref);
+    work_pool_run_task(WORK_LANE_BACKGROUND, task, join_thread);
+    g_object_unref(task);
+}
+
+static void on_merged(Aria2Transfer *transfer, gboolean success, const char *output) {
+    const char *temp_path = transfer->temp_path;
+
+    if (transfer->stopping) {
+        // Interrupted; finished below
+    } else if (!success) {
+        transfer_set_error(transfer, process_error("ffmpeg", output));
+    } else if (rename(temp_path, transfer->path) != 0) {
+        transfer_set_error(transfer, g_error_new(G_IO_ERROR, g_io_error_from_errno(errno),
+                                                 "Can't rename %s: %s", temp_path,
+                                                 g_strerror(errno)));
+    } else {
+        for (guint i = 0; i < transfer->streams->len; i++) {
+            unlink(((Aria2Stream *)g_ptr_array_index(transfer->streams, i))->path);
+        }
+    }
+
+    if (transfer->error || transfer->stopping) {
+        unlink(temp_path);
+    }
+    transfer_finish(transfer);
+}
+
+// Mux the streams with a stream copy, as yt-dlp's merger does
+static void transfer_merge(Aria2Transfer *transfer) {
+    if (transfer->streams->len < 2) {
+        transfer_finish(transfer);
+        return;
+    }
+
+    const char *ext = strrchr(transfer->path, '.');
+    int stem_length = ext ? (int)(ext - transfer->path) : (int)strlen(transfer->path);
+    transfer->temp_path = g_strdup_printf("%.*s.temp%s", stem_length, transfer->path, ext ? ext : "");
+
+    GPtrArray *argv = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(argv, g_strdup("ffmpeg"));
+    g_ptr_array_add(argv, g_strdup("-y"));
+    g_ptr_array_add(argv, g_strdup("-nostdin"));
+    g_ptr_array_add(argv, g_strdup("-loglevel"));
+    g_ptr_array_add(argv, g_strdup("error"));
+    for (guint i = 0; i < transfer->streams->len; i++) {
+        g_ptr_array_add(argv, g_strdup("-i"));
+        g_ptr_array_add(argv, g_strdup(((Aria2Stream *)g_ptr_array_index(transfer->streams, i))->path));
+    }
+    for (guint i = 0; i < transfer->streams->len; i++) {
+        g_ptr_array_add(argv, g_strdup("-map"));
+        g_ptr_array_add(argv, g_strdup_printf("%u", i));
+    }
+    g_ptr_array_add(argv, g_strdup("-c"));
+    g_ptr_array_add(argv, g_strdup("copy"));
+    g_ptr_array_add(argv, g_strdup(transfer->temp_path));
+    g_ptr_array_add(argv, NULL);
+
+    transfer->stage = TRANSFER_MERGING;
+    GError *error = NULL;
+    if (!transfer_spawn(transfer, (char **)argv->pdata, DOWNLOAD_STATUS_PROCESSING, on_merged,
+                        &error)) {
+        transfer_set_error(transfer, error);
+        transfer_finish(transfer);
+    } else if (transfer->item) {
+        download_engine_set_processing(transfer->item, "merging formats");
+    }
+    g_ptr_array_unref(argv);
+}
+
+// All parts have an outcome: go on, or report
+static void transfer_check(Aria2Transfer *transfer) {
+    if (transfer->finished || transfer->stage != TRANSFER_RUNNING || transfer->parts_active > 0) {
+        return;
+    }
+
+    if (transfer->error || transfer->stopping) {
+        transfer_finish(transfer);
+        return;
+    }
+
+    // Nothing left in the daemon to poll or to lose
+    transfer_report(transfer);
+    if (g_ptr_array_remove(running, transfer)) {
+        transfer_unref(transfer);
+    }
+    transfer_join(transfer);
+}
+
+// --- Adding to the daemon ---
+
+static void add_request_free(AddRequest *request) {
+    g_ptr_array_unref(request->parts);
+    transfer_unref(request->transfer);
+    g_free(request);
+}
+
+static void on_parts_added(JsonNode *result, const char *error, gpointer user_data) {
+    AddRequest *request = user_data;
+    Aria2Transfer *transfer = request->transfer;
+    if (transfer->finished) return;
+
+    JsonArray *results = result && JSON_NODE_HOLDS_ARRAY(result) ? json_node_get_array(result) : NULL;
+    for (guint i = 0; i < request->parts->len; i++) {
+        Aria2Part *part = g_ptr_array_index(request->parts, i);
+        JsonNode *answer = results && i < json_array_get_length(results)
+            ? json_array_get_element(results, i) : NULL;
+
+        // [gid] on success, a fault object otherwise
+        if (answer && JSON_NODE_HOLDS_ARRAY(answer) && json_array_get_length(json_node_get_array(answer)) > 0) {
+            part->gid = g_strdup(json_array_get_string_element(json_node_get_array(answer), 0));
+            g_hash_table_insert(parts_by_gid, part->gid, part);
+            transfer->parts_active++;
+        } else if (!transfer->error) {
+            const char *reason = error;
+            if (answer && JSON_NODE_HOLDS_OBJECT(answer)) {
+                reason = json_object_get_string_member_with_default(json_node_get_object(answer),
+                                                                    "faultString", NULL);
+            }
+            transfer->error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "aria2: %s",
+                                          reason ? reason : "adding the download failed");
+        }
+    }
+
+    transfer->stage = TRANSFER_RUNNING;
+    g_ptr_array_add(running, transfer_ref(transfer));
+    if (poll_id == 0) {
+        poll_id = g_timeout_add(POLL_INTERVAL_MS, on_poll, NULL);
+    }
+
+    if (transfer->error || transfer->stopping) {
+        transfer->stopping = TRUE;
+        transfer_call_each(transfer, "aria2.forceRemove");
+    } else if (transfer->suspended) {
+        transfer_call_each(transfer, "aria2.forcePause");
+    }
+    transfer_check(transfer);
+}
+
+static JsonObject *part_options(Aria2Part *part) {
+    JsonObject *options = json_object_new();
+    char *dir = g_path_get_dirname(part->path);
+    char *out = g_path_get_basename(part->path);
+
+    json_object_set_string_member(options, "dir", dir);
+    json_object_set_string_member(options, "out", out);
+    // Keep the control file when removed, so a pause can resume
+    json_object_set_string_member(options, "force-save", "true");
+    if (part->transfer->rate_limit > 0) {
+        char *limit = g_strdup_printf("%" G_GINT64_FORMAT, part->transfer->rate_limit);
+        json_object_set_string_member(options, "max-download-limit", limit);
+        g_free(limit);
+    }
+    if (part->headers && part->headers[0]) {
+        JsonArray *headers = json_array_new();
+        for (int i = 0; part->headers[i] != NULL; i++) {
+            json_array_add_string_element(headers, part->headers[i]);
+        }
+        json_object_set_array_member(options, "header", headers);
+    }
+
+    g_free(out);
+    g_free(dir);
+    return options;
+}
+
+// Hand every unfinished part to the daemon in one multicall
+static void transfer_add(Aria2Transfer *transfer) {
+    AddRequest *request = g_malloc0(sizeof(AddRequest));
+    request->transfer = transfer_ref(transfer);
+    request->parts = g_ptr_array_new();
+    JsonArray *calls = json_array_new();
+
+    for (guint i = 0; i < transfer->streams->len; i++) {
+        Aria2Stream *stream = g_ptr_array_index(transfer->streams, i);
+        for (guint j = 0; j < stream->parts->len; j++) {
+            Aria2Part *part = g_ptr_array_index(stream->parts, j);
+            char *control = g_strconcat(part->path, ".aria2", NULL);
+            GStatBuf file;
+            gboolean exists = g_stat(part->path, &file) == 0;
+
+            if (exists && !g_file_test(control, G_FILE_TEST_EXISTS)) {
+                // Finished by an earlier run
+                part->done = TRUE;
+                part->total = part->completed = part->counted = file.st_size;
+            } else if (!(stream->fragmented && g_file_test(stream->path, G_FILE_TEST_EXISTS))) {
+                part->counted = exists ? -1 : 0;
+
+                JsonArray *uris = json_array_new();
+                json_array_add_string_element(uris, part->url);
+                JsonArray *params = rpc_params_new();
+                json_array_add_array_element(params, uris);
+                json_array_add_object_element(params, part_options(part));
+
+                JsonObject *call = json_object_new();
+                json_object_set_string_member(call, "methodName", "aria2.addUri");
+                json_object_set_array_member(call, "params", params);
+                json_array_add_object_element(calls, call);
+                g_ptr_array_add(request->parts, part);
+            } else {
+                // Joined by an earlier run
+                part->done = TRUE;
+                part->counted = part->completed;
+            }
+            g_free(control);
+        }
+    }
+
+    transfer->stage = TRANSFER_ADDING;
+    JsonArray *params = json_array_new();
+    json_array_add_array_element(params, calls);
+    rpc_call("system.multicall", params, on_parts_added, request, (GDestroyNotify)add_request_free);
+}
+
+// --- Daemon ---
+
+static void on_config_changed(AppConfig *config, gpointer user_data) {
+    (void)user_data;
+    if (daemon_state != DAEMON_READY) return;
+
+    // Port and binary apply from the next daemon start
+    JsonObject *options = json_object_new();
+    char *value = g_strdup_printf("%dK", config->aria2_max_overall_kib);
+    json_object_set_string_member(options, "max-overall-download-limit", value);
+    g_free(value);
+    value = g_strdup_printf("%d", MAX(1, config->aria2_max_connections / config->aria2_connections_per_file));
+    json_object_set_string_member(options, "max-concurrent-downloads", value);
+    g_free(value);
+    value = g_strdup_printf("%d", config->aria2_connections_per_file);
+    json_object_set_string_member(options, "split", value);
+    json_object_set_string_member(options, "max-connection-per-server", value);
+    g_free(value);
+
+    JsonArray *params = rpc_params_new();
+    json_array_add_object_element(params, options);
+    rpc_call("aria2.changeGlobalOption", params, NULL, NULL, NULL);
+}
+
+static void daemon_conf_remove(void) {
+    if (daemon_conf_path) {
+        unlink(daemon_conf_path);
+        g_clear_pointer(&daemon_conf_path, g_free);
+    }
+}
+
+// The daemon is gone or never came up: running items fail, waiting ones
+// go to yt-dlp
+static void daemon_lost(const char *reason, gboolean start_failed) {
+    g_warning("aria2: %s", reason);
+    daemon_state = DAEMON_STOPPED;
+    daemon_conf_remove();
+    if (start_failed) {
+        daemon_failed_until = g_get_monotonic_time() + DAEMON_RETRY_US;
+    }
+
+    if (rpc_connection) {
+        g_signal_handlers_disconnect_matched(rpc_connection, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, NULL);
+        g_clear_object(&rpc_connection);
+    }
+    if (daemon_process) {
+        g_subprocess_force_exit(daemon_process);
+        g_clear_object(&daemon_process);
+    }
+
+    if (rpc_calls) {
+        GHashTableIter iter;
+        gpointer value;
+        GPtrArray *calls = g_ptr_array_new_with_free_func((GDestroyNotify)rpc_call_free);
+        g_hash_table_iter_init(&iter, rpc_calls);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            g_ptr_array_add(calls, value);
+            g_hash_table_iter_steal(&iter);
+        }
+        for (guint i = 0; i < calls->len; i++) {
+            RpcCall *call = g_ptr_array_index(calls, i);
+            if (call->func) {
+                call->func(NULL, reason, call->user_data);
+            }
+        }
+        g_ptr_array_unref(calls);
+    }
+
+    while (running && running->len > 0) {
+        Aria2Transfer *transfer = transfer_ref(g_ptr_array_index(running, 0));
+        transfer_for_each_part(transfer, part_forget, NULL);
+        transfer_set_error(transfer, g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "aria2: %s", reason));
+        transfer_finish(transfer);
+        transfer_unref(transfer);
+    }
+
+    Aria2Transfer *transfer;
+    while ((transfer = g_queue_pop_head(&waiting)) != NULL) {
+        transfer_fall_back(transfer);
+        transfer_unref(transfer);
+    }
+}
+
+static void on_daemon_exited(GObject *source, GAsyncResult *result, gpointer user_data) {
+    g_subprocess_wait_finish(G_SUBPROCESS(source), result, NULL);
+
+    if (G_SUBPROCESS(source) == daemon_process) {
+        gboolean starting = daemon_state == DAEMON_STARTING;
+        char *reason = g_strdup_printf("aria2c exited with status %d",
+                                       g_subprocess_get_if_exited(daemon_process)
+                                           ? g_subprocess_get_exit_status(daemon_process) : -1);
+        daemon_lost(reason, starting);
+        g_free(reason);
+    }
+    g_object_unref(user_data);
+}
+
+static void on_daemon_closed(SoupWebsocketConnection *connection, gpointer user_data) {
+    (void)connection;
+    (void)user_data;
+    daemon_lost("RPC connection closed", FALSE);
+}
+
+static gboolean daemon_connect(gpointer user_data);
+
+static void on_daemon_connected(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)user_data;
+    GError *error = NULL;
+    SoupWebsocketConnection *connection =
+        soup_session_websocket_connect_finish(SOUP_SESSION(source), result, &error);
+
+    if (daemon_state != DAEMON_STARTING) {
+        g_clear_error(&error);
+        g_clear_object(&connection);
+        return;
+    }
+
+    if (!connection) {
+        // Not listening yet
+        if (++connect_attempts < CONNECT_ATTEMPTS) {
+            g_timeout_add(CONNECT_RETRY_MS, daemon_connect, NULL);
+        } else {
+            char *reason = g_strdup_printf("no RPC answer: %s", error->message);
+            daemon_lost(reason, TRUE);
+            g_free(reason);
+        }
+        g_error_free(error);
+        return;
+    }
+
+    rpc_connection = connection;
+    soup_websocket_connection_set_max_incoming_payload_size(connection, MAX_RPC_PAYLOAD);
+    g_signal_connect(connection, "message", G_CALLBACK(on_rpc_message), NULL);
+    g_signal_connect(connection, "closed", G_CALLBACK(on_daemon_closed), NULL);
+    daemon_state = DAEMON_READY;
+    daemon_conf_remove();
+    g_print("aria2 daemon ready on port %d\n", daemon_port);
+
+    Aria2Transfer *transfer;
+    while (daemon_state == DAEMON_READY && (transfer = g_queue_pop_head(&waiting)) != NULL) {
+        transfer_add(transfer);
+        transfer_unref(transfer);
+    }
+}
+
+static gboolean daemon_connect(gpointer user_data) {
+    (void)user_data;
+    if (daemon_state != DAEMON_STARTING) return G_SOURCE_REMOVE;
+
+    char *url = g_strdup_printf("ws://127.0.0.1:%d/jsonrpc", daemon_port);
+    SoupMessage *msg = soup_message_new(SOUP_METHOD_GET, url);
+    soup_session_websocket_connect_async(rpc_session, msg, NULL, NULL, G_PRIORITY_DEFAULT, NULL,
+                                         on_daemon_connected, NULL);
+    g_object_unref(msg);
+    g_free(url);
+    return G_SOURCE_REMOVE;
+}
+
+// The secret goes to aria2 in a file only we can read: in argv every
+// local user would see it in ps
+static char *daemon_conf_write(GError **error) {
+    char *path = NULL;
+    int fd = g_file_open_tmp("datareel-aria2-XXXXXX.conf", &path, error);
+    if (fd < 0) return NULL;
+
+    char *contents = g_strdup_printf("rpc-secret=%s\n", daemon_secret);
+    gsize length = strlen(contents);
+    gboolean written = write(fd, contents, length) == (gssize)length;
+    int saved_errno = errno;
+    close(fd);
+    g_free(contents);
+
+    if (!written) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                    "Can't write %s: %s", path, g_strerror(saved_errno));
+        unlink(path);
+        g_free(path);
+        return NULL;
+    }
+    return path;
+}
+
+// One daemon for every item. It exits with us (--stop-with-process) even
+// if we crash.
+static void daemon_start(void) {
+    if (daemon_state != DAEMON_STOPPED || g_get_monotonic_time() < daemon_failed_until) {
+        return;
+    }
+
+    AppConfig *config = config_get();
+    char *binary = g_find_program_in_path(config->aria2_binary);
+    if (!binary) {
+        daemon_lost("aria2c not found", TRUE);
+        return;
+    }
+
+    if (!parts_by_gid) {
+        parts_by_gid = g_hash_table_new(g_str_hash, g_str_equal);
+        rpc_calls = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        running = g_ptr_array_new();
+        rpc_session = soup_session_new();
+        config_watch_id = config_add_watch(on_config_changed, NULL);
+    }
+
+    g_free(daemon_secret);
+    daemon_secret = g_uuid_string_random();
+    daemon_port = config->aria2_port;
+
+    GError *error = NULL;
+    daemon_conf_remove();
+    daemon_conf_path = daemon_conf_write(&error);
+    if (!daemon_conf_path) {
+        daemon_lost(error->message, TRUE);
+        g_error_free(error);
+        g_free(binary);
+        return;
+    }
+
+    int connections = config->aria2_connections_per_file;
+    GPtrArray *argv = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(argv, binary);
+    g_ptr_array_add(argv, g_strdup("--enable-rpc"));
+    g_ptr_array_add(argv, g_strdup("--rpc-listen-all=false"));
+    g_ptr_array_add(argv, g_strdup_printf("--rpc-listen-port=%d", daemon_port));
+    g_ptr_array_add(argv, g_strdup_printf("--conf-path=%s", daemon_conf_path));
+    g_ptr_array_add(argv, g_strdup("--rpc-max-request-size=64M"));
+    g_ptr_array_add(argv, g_strdup_printf("--stop-with-process=%d", (int)getpid()));
+    // The shared limits: files at once times connections each, and one rate
+    g_ptr_array_add(argv, g_strdup_printf("--max-concurrent-downloads=%d",
+                                          MAX(1, config->aria2_max_connections / connections)));
+    g_ptr_array_add(argv, g_strdup_printf("--split=%d", connections));
+    g_ptr_array_add(argv, g_strdup_printf("--max-connection-per-server=%d", connections));
+    g_ptr_array_add(argv, g_strdup_printf("--max-overall-download-limit=%dK",
+                                          config->aria2_max_overall_kib));
+    g_ptr_array_add(argv, g_strdup_printf("--max-tries=%d", config->ytdlp_retries + 1));
+    g_ptr_array_add(argv, g_strdup("--min-split-size=1M"));
+    g_ptr_array_add(argv, g_strdup("--continue=true"));
+    g_ptr_array_add(argv, g_strdup("--auto-file-renaming=false"));
+    g_ptr_array_add(argv, g_strdup("--file-allocation=none"));
+    g_ptr_array_add(argv, g_strdup("--quiet=true"));
+    g_ptr_array_add(argv, NULL);
+
+    daemon_process = g_subprocess_newv((const char * const *)argv->pdata,
+                                       G_SUBPROCESS_FLAGS_STDOUT_SILENCE |
+                                       G_SUBPROCESS_FLAGS_STDERR_SILENCE, &error);
+    g_ptr_array_unref(argv);
+
+    if (!daemon_process) {
+        daemon_lost(error->message, TRUE);
+        g_error_free(error);
+        return;
+    }
+
+    daemon_state = DAEMON_STARTING;
+    connect_attempts = 0;
+    g_subprocess_wait_async(daemon_process, NULL, on_daemon_exited, g_object_ref(daemon_process));
+    g_timeout_add(CONNECT_RETRY_MS, daemon_connect, NULL);
+}
+
+// --- Resolving ---
+
+static char **json_headers(JsonObject *format) {
+    GPtrArray *headers = g_ptr_array_new();
+
+    if (json_object_has_member(format, "http_headers")) {
+        JsonObject *object = json_object_get_object_member(format, "http_headers");
+        GList *names = json_object_get_members(object);
+        for (GList *l = names; l != NULL; l = l->next) {
+            g_ptr_array_add(headers, g_strdup_printf("%s: %s", (const char *)l->data,
+                json_object_get_string_member_with_default(object, l->data, "")));
+        }
+        g_list_free(names);
+    }
+
+    const char *cookies = json_object_get_string_member_with_default(format, "cookies", NULL);
+    if (cookies && *cookies) {
+        g_ptr_array_add(headers, g_strdup_printf("Cookie: %s", cookies));
+    }
+
+    g_ptr_array_add(headers, NULL);
+    return (char **)g_ptr_array_free(headers, FALSE);
+}
+
+static Aria2Part *part_new(Aria2Transfer *transfer, Aria2Stream *stream, const char *url,
+                           char *path) {
+    Aria2Part *part = g_malloc0(sizeof(Aria2Part));
+    part->transfer = transfer;
+    part->url = g_strdup(url);
+    part->path = path;
+    part->headers = stream->headers;
+    g_ptr_array_add(stream->parts, part);
+    return part;
+}
+
+// Plain HTTP formats are one part, DASH formats one part per fragment
+static Aria2Stream *stream_new(Aria2Transfer *transfer, JsonObject *format, char *path,
+                               GError **error) {
+    const char *protocol = json_object_get_string_member_with_default(format, "protocol", "https");
+    Aria2Stream *stream = g_malloc0(sizeof(Aria2Stream));
+    stream->path = path;
+    stream->headers = json_headers(format);
+    stream->size = json_object_get_int_member_with_default(format, "filesize", 0);
+    if (stream->size <= 0) {
+        stream->size = json_object_get_int_member_with_default(format, "filesize_approx", 0);
+    }
+    stream->parts = g_ptr_array_new_with_free_func((GDestroyNotify)part_free);
+
+    if (g_str_equal(protocol, "https") || g_str_equal(protocol, "http")) {
+        part_new(transfer, stream, json_object_get_string_member_with_default(format, "url", ""),
+                 g_strdup(path));
+    } else if (g_str_equal(protocol, "http_dash_segments") &&
+               json_object_has_member(format, "fragments")) {
+        const char *base = json_object_get_string_member_with_default(format, "fragment_base_url", "");
+        JsonArray *fragments = json_object_get_array_member(format, "fragments");
+
+        stream->fragmented = TRUE;
+        for (guint i = 0; i < json_array_get_length(fragments); i++) {
+            JsonObject *fragment = json_array_get_object_element(fragments, i);
+            const char *url = json_object_get_string_member_with_default(fragment, "url", NULL);
+            char *joined = url ? NULL : g_strconcat(base, json_object_get_string_member_with_default(
+                                                           fragment, "path", ""), NULL);
+            part_new(transfer, stream, url ? url : joined,
+                     g_strdup_printf("%s.part-Frag%u", path, i + 1));
+            g_free(joined);
+        }
+    } else {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "%s formats need yt-dlp", protocol);
+        stream_free(stream);
+        return NULL;
+    }
+
+    if (transfer->item) {
+        download_engine_track_file(transfer->item, path);
+    }
+    return stream;
+}
+
+// Streams to fetch from yt-dlp's info JSON: the requested formats of a
+// merge, named like yt-dlp names them ("Title.f137.mp4"), or the single format
+static gboolean transfer_plan(Aria2Transfer *transfer, const char *output, GError **error) {
+    // The JSON line, among any warnings
+    const char *start = g_str_has_prefix(output, "{") ? output : strstr(output, "\n{");
+    if (start && *start == '\n') start++;
+    const char *end = start ? strchr(start, '\n') : NULL;
+    char *json = start ? g_strndup(start, end ? (gsize)(end - start) : strlen(start)) : NULL;
+    JsonParser *parser = json_parser_new();
+
+    if (!json || !json_parser_load_from_data(parser, json, -1, error) ||
+        !JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        if (error && !*error) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "yt-dlp: no format information");
+        }
+        g_object_unref(parser);
+        g_free(json);
+        return FALSE;
+    }
+
+    JsonObject *info = json_node_get_object(json_parser_get_root(parser));
+    const char *path = json_object_get_string_member_with_default(info, "filename",
+                           json_object_get_string_member_with_default(info, "_filename", NULL));
+    if (!path) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "yt-dlp: no file name");
+        g_object_unref(parser);
+        g_free(json);
+        return FALSE;
+    }
+
+    transfer->path = g_strdup(path);
+    transfer->streams = g_ptr_array_new_with_free_func((GDestroyNotify)stream_free);
+
+    JsonArray *formats = json_object_has_member(info, "requested_formats")
+        ? json_object_get_array_member(info, "requested_formats") : NULL;
+    guint count = formats ? json_array_get_length(formats) : 1;
+    const char *ext = strrchr(path, '.');
+    int stem_length = ext ? (int)(ext - path) : (int)strlen(path);
+    gboolean ok = TRUE;
+
+    for (guint i = 0; ok && i < count; i++) {
+        JsonObject *format = formats ? json_array_get_object_element(formats, i) : info;
+        char *stream_path = count == 1 ? g_strdup(path)
+            : g_strdup_printf("%.*s.f%s.%s", stem_length, path,
+                              json_object_get_string_member_with_default(format, "format_id", "0"),
+                              json_object_get_string_member_with_default(format, "ext", "bin"));
+
+        Aria2Stream *stream = stream_new(transfer, format, stream_path, error);
+        if (stream) {
+            g_ptr_array_add(transfer->streams, stream);
+        } else {
+            g_free(stream_path);
+            ok = FALSE;
+        }
+    }
+    if (ok && count > 1 && transfer->item) {
+        download_engine_track_file(transfer->item, path);
+    }
+
+    g_object_unref(parser);
+    g_free(json);
+    return ok;
+}
+
+static void on_resolved(Aria2Transfer *transfer, gboolean success, const char *output) {
+    GError *error = NULL;
+    DownloadItem *item = transfer->item;
+
+    // The prefetched info has served its purpose
+    if (item && item->info_json_path) {
+        unlink(item->info_json_path);
+        g_clear_pointer(&item->info_json_path, g_free);
+    }
+
+    if (transfer->stopping) {
+        transfer_finish(transfer);
+        return;
+    }
+    if (!success) {
+        transfer_set_error(transfer, process_error(NULL, output));
+        transfer_finish(transfer);
+        return;
+    }
+    if (!transfer_plan(transfer, output, &error)) {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+            g_debug("%s: %s", item ? item->url : "", error->message);
+            g_error_free(error);
+            transfer_fall_back(transfer);
+        } else {
+            transfer_set_error(transfer, error);
+            transfer_finish(transfer);
+        }
+        return;
+    }
+
+    daemon_start();
+    if (daemon_state == DAEMON_READY) {
+        transfer_add(transfer);
+    } else if (daemon_state == DAEMON_STARTING) {
+        transfer->stage = TRANSFER_WAITING;
+        g_queue_push_tail(&waiting, transfer_ref(transfer));
+    } else {
+        transfer_fall_back(transfer);
+    }
+}
+
+// --- Backend ---
+
+// Everything but a merge of the chosen formats stays with yt-dlp
+static gboolean aria2_backend_accepts(const DownloadItem *item) {
+    const DownloadOptions *opts = item->options;
+    if (!config_get()->aria2_downloads || g_get_monotonic_time() < daemon_failed_until) {
+        return FALSE;
+    }
+    if (opts->audio_only || opts->subtitles || opts->embed_thumbnail || opts->playlist ||
+        (opts->time_range_start && *opts->time_range_start) || opts->clips) {
+        return FALSE;
+    }
+
+    // A re-encode is left to yt-dlp's post-processing
+    FormatPlan *plan = format_planner_plan(item->metadata ? item->metadata->formats : NULL, opts);
+    gboolean transcode = plan && plan->transcode;
+    format_plan_free(plan);
+    return !transcode;
+}
+
+// yt-dlp with the item's own arguments plus -j: the chosen formats, their
+// URLs and headers, and the file name, without downloading
+static gboolean aria2_backend_start(DownloadItem *item, GError **error) {
+    DownloadOptions effective = *item->options;
+    if (item->scheduled_rate_limit >= 0) {
+        effective.rate_limit = item->scheduled_rate_limit;
+    }
+
+    FormatPlan *plan = download_engine_plan_formats(item);
+    int argc;
+    char **args = ytdlp_build_args(item->url, item->output_path, &effective, plan, &argc);
+    format_plan_free(plan);
+    args = g_renew(char *, args, argc + 2);
+    args[argc] = args[argc - 1];
+    args[argc - 1] = g_strdup("-j");
+    args[argc + 1] = NULL;
+    args = download_engine_use_prefetched_info(item, args, argc + 1);
+
+    Aria2Transfer *transfer = g_malloc0(sizeof(Aria2Transfer));
+    transfer->refs = 1;
+    transfer->item = item;
+    transfer->stage = TRANSFER_RESOLVING;
+    transfer->rate_limit = effective.rate_limit;
+
+    gboolean spawned = transfer_spawn(transfer, args, DOWNLOAD_STATUS_DOWNLOADING, on_resolved,
+                                      error);
+    ytdlp_free_args(args);
+    if (!spawned) {
+        transfer_unref(transfer);
+        return FALSE;
+    }
+
+    item->backend_data = transfer;
+    // Comes up while yt-dlp resolves
+    daemon_start();
+    g_print("Resolving for aria2: %s\n", item->url);
+    return TRUE;
+}
+
+static void transfer_signal(Aria2Transfer *transfer, int signal) {
+    if (transfer->pid > 0 && !transfer->child_exited) {
+        kill(-transfer->pid, signal);
+    }
+}
+
+static void transfer_stop(Aria2Transfer *transfer, gboolean force) {
+    if (transfer->finished) return;
+    gboolean first = !transfer->stopping;
+    transfer->stopping = TRUE;
+
+    switch (transfer->stage) {
+        case TRANSFER_RESOLVING:
+        case TRANSFER_MERGING:
+            transfer_signal(transfer, force ? SIGKILL : SIGTERM);
+            transfer_signal(transfer, SIGCONT);
+            break;
+        case TRANSFER_WAITING:
+            if (g_queue_remove(&waiting, transfer)) {
+                transfer_unref(transfer);
+                transfer_finish_later(transfer);
+            }
+            break;
+        case TRANSFER_ADDING:
+            // Removed as soon as the gids are known
+            break;
+        case TRANSFER_RUNNING:
+            if (daemon_state == DAEMON_READY && transfer->parts_active > 0) {
+                transfer_call_each(transfer, force ? "aria2.forceRemove" : "aria2.remove");
+            } else if (first) {
+                transfer_finish_later(transfer);
+            }
+            break;
+        case TRANSFER_JOINING:
+            g_cancellable_cancel(transfer->cancellable);
+            break;
+    }
+}
+
+static gboolean aria2_backend_terminate(DownloadItem *item) {
+    Aria2Transfer *transfer = item->backend_data;
+    if (!transfer) return FALSE;
+    transfer_stop(transfer, FALSE);
+    return TRUE;
+}
+
+static gboolean aria2_backend_kill(DownloadItem *item) {
+    Aria2Transfer *transfer = item->backend_data;
+    if (!transfer) return FALSE;
+    transfer_stop(transfer, TRUE);
+    return TRUE;
+}
+
+static gboolean aria2_backend_set_suspended(DownloadItem *item, gboolean suspended) {
+    Aria2Transfer *transfer = item->backend_data;
+    if (!transfer) return FALSE;
+
+    transfer->suspended = suspended;
+    if (transfer->stage == TRANSFER_RESOLVING || transfer->stage == TRANSFER_MERGING) {
+        transfer_signal(transfer, suspended ? SIGSTOP : SIGCONT);
+    } else if (transfer->stage == TRANSFER_RUNNING) {
+        transfer_call_each(transfer, suspended ? "aria2.forcePause" : "aria2.unpause");
+    }
+    // Waiting and adding transfers pick the flag up later
+    return TRUE;
+}
+
+static gboolean aria2_backend_suspend(DownloadItem *item) {
+    return aria2_backend_set_suspended(item, TRUE);
+}
+
+static gboolean aria2_backend_resume(DownloadItem *item) {
+    return aria2_backend_set_suspended(item, FALSE);
+}
+
+static void aria2_backend_release(DownloadItem *item) {
+    Aria2Transfer *transfer = item->backend_data;
+    if (!transfer) return;
+
+    transfer->item = NULL;
+    item->backend_data = NULL;
+    transfer_stop(transfer, TRUE);
+}
+
+const DownloadBackend aria2_backend = {
+    .name = "aria2",
+    .accepts = aria2_backend_accepts,
+    .start = aria2_backend_start,
+    .terminate = aria2_backend_terminate,
+    .kill = aria2_backend_kill,
+    .suspend = aria2_backend_suspend,
+    .resume = aria2_backend_resume,
+    .release = aria2_backend_release,
+};
+
+void aria2_backend_cleanup(void) {
+    if (config_watch_id > 0) {
+        config_remove_watch(config_watch_id);
+        config_watch_id = 0;
+    }
+    if (poll_id > 0) {
+        g_source_remove(poll_id);
+        poll_id = 0;
+    }
+
+    // SIGTERM lets aria2 write its control files for the next run
+    if (rpc_connection) {
+        g_signal_handlers_disconnect_matched(rpc_connection, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, NULL);
+        soup_websocket_connection_close(rpc_connection, SOUP_WEBSOCKET_CLOSE_NORMAL, NULL);
+        g_clear_object(&rpc_connection);
+    }
+    if (daemon_process) {
+        g_subprocess_send_signal(daemon_process, SIGTERM);
+        g_clear_object(&daemon_process);
+    }
+    daemon_state = DAEMON_STOPPED;
+    daemon_conf_remove();
+    g_clear_object(&rpc_session);
+    g_clear_pointer(&daemon_secret, g_free);
+}
@@ -0,0 +1,17 @@
+#ifndef ARIA2_BACKEND_H
+#define ARIA2_BACKEND_H
+
+#include "download_backend.h"
+
+// Hands the media URLs yt-dlp resolves to one shared aria2c daemon, started
+// on demand and driven over JSON-RPC on a local WebSocket ([aria2] in the
+// config). The daemon enforces the connection and rate limits for all
+// these downloads together; progress is polled over RPC and completion
+// arrives as RPC notifications. Formats aria2 can't fetch (HLS, ...) and
+// items needing post-processing other than a merge stay with yt-dlp.
+extern const DownloadBackend aria2_backend;
+
+// Stop the daemon
+void aria2_backend_cleanup(void);
+
+#endif
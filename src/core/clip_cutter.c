@@ -0,0 +1,425 @@
+#include "clip_cutter.h"
+#include "spawn.h"
+#include "resource_control.h"
+#include "../utils/config.h"
+#include "../utils/string_utils.h"
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUTPUT_TAIL_MAX 4096
+
+typedef struct ClipJob ClipJob;
+
+typedef struct {
+    ClipJob *job;
+    int start;              // Seconds into the source file
+    int duration;           // -1 = until the end
+    char *path;
+    char *temp_path;
+    pid_t pid;
+    GIOChannel *output;
+    GString *output_tail;   // Last bytes of ffmpeg's output, for errors
+    guint output_watch_id;
+    guint child_watch_id;
+    gboolean exited;
+    gint wait_status;
+} ClipTask;
+
+struct ClipJob {
+    DownloadItem *item;     // NULL once released
+    char *source;
+    gboolean keep_source;
+    GPtrArray *tasks;       // ClipTask, in the order given
+    guint next;             // First task not started
+    int running;
+    int limit;              // ffmpeg processes at once
+    gboolean stopping;
+    gboolean suspended;
+    GError *error;
+};
+
+// "1:02:03", "62:03" or "3723"; -1 for anything else
+static int parse_time(const char *text) {
+    if (!*text) return -1;
+    for (const char *p = text; *p; p++) {
+        if (!g_ascii_isdigit(*p) && *p != ':') return -1;
+    }
+    return string_parse_time(text);
+}
+
+gboolean clip_parse_range(const char *range, int *start, int *end) {
+    char **bounds = g_strsplit(range, "-", 2);
+    gboolean ok = FALSE;
+
+    if (bounds[0] && bounds[1]) {
+        char *first = g_strstrip(bounds[0]);
+        char *second = g_strstrip(bounds[1]);
+        *start = parse_time(first);
+        *end = (*second == '\0' || g_ascii_strcasecmp(second, "inf") == 0) ? -1 : parse_time(second);
+        ok = *start >= 0 && (*end < 0 ? *second == '\0' || g_ascii_strcasecmp(second, "inf") == 0
+                                      : *end > *start);
+    }
+
+    g_strfreev(bounds);
+    return ok;
+}
+
+gboolean clip_cover(char * const *clips, int *start, int *end) {
+    if (!clips || !clips[0]) return FALSE;
+
+    *start = G_MAXINT;
+    *end = 0;
+    for (int i = 0; clips[i] != NULL; i++) {
+        int clip_start, clip_end;
+        if (!clip_parse_range(clips[i], &clip_start, &clip_end)) return FALSE;
+
+        *start = MIN(*start, clip_start);
+        if (clip_end < 0 || *end < 0) {
+            *end = -1;
+        } else {
+            *end = MAX(*end, clip_end);
+        }
+    }
+    return TRUE;
+}
+
+static void clip_task_free(ClipTask *task) {
+    if (task->output_watch_id > 0) {
+        g_source_remove(task->output_watch_id);
+    }
+    if (task->output) {
+        g_io_channel_unref(task->output);
+    }
+    if (task->output_tail) {
+        g_string_free(task->output_tail, TRUE);
+    }
+    g_free(task->path);
+    g_free(task->temp_path);
+    g_free(task);
+}
+
+static void clip_job_free(ClipJob *job) {
+    g_ptr_array_unref(job->tasks);
+    g_clear_error(&job->error);
+    g_free(job->source);
+    g_free(job);
+}
+
+// "Title.source-600-4200.mp4" -> "Title [00.12.30-00.13.10].mp4"
+static char *clip_path(const char *source, int start, int end) {
+    char *dir = g_path_get_dirname(source);
+    char *name = g_path_get_basename(source);
+    char *ext = strrchr(name, '.');
+    char *suffix = ext ? g_strdup(ext) : g_strdup("");
+    if (ext) *ext = '\0';
+
+    char *source_mark = g_strrstr(name, ".source-");
+    if (source_mark) *source_mark = '\0';
+
+    char *end_text = end >= 0 ? g_strdup_printf("%02d.%02d.%02d", end / 3600, end / 60 % 60, end % 60)
+                              : g_strdup("end");
+    char *clip_name = g_strdup_printf("%s [%02d.%02d.%02d-%s]%s", name, start / 3600,
+                                      start / 60 % 60, start % 60, end_text, suffix);
+    char *path = g_build_filename(dir, clip_name, NULL);
+
+    g_free(clip_name);
+    g_free(end_text);
+    g_free(suffix);
+    g_free(name);
+    g_free(dir);
+    return path;
+}
+
+static void clip_job_pump(ClipJob *job);
+
+static void clip_job_signal(ClipJob *job, int signal) {
+    for (guint i = 0; i < job->next; i++) {
+        ClipTask *task = g_ptr_array_index(job->tasks, i);
+        if (task->pid > 0 && !task->exited) {
+            kill(-task->pid, signal);
+        }
+    }
+}
+
+static void clip_job_stop(ClipJob *job, int signal) {
+    job->stopping = TRUE;
+    clip_job_signal(job, signal);
+    // A stopped ffmpeg only acts on SIGTERM once continued
+    clip_job_signal(job, SIGCONT);
+}
+
+static void clip_task_done(ClipTask *task) {
+    ClipJob *job = task->job;
+    GError *error = NULL;
+
+    task->pid = 0;
+    if (job->stopping) {
+        unlink(task->temp_path);
+    } else if (!g_spawn_check_wait_status(task->wait_status, NULL)) {
+        char *reason = g_strstrip(g_strdup(task->output_tail->str));
+        char *last_line = strrchr(reason, '\n');
+        error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "ffmpeg: %s",
+                            last_line ? last_line + 1 : *reason ? reason : "cutting a clip failed");
+        g_free(reason);
+        unlink(task->temp_path);
+    } else if (rename(task->temp_path, task->path) != 0) {
+        error = g_error_new(G_IO_ERROR, g_io_error_from_errno(errno), "Can't rename %s: %s",
+                            task->temp_path, g_strerror(errno));
+    } else {
+        g_print("Clip written: %s\n", task->path);
+    }
+
+    if (error) {
+        if (!job->error) {
+            job->error = error;
+        } else {
+            g_error_free(error);
+        }
+        // The job has failed; the other cuts are wasted work
+        clip_job_stop(job, SIGTERM);
+    }
+
+    job->running--;
+    clip_job_pump(job);
+}
+
+static void clip_task_maybe_done(ClipTask *task) {
+    if (task->exited && task->output_watch_id == 0) {
+        clip_task_done(task);
+    }
+}
+
+static gboolean on_clip_output(GIOChannel *channel, GIOCondition cond, gpointer user_data) {
+    ClipTask *task = user_data;
+
+    if (cond & G_IO_IN) {
+        char buffer[1024];
+        gsize length = 0;
+        GIOStatus status = g_io_channel_read_chars(channel, buffer, sizeof(buffer), &length, NULL);
+
+        if (status == G_IO_STATUS_NORMAL) {
+            g_string_append_len(task->output_tail, buffer, length);
+            if (task->output_tail->len > OUTPUT_TAIL_MAX) {
+                g_string_erase(task->output_tail, 0, task->output_tail->len - OUTPUT_TAIL_MAX);
+            }
+            return TRUE;
+        } else if (status == G_IO_STATUS_AGAIN) {
+            return TRUE;
+        }
+    } else if (!(cond & (G_IO_HUP | G_IO_ERR))) {
+        return TRUE;
+    }
+
+    task->output_watch_id = 0;
+    g_io_channel_unref(task->output);
+    task->output = NULL;
+    clip_task_maybe_done(task);
+    return FALSE;
+}
+
+static void on_clip_exited(GPid pid, gint wait_status, gpointer user_data) {
+    ClipTask *task = user_data;
+    (void)pid;
+
+    task->child_watch_id = 0;
+    task->exited = TRUE;
+    task->wait_status = wait_status;
+    clip_task_maybe_done(task);
+}
+
+// Stream copy from the keyframe at or before the start; the source is read
+// once per clip, but only from local disk
+static gboolean clip_task_spawn(ClipTask *task, GError **error) {
+    ClipJob *job = task->job;
+    GPtrArray *argv = g_ptr_array_new_with_free_func(g_free);
+
+    g_ptr_array_add(argv, g_strdup("ffmpeg"));
+    g_ptr_array_add(argv, g_strdup("-y"));
+    g_ptr_array_add(argv, g_strdup("-nostdin"));
+    g_ptr_array_add(argv, g_strdup("-loglevel"));
+    g_ptr_array_add(argv, g_strdup("error"));
+    g_ptr_array_add(argv, g_strdup("-ss"));
+    g_ptr_array_add(argv, g_strdup_printf("%d", task->start));
+    g_ptr_array_add(argv, g_strdup("-i"));
+    g_ptr_array_add(argv, g_strdup(job->source));
+    if (task->duration > 0) {
+        g_ptr_array_add(argv, g_strdup("-t"));
+        g_ptr_array_add(argv, g_strdup_printf("%d", task->duration));
+    }
+    g_ptr_array_add(argv, g_strdup("-map"));
+    g_ptr_array_add(argv, g_strdup("0"));
+    g_ptr_array_add(argv, g_strdup("-c"));
+    g_ptr_array_add(argv, g_strdup("copy"));
+    g_ptr_array_add(argv, g_strdup("-avoid_negative_ts"));
+    g_ptr_array_add(argv, g_strdup("make_zero"));
+    g_ptr_array_add(argv, g_strdup(task->temp_path));
+    g_ptr_array_add(argv, NULL);
+
+    int output_fd;
+    gboolean spawned = spawn_with_output((char **)argv->pdata, &task->pid, &output_fd, error);
+    g_ptr_array_unref(argv);
+    if (!spawned) {
+        return FALSE;
+    }
+
+    task->output_tail = g_string_new(NULL);
+    task->output = g_io_channel_unix_new(output_fd);
+    g_io_channel_set_close_on_unref(task->output, TRUE);
+    g_io_channel_set_encoding(task->output, NULL, NULL);
+    g_io_channel_set_buffered(task->output, FALSE);
+    task->output_watch_id = g_io_add_watch(task->output, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                           on_clip_output, task);
+    task->child_watch_id = g_child_watch_add(task->pid, on_clip_exited, task);
+
+    resource_control_apply(task->pid, DOWNLOAD_STATUS_PROCESSING);
+    if (job->suspended) {
+        kill(-task->pid, SIGSTOP);
+    }
+    return TRUE;
+}
+
+static void clip_job_done(ClipJob *job) {
+    if (!job->error && job->stopping) {
+        job->error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Interrupted");
+    }
+
+    // The source was only fetched to cut from
+    if (!job->error && !job->keep_source) {
+        unlink(job->source);
+    }
+
+    DownloadItem *item = job->item;
+    if (item) {
+        item->backend_data = NULL;
+        download_engine_backend_finished(item, job->error);
+    }
+    clip_job_free(job);
+}
+
+// Keep up to the limit of cuts running; report once none are left
+static void clip_job_pump(ClipJob *job) {
+    while (!job->stopping && job->running < job->limit && job->next < job->tasks->len) {
+        ClipTask *task = g_ptr_array_index(job->tasks, job->next++);
+        GError *error = NULL;
+
+        if (!clip_task_spawn(task, &error)) {
+            job->error = error;
+            job->stopping = TRUE;
+            break;
+        }
+        job->running++;
+    }
+
+    if (job->running == 0 && (job->stopping || job->next == job->tasks->len)) {
+        clip_job_done(job);
+    }
+}
+
+static gboolean clip_job_pump_idle(gpointer data) {
+    clip_job_pump(data);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean clip_cutter_accepts(const DownloadItem *item) {
+    (void)item;
+    return FALSE;
+}
+
+static gboolean clip_cutter_start(DownloadItem *item, GError **error) {
+    int cover_start, cover_end;
+    if (!item->output_file || !clip_cover(item->options->clips, &cover_start, &cover_end)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No source file to cut clips from");
+        return FALSE;
+    }
+
+    AppConfig *config = config_get();
+    ClipJob *job = g_malloc0(sizeof(ClipJob));
+    job->item = item;
+    job->source = g_strdup(item->output_file);
+    job->keep_source = config->clip_keep_source;
+    job->limit = config->clip_parallel > 0 ? config->clip_parallel : (int)g_get_num_processors();
+    job->tasks = g_ptr_array_new_with_free_func((GDestroyNotify)clip_task_free);
+
+    // The source begins at the start of the span covering all clips
+    for (int i = 0; item->options->clips[i] != NULL; i++) {
+        int start, end;
+        clip_parse_range(item->options->clips[i], &start, &end);
+
+        char *path = clip_path(job->source, start, end);
+        if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+            // Cut by an earlier run
+            g_free(path);
+            continue;
+        }
+
+        ClipTask *task = g_malloc0(sizeof(ClipTask));
+        task->job = job;
+        task->start = start - cover_start;
+        task->duration = end >= 0 ? end - start : -1;
+        task->path = path;
+
+        const char *ext = strrchr(path, '.');
+        int stem_length = ext ? (int)(ext - path) : (int)strlen(path);
+        task->temp_path = g_strdup_printf("%.*s.temp%s", stem_length, path, ext ? ext : "");
+        download_engine_track_file(item, task->temp_path);
+        g_ptr_array_add(job->tasks, task);
+    }
+
+    item->backend_data = job;
+    g_idle_add(clip_job_pump_idle, job);
+    g_print("Cutting %u clips from %s\n", job->tasks->len, job->source);
+    return TRUE;
+}
+
+static gboolean clip_cutter_terminate(DownloadItem *item) {
+    ClipJob *job = item->backend_data;
+    if (!job) return FALSE;
+    clip_job_stop(job, SIGTERM);
+    return TRUE;
+}
+
+static gboolean clip_cutter_kill(DownloadItem *item) {
+    ClipJob *job = item->backend_data;
+    if (!job) return FALSE;
+    clip_job_stop(job, SIGKILL);
+    return TRUE;
+}
+
+static gboolean clip_cutter_suspend(DownloadItem *item) {
+    ClipJob *job = item->backend_data;
+    if (!job) return FALSE;
+    job->suspended = TRUE;
+    clip_job_signal(job, SIGSTOP);
+    return TRUE;
+}
+
+static gboolean clip_cutter_resume(DownloadItem *item) {
+    ClipJob *job = item->backend_data;
+    if (!job) return FALSE;
+    job->suspended = FALSE;
+    clip_job_signal(job, SIGCONT);
+    return TRUE;
+}
+
+// The cuts still running are killed; the job frees itself once they exit
+static void clip_cutter_release(DownloadItem *item) {
+    ClipJob *job = item->backend_data;
+    if (!job) return;
+
+    job->item = NULL;
+    item->backend_data = NULL;
+    clip_job_stop(job, SIGKILL);
+}
+
+const DownloadBackend clip_cutter_backend = {
+    .name = "clip cutter",
+    .accepts = clip_cutter_accepts,
+    .start = clip_cutter_start,
+    .terminate = clip_cutter_terminate,
+    .kill = clip_cutter_kill,
+    .suspend = clip_cutter_suspend,
+    .resume = clip_cutter_resume,
+    .release = clip_cutter_release,
+};
@@ -0,0 +1,23 @@
+#ifndef CLIP_CUTTER_H
+#define CLIP_CUTTER_H
+
+#include "download_backend.h"
+
+// Clip jobs (DownloadOptions.clips): yt-dlp downloads the span covering
+// every clip once, then each clip is cut from that file locally with an
+// ffmpeg stream copy, several at a time ([clips] in the config). A stream
+// copy starts at the keyframe at or before the requested start.
+
+// Parse "START-END" with times as H:MM:SS, MM:SS or seconds. *end is -1
+// for an open end ("START-" or "START-inf").
+gboolean clip_parse_range(const char *range, int *start, int *end);
+
+// Smallest span containing every clip, *end -1 = until the end. FALSE if
+// a range doesn't parse.
+gboolean clip_cover(char * const *clips, int *start, int *end);
+
+// Cuts the clips from item->output_file. The engine switches a clip job
+// to it once the source download succeeds; it never starts a download.
+extern const DownloadBackend clip_cutter_backend;
+
+#endif
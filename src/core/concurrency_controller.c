@@ -0,0 +1,315 @@
+#include "concurrency_controller.h"
+
+#define DECISION_LOG_SIZE 32
+
+typedef struct {
+    char *domain;           // NULL for the global scope
+    double limit;
+    double throughput_sum;  // Sum of aggregate rate samples this interval
+    int samples;
+    int saturated_samples;  // Samples with every slot in use and work queued
+    double last_throughput; // Mean aggregate rate of the previous interval
+    gboolean last_increased;
+    gboolean backed_off;    // Throttled during this interval
+} ControllerScope;
+
+typedef struct {
+    gint64 time;            // Wall clock, for the log
+    char *scope;
+    double from;
+    double to;
+    const char *reason;
+    double throughput;
+} ControllerDecision;
+
+static ControllerScope global_scope;
+static GHashTable *domain_scopes = NULL;   // Domain -> ControllerScope
+static ControllerDecision decisions[DECISION_LOG_SIZE];
+static guint decision_count = 0;
+static gint64 interval_start = 0;
+
+static void scope_free(gpointer data) {
+    ControllerScope *scope = data;
+    g_free(scope->domain);
+    g_free(scope);
+}
+
+static void scope_init(AppConfig *config, ControllerScope *scope) {
+    if (scope->limit == 0) {
+        scope->limit = CLAMP(config->max_concurrent_downloads,
+                             config->adaptive_min_downloads, config->adaptive_max_downloads);
+    }
+}
+
+static ControllerScope *domain_scope(AppConfig *config, const char *domain) {
+    if (!domain_scopes) {
+        domain_scopes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, scope_free);
+    }
+
+    ControllerScope *scope = g_hash_table_lookup(domain_scopes, domain);
+    if (!scope) {
+        scope = g_malloc0(sizeof(ControllerScope));
+        scope->domain = g_strdup(domain);
+        scope_init(config, scope);
+        g_hash_table_insert(domain_scopes, scope->domain, scope);
+    }
+    return scope;
+}
+
+static void log_decision(ControllerScope *scope, double from, const char *reason) {
+    if (from == scope->limit) return;
+
+    ControllerDecision *decision = &decisions[decision_count++ % DECISION_LOG_SIZE];
+    g_free(decision->scope);
+    decision->time = g_get_real_time();
+    decision->scope = g_strdup(scope->domain ? scope->domain : "global");
+    decision->from = from;
+    decision->to = scope->limit;
+    decision->reason = reason;
+    decision->throughput = scope->last_throughput;
+
+    if ((int)from != (int)scope->limit) {
+        g_print("Adaptive: %s limit %d -> %d (%s)\n", decision->scope,
+                (int)from, (int)scope->limit, reason);
+    }
+}
+
+static void scope_set_limit(AppConfig *config, ControllerScope *scope, double limit,
+                            const char *reason) {
+    double from = scope->limit;
+    scope->limit = CLAMP(limit, config->adaptive_min_downloads, config->adaptive_max_downloads);
+    log_decision(scope, from, reason);
+}
+
+// Additive increase while it pays off, multiplicative decrease otherwise.
+// Every increase is a probe: if the next interval shows no gain the limit
+// backs off, and the interval after that probes again.
+static void scope_evaluate(AppConfig *config, ControllerScope *scope) {
+    if (scope->samples == 0) return;
+
+    double throughput = scope->throughput_sum / scope->samples;
+    double gain = 1.0 + config->adaptive_gain_percent / 100.0;
+    gboolean saturated = scope->saturated_samples * 2 >= scope->samples;
+
+    if (scope->backed_off) {
+        // Already reduced when the error was reported
+        scope->last_increased = FALSE;
+    } else if (!saturated) {
+        // Not enough work to tell whether more slots would help
+        scope->last_increased = FALSE;
+    } else if (scope->last_increased && throughput < scope->last_throughput * gain) {
+        scope_set_limit(config, scope, scope->limit * config->adaptive_flat_backoff_percent / 100.0,
+                        "flat throughput");
+        scope->last_increased = FALSE;
+    } else {
+        scope_set_limit(config, scope, (int)scope->limit + 1,
+                        scope->last_increased ? "throughput rising" : "probing");
+        scope->last_increased = TRUE;
+    }
+
+    scope->last_throughput = throughput;
+    scope->throughput_sum = 0;
+    scope->samples = 0;
+    scope->saturated_samples = 0;
+    scope->backed_off = FALSE;
+}
+
+static void scope_sample(ControllerScope *scope, double rate, int running, int queued) {
+    scope->throughput_sum += rate;
+    scope->samples++;
+    if (queued > 0 && running >= (int)scope->limit) {
+        scope->saturated_samples++;
+    }
+}
+
+typedef struct {
+    double rate;
+    int running;
+    int queued;
+} DomainLoad;
+
+void concurrency_controller_sample(AppConfig *config, GList *items, gint64 now) {
+    if (!config->adaptive_concurrency) return;
+
+    scope_init(config, &global_scope);
+
+    GHashTable *loads = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    DomainLoad total = { 0 };
+
+    for (GList *l = items; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        gboolean running = item->status == DOWNLOAD_STATUS_DOWNLOADING &&
+                           !item->stage_suspended && !item->cancel_requested;
+        gboolean queued = item->status == DOWNLOAD_STATUS_QUEUED;
+        if (!running && !queued) continue;
+
+        DomainLoad *load = NULL;
+        if (item->domain) {
+            load = g_hash_table_lookup(loads, item->domain);
+            if (!load) {
+                load = g_malloc0(sizeof(DomainLoad));
+                g_hash_table_insert(loads, item->domain, load);
+            }
+        }
+
+        DomainLoad *targets[] = { &total, load };
+        for (gsize i = 0; i < G_N_ELEMENTS(targets); i++) {
+            if (!targets[i]) continue;
+            if (running) {
+                targets[i]->rate += item->speed;
+                targets[i]->running++;
+            } else {
+                targets[i]->queued++;
+            }
+        }
+    }
+
+    scope_sample(&global_scope, total.rate, total.running, total.queued);
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, loads);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        DomainLoad *load = value;
+        scope_sample(domain_scope(config, key), load->rate, load->running, load->queued);
+    }
+    g_hash_table_destroy(loads);
+
+    if (interval_start == 0) {
+        interval_start = now;
+    }
+    if (now - interval_start < (gint64)config->adaptive_interval_seconds * G_USEC_PER_SEC) {
+        return;
+    }
+    interval_start = now;
+
+    scope_evaluate(config, &global_scope);
+    if (domain_scopes) {
+        g_hash_table_iter_init(&iter, domain_scopes);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            ControllerScope *scope = value;
+            if (scope->samples == 0 && !scope->backed_off) {
+                // Domain with nothing left to do, forget what was learned
+                g_hash_table_iter_remove(&iter);
+                continue;
+            }
+            scope_evaluate(config, scope);
+        }
+    }
+}
+
+void concurrency_controller_report(AppConfig *config, const char *domain, const char *reason) {
+    if (!config->adaptive_concurrency) return;
+
+    // Without a host the throttling can't be pinned on a site
+    ControllerScope *scope = domain ? domain_scope(config, domain) : &global_scope;
+    scope_init(config, scope);
+
+    // One decrease per interval: a burst of errors from the same batch is
+    // a single congestion event
+    if (scope->backed_off) return;
+
+    scope_set_limit(config, scope, scope->limit * config->adaptive_error_backoff_percent / 100.0,
+                    reason);
+    scope->backed_off = TRUE;
+}
+
+int concurrency_controller_global_limit(AppConfig *config) {
+    if (!config->adaptive_concurrency) {
+        return config->max_concurrent_downloads;
+    }
+    scope_init(config, &global_scope);
+    return (int)global_scope.limit;
+}
+
+int concurrency_controller_domain_limit(AppConfig *config, const char *domain) {
+    if (!config->adaptive_concurrency || !domain || !domain_scopes) {
+        return -1;
+    }
+    ControllerScope *scope = g_hash_table_lookup(domain_scopes, domain);
+    return scope ? (int)scope->limit : -1;
+}
+
+static void render_scope(GString *out, ControllerScope *scope) {
+    char *rate = g_format_size((guint64)scope->last_throughput);
+    g_string_append_printf(out, "%-32s limit %2d  last interval %s/s\n",
+                           scope->domain ? scope->domain : "global", (int)scope->limit, rate);
+    g_free(rate);
+}
+
+char* concurrency_controller_render(void) {
+    GString *out = g_string_new(NULL);
+
+    if (!config_get()->adaptive_concurrency) {
+        g_string_append(out, "adaptive concurrency is disabled\n");
+        return g_string_free(out, FALSE);
+    }
+
+    render_scope(out, &global_scope);
+    if (domain_scopes) {
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, domain_scopes);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            render_scope(out, value);
+        }
+    }
+
+    g_string_append(out, "\nRecent decisions:\n");
+    guint first = decision_count > DECISION_LOG_SIZE ? decision_count - DECISION_LOG_SIZE : 0;
+    for (guint i = first; i < decision_count; i++) {
+        ControllerDecision *decision = &decisions[i % DECISION_LOG_SIZE];
+        GDateTime *time = g_date_time_new_from_unix_local(decision->time / G_USEC_PER_SEC);
+        char *stamp = g_date_time_format(time, "%H:%M:%S");
+        char *rate = g_format_size((guint64)decision->throughput);
+        g_string_append_printf(out, "%s  %-24s %5.1f -> %5.1f  %-18s at %s/s\n", stamp,
+                               decision->scope, decision->from, decision->to, decision->reason,
+                               rate);
+        g_free(rate);
+        g_free(stamp);
+        g_date_time_unref(time);
+    }
+
+    return g_string_free(out, FALSE);
+}
+
+char* concurrency_controller_render_prometheus(void) {
+    GString *out = g_string_new(NULL);
+
+    if (!config_get()->adaptive_concurrency) {
+        return g_string_free(out, FALSE);
+    }
+
+    g_string_append(out, "# HELP datareel_adaptive_limit Network slots chosen by the adaptive controller\n"
+                         "# TYPE datareel_adaptive_limit gauge\n");
+    g_string_append_printf(out, "datareel_adaptive_limit{scope=\"global\"} %d\n",
+                           (int)global_scope.limit);
+    if (domain_scopes) {
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, domain_scopes);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            ControllerScope *scope = value;
+            char *label = g_strescape(scope->domain, NULL);
+            g_string_append_printf(out, "datareel_adaptive_limit{scope=\"%s\"} %d\n",
+                                   label, (int)scope->limit);
+            g_free(label);
+        }
+    }
+
+    g_string_append(out, "# HELP datareel_adaptive_decisions_total Limit changes evaluated\n"
+                         "# TYPE datareel_adaptive_decisions_total counter\n");
+    g_string_append_printf(out, "datareel_adaptive_decisions_total %u\n", decision_count);
+
+    return g_string_free(out, FALSE);
+}
+
+void concurrency_controller_reset(void) {
+    g_clear_pointer(&domain_scopes, g_hash_table_destroy);
+    for (guint i = 0; i < DECISION_LOG_SIZE; i++) {
+        g_clear_pointer(&decisions[i].scope, g_free);
+    }
+    memset(&global_scope, 0, sizeof(global_scope));
+    decision_count = 0;
+    interval_start = 0;
+}
@@ -0,0 +1,32 @@
+#ifndef CONCURRENCY_CONTROLLER_H
+#define CONCURRENCY_CONTROLLER_H
+
+#include "common.h"
+#include "../utils/config.h"
+
+// Adaptive network concurrency ([adaptive] in the config). One AIMD limit
+// is kept for all downloads and one per domain: a limit grows by one per
+// interval while aggregate throughput keeps rising, and shrinks
+// multiplicatively on 429/403 errors, stalls, or an increase that didn't
+// pay off. With the controller disabled the static limits apply.
+
+// Fold the current transfer rates into the running interval and evaluate
+// the limits when the interval is over. Call once per scheduler tick.
+void concurrency_controller_sample(AppConfig *config, GList *items, gint64 now);
+
+// Throttling signal for a domain (NULL for an unknown host), e.g. "http_429"
+void concurrency_controller_report(AppConfig *config, const char *domain, const char *reason);
+
+// Network slots for all downloads, or for one domain (-1 = no domain limit)
+int concurrency_controller_global_limit(AppConfig *config);
+int concurrency_controller_domain_limit(AppConfig *config, const char *domain);
+
+// Current limits, interval throughput and the recent decisions, as text
+char* concurrency_controller_render(void);
+
+// Limits and throughput as Prometheus gauges
+char* concurrency_controller_render_prometheus(void);
+
+void concurrency_controller_reset(void);
+
+#endif
@@ -0,0 +1,181 @@
+#include "control_server.h"
+#include "metrics.h"
+#include "process_manager.h"
+#include "concurrency_controller.h"
+#include "work_pool.h"
+#include <gio/gio.h>
+
+typedef struct {
+    GSocketConnection *connection;
+    GDataInputStream *input;
+    char *response;
+} ControlClient;
+
+typedef char* (*ControlCommandFunc)(void);
+
+static GSocketService *control_service = NULL;
+static char *control_socket_path = NULL;
+
+static char* command_metrics(void) {
+    char *metrics = metrics_render_prometheus(process_manager_get_all());
+    char *adaptive = concurrency_controller_render_prometheus();
+    char *lanes = work_pool_render_prometheus();
+    char *body = g_strconcat(metrics, adaptive, lanes, NULL);
+    g_free(metrics);
+    g_free(adaptive);
+    g_free(lanes);
+    return body;
+}
+
+static const struct {
+    const char *name;
+    ControlCommandFunc func;
+} control_commands[] = {
+    { "metrics", command_metrics },
+    { "concurrency", concurrency_controller_render },
+};
+
+static void control_client_free(ControlClient *client) {
+    g_io_stream_close(G_IO_STREAM(client->connection), NULL, NULL);
+    g_object_unref(client->input);
+    g_object_unref(client->connection);
+    g_free(client->response);
+    g_free(client);
+}
+
+static ControlCommandFunc lookup_command(const char *name) {
+    for (gsize i = 0; i < G_N_ELEMENTS(control_commands); i++) {
+        if (strcmp(control_commands[i].name, name) == 0) {
+            return control_commands[i].func;
+        }
+    }
+    return NULL;
+}
+
+// Build the reply for a request line. HTTP requests ("GET /metrics
+// HTTP/1.1") get a minimal HTTP/1.0 response; the rest of their headers
+// are never read, the connection is closed after the body.
+static char* handle_request(const char *line) {
+    gboolean http = g_str_has_prefix(line, "GET ");
+    char *name;
+
+    if (http) {
+        const char *path = line + strlen("GET ");
+        while (*path == '/') path++;
+        const char *end = strpbrk(path, " ?");
+        name = end ? g_strndup(path, end - path) : g_strdup(path);
+    } else {
+        name = g_strstrip(g_strdup(line));
+    }
+
+    ControlCommandFunc func = lookup_command(name);
+    char *body = func ? func() : g_strdup_printf("unknown command: %s\n", name);
+    g_free(name);
+
+    if (!http) {
+        return body;
+    }
+
+    char *response = g_strdup_printf("HTTP/1.0 %s\r\n"
+                                     "Content-Type: text/plain; version=0.0.4\r\n"
+                                     "Content-Length: %zu\r\n"
+                                     "Connection: close\r\n\r\n%s",
+                                     func ? "200 OK" : "404 Not Found",
+                                     strlen(body), body);
+    g_free(body);
+    return response;
+}
+
+static void on_response_written(GObject *source, GAsyncResult *result, gpointer user_data) {
+    ControlClient *client = user_data;
+    GError *error = NULL;
+
+    if (!g_output_stream_write_all_finish(G_OUTPUT_STREAM(source), result, NULL, &error)) {
+        g_debug("Control client went away: %s", error->message);
+        g_error_free(error);
+    }
+    control_client_free(client);
+}
+
+static void on_request_line(GObject *source, GAsyncResult *result, gpointer user_data) {
+    ControlClient *client = user_data;
+    char *line = g_data_input_stream_read_line_finish_utf8(G_DATA_INPUT_STREAM(source),
+                                                            result, NULL, NULL);
+    if (!line) {
+        control_client_free(client);
+        return;
+    }
+
+    client->response = handle_request(line);
+    g_free(line);
+
+    GOutputStream *output = g_io_stream_get_output_stream(G_IO_STREAM(client->connection));
+    g_output_stream_write_all_async(output, client->response, strlen(client->response),
+                                    G_PRIORITY_DEFAULT, NULL, on_response_written, client);
+}
+
+static gboolean on_incoming(GSocketService *service, GSocketConnection *connection,
+                            GObject *source_object, gpointer user_data) {
+    (void)service;
+    (void)source_object;
+    (void)user_data;
+
+    ControlClient *client = g_malloc0(sizeof(ControlClient));
+    client->connection = g_object_ref(connection);
+    client->input = g_data_input_stream_new(
+        g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+    g_data_input_stream_set_newline_type(client->input, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+    g_data_input_stream_read_line_async(client->input, G_PRIORITY_DEFAULT, NULL,
+                                        on_request_line, client);
+    return TRUE;
+}
+
+char* control_server_get_path(void) {
+    return g_build_filename(g_get_user_runtime_dir(), "datareel", "control.sock", NULL);
+}
+
+gboolean control_server_start(GError **error) {
+    if (control_service) return TRUE;
+
+    char *path = control_server_get_path();
+    char *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    // A previous instance that crashed leaves its socket behind
+    unlink(path);
+
+    GSocketAddress *address = g_unix_socket_address_new(path);
+    GSocketService *service = g_socket_service_new();
+    gboolean ok = g_socket_listener_add_address(G_SOCKET_LISTENER(service), address,
+                                                G_SOCKET_TYPE_STREAM,
+                                                G_SOCKET_PROTOCOL_DEFAULT,
+                                                NULL, NULL, error);
+    g_object_unref(address);
+
+    if (!ok) {
+        g_object_unref(service);
+        g_free(path);
+        return FALSE;
+    }
+
+    g_signal_connect(service, "incoming", G_CALLBACK(on_incoming), NULL);
+    g_socket_service_start(service);
+
+    control_service = service;
+    control_socket_path = path;
+    g_print("Control socket listening on %s\n", path);
+    return TRUE;
+}
+
+void control_server_stop(void) {
+    if (!control_service) return;
+
+    g_socket_service_stop(control_service);
+    g_socket_listener_close(G_SOCKET_LISTENER(control_service));
+    g_clear_object(&control_service);
+
+    unlink(control_socket_path);
+    g_clear_pointer(&control_socket_path, g_free);
+}
@@ -0,0 +1,14 @@
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include "common.h"
+
+// Local control socket at $XDG_RUNTIME_DIR/datareel/control.sock.
+// Accepts one command per connection, either as a bare line ("metrics")
+// or as an HTTP GET, so `curl --unix-socket` and Prometheus exporters
+// can scrape it directly.
+gboolean control_server_start(GError **error);
+void control_server_stop(void);
+char* control_server_get_path(void);
+
+#endif
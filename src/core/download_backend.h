@@ -0,0 +1,57 @@
+#ifndef DOWNLOAD_BACKEND_H
+#define DOWNLOAD_BACKEND_H
+
+#include "common.h"
+#include "format_planner.h"
+
+// A way of transferring an item. The engine starts an item with the first
+// registered backend that accepts it, and falls back to yt-dlp, which
+// accepts everything. Every operation runs on the main thread.
+typedef struct DownloadBackend {
+    const char *name;
+
+    gboolean (*accepts)(const DownloadItem *item);
+
+    // Begin the transfer. Once started, the backend keeps the item's
+    // progress fields current through download_engine_add_bytes() and
+    // calls download_engine_backend_finished() exactly once.
+    gboolean (*start)(DownloadItem *item, GError **error);
+
+    gboolean (*terminate)(DownloadItem *item);  // Stop soon, keeping partial data
+    gboolean (*kill)(DownloadItem *item);       // Stop now
+    gboolean (*suspend)(DownloadItem *item);    // Hold the transfer in place
+    gboolean (*resume)(DownloadItem *item);
+
+    // The item is being freed while running; forget it. May be NULL.
+    void (*release)(DownloadItem *item);
+} DownloadBackend;
+
+void download_engine_register_backend(const DownloadBackend *backend);
+
+// The transfer has ended. error is NULL on success; cancellation and
+// pausing are recognised from the item's flags whatever the error.
+void download_engine_backend_finished(DownloadItem *item, const GError *error);
+
+// Account newly transferred bytes to the item and the metrics
+void download_engine_add_bytes(DownloadItem *item, int64_t delta);
+
+// Remember a file the transfer writes, so a cancel can remove it
+void download_engine_track_file(DownloadItem *item, const char *path);
+
+// The network transfer is done and local work (e.g. an ffmpeg merge) begins
+void download_engine_set_processing(DownloadItem *item, const char *step);
+
+// Let yt-dlp transfer a started item after all, e.g. when the resolved
+// formats turn out to be something the backend can't fetch. The backend
+// must have let go of the item first.
+void download_engine_fall_back(DownloadItem *item);
+
+// Swap the URL, the last of a yt-dlp command line of argc arguments, for
+// the item's prefetched info JSON when it is still fresh
+char **download_engine_use_prefetched_info(DownloadItem *item, char **args, int argc);
+
+// The streams to request for the item, logged and counted; NULL without a
+// format list. Free with format_plan_free().
+FormatPlan* download_engine_plan_formats(DownloadItem *item);
+
+#endif
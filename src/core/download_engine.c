@@ -1,8 +1,89 @@
 #include "download_engine.h"
+#include "download_backend.h"
 #include "ytdlp_manager.h"
-#include <fcntl.h>
+#include "clip_cutter.h"
+#include "metrics.h"
+#include "spawn.h"
+#include "resource_control.h"
+#include "../utils/config.h"
+#include "../utils/string_utils.h"
+
+// Prefetched info is only trusted this long: format URLs are signed and expire
+#define INFO_JSON_MAX_AGE_US (30 * 60 * G_USEC_PER_SEC)
+
+static DownloadFinishedFunc finished_func = NULL;
+static gpointer finished_data = NULL;
+static DownloadStageFunc stage_func = NULL;
+static gpointer stage_data = NULL;
+
+static const DownloadBackend ytdlp_backend;
+static GPtrArray *backends = NULL;      // Registered before yt-dlp, in order
+
+// yt-dlp post-processors, recognised by the tag prefixing their output.
+// Seeing one means the network transfer is done and ffmpeg work begins.
+static const struct {
+    const char *tag;
+    const char *step;
+} postprocessor_steps[] = {
+    { "[Merger]", "merging formats" },
+    { "[ExtractAudio]", "extracting audio" },
+    { "[EmbedThumbnail]", "embedding thumbnail" },
+    { "[EmbedSubtitle]", "embedding subtitles" },
+    { "[ThumbnailsConvertor]", "converting thumbnail" },
+    { "[SubtitlesConvertor]", "converting subtitles" },
+    { "[VideoRemuxer]", "remuxing" },
+    { "[VideoConvertor]", "converting video" },
+    { "[FixupM3u8]", "fixing container" },
+    { "[FixupM4a]", "fixing container" },
+    { "[FixupTimestamp]", "fixing timestamps" },
+    { "[FixupDuration]", "fixing duration" },
+    { "[Metadata]", "writing metadata" },
+    { "[ModifyChapters]", "modifying chapters" },
+};
+
+void download_engine_set_finished_func(DownloadFinishedFunc func, gpointer user_data) {
+    finished_func = func;
+    finished_data = user_data;
+}
+
+void download_engine_set_stage_func(DownloadStageFunc func, gpointer user_data) {
+    stage_func = func;
+    stage_data = user_data;
+}
+
+void download_engine_register_backend(const DownloadBackend *backend) {
+    if (!backends) {
+        backends = g_ptr_array_new();
+    }
+    g_ptr_array_add(backends, (gpointer)backend);
+}
+
+static const DownloadBackend *download_engine_pick_backend(const DownloadItem *item) {
+    for (guint i = 0; backends && i < backends->len; i++) {
+        const DownloadBackend *backend = g_ptr_array_index(backends, i);
+        if (backend->accepts(item)) {
+            return backend;
+        }
+    }
+    return &ytdlp_backend;
+}
+
+static void download_item_set_stage(DownloadItem *item, DownloadStatus status) {
+    // Output still buffered in the pipe may arrive after a pause
+    if (item->status == status || item->status == DOWNLOAD_STATUS_CANCELLED ||
+        item->status == DOWNLOAD_STATUS_PAUSED || item->cancel_requested) {
+        return;
+    }
 
-static gboolean parse_progress_line(const char *line, DownloadItem *item);
+    item->status = status;
+    item->last_activity_time = g_get_monotonic_time();
+    if (item->process_id > 0) {
+        resource_control_apply(item->process_id, status);
+    }
+    if (stage_func) {
+        stage_func(item, stage_data);
+    }
+}
 
 DownloadItem* download_item_new(const char *url, const char *output_path,
                                 DownloadOptions *opts) {
@@ -14,6 +95,8 @@ DownloadItem* download_item_new(const char *url, const char *output_path,
     item->progress = 0.0;
     item->process_id = -1;
     item->read_fd = -1;
+    item->domain = string_extract_domain(url);
+    item->scheduled_rate_limit = -1;
 
     return item;
 }
@@ -21,9 +104,19 @@ DownloadItem* download_item_new(const char *url, const char *output_path,
 void download_item_free(DownloadItem *item) {
     if (!item) return;
 
+    if (item->backend && item->backend->release) {
+        item->backend->release(item);
+    }
+
     if (item->io_watch_id > 0) {
         g_source_remove(item->io_watch_id);
     }
+    if (item->child_watch_id > 0) {
+        g_source_remove(item->child_watch_id);
+    }
+    if (item->kill_timer_id > 0) {
+        g_source_remove(item->kill_timer_id);
+    }
     if (item->io_channel) {
         g_io_channel_unref(item->io_channel);
     }
@@ -31,15 +124,26 @@ void download_item_free(DownloadItem *item) {
         close(item->read_fd);
     }
 
+    if (item->info_json_path) {
+        unlink(item->info_json_path);
+        g_free(item->info_json_path);
+    }
+
     g_free(item->url);
+    g_free(item->domain);
     g_free(item->output_path);
     g_free(item->eta);
     g_free(item->error_message);
+    g_free(item->output_file);
+    if (item->partial_files) {
+        g_ptr_array_unref(item->partial_files);
+    }
 
     if (item->options) {
         g_free(item->options->custom_format);
         g_free(item->options->time_range_start);
         g_free(item->options->time_range_end);
+        g_strfreev(item->options->clips);
         g_free(item->options->output_template);
         g_free(item->options);
     }
@@ -51,112 +155,707 @@ void download_item_free(DownloadItem *item) {
     g_free(item);
 }
 
-static gboolean on_stdout_readable(GIOChannel *channel, GIOCondition cond,
-                                   gpointer user_data) {
-    DownloadItem *item = (DownloadItem *)user_data;
+static void download_item_close_output(DownloadItem *item) {
+    item->io_watch_id = 0;
+    if (item->io_channel) {
+        g_io_channel_unref(item->io_channel);
+        item->io_channel = NULL;
+    }
+    if (item->read_fd >= 0) {
+        close(item->read_fd);
+        item->read_fd = -1;
+    }
+}
+
+// Remember a file written for the current entry
+void download_engine_track_file(DownloadItem *item, const char *path) {
+    if (!item->partial_files) {
+        item->partial_files = g_ptr_array_new_with_free_func(g_free);
+    }
+    g_ptr_array_add(item->partial_files, g_strchomp(g_strdup(path)));
+}
+
+// Delete a tracked output and everything yt-dlp derives from its name:
+// "X.part", "X.ytdl", "X.part-Frag12" and ffmpeg's "stem.temp.ext"
+static void remove_partial_file(const char *path) {
+    char *dirname = g_path_get_dirname(path);
+    char *basename = g_path_get_basename(path);
+    const char *ext = strrchr(basename, '.');
+    char *temp_prefix = g_strdup_printf("%.*s.temp.", ext ? (int)(ext - basename)
+                                                          : (int)strlen(basename), basename);
+
+    GDir *dir = g_dir_open(dirname, 0, NULL);
+    if (dir) {
+        const char *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            gboolean derived = g_str_has_prefix(name, basename) &&
+                               (name[strlen(basename)] == '\0' || name[strlen(basename)] == '.');
+            if (derived || g_str_has_prefix(name, temp_prefix)) {
+                char *full = g_build_filename(dirname, name, NULL);
+                if (unlink(full) == 0) {
+                    g_print("Removed partial file: %s\n", full);
+                }
+                g_free(full);
+            }
+        }
+        g_dir_close(dir);
+    }
+
+    g_free(temp_prefix);
+    g_free(basename);
+    g_free(dirname);
+}
+
+static void download_item_remove_partial_files(DownloadItem *item) {
+    if (!item->partial_files) return;
 
-    if (cond & G_IO_HUP) {
-        item->status = DOWNLOAD_STATUS_COMPLETED;
+    for (guint i = 0; i < item->partial_files->len; i++) {
+        remove_partial_file(g_ptr_array_index(item->partial_files, i));
+    }
+    g_ptr_array_set_size(item->partial_files, 0);
+}
+
+// A clip job's source download is only the first half: the clips are cut
+// from it before the item completes. FALSE if there is nothing to cut.
+static gboolean download_item_cut_clips(DownloadItem *item, const GError *error) {
+    if (error || item->cancel_requested || item->pause_requested || !item->options->clips ||
+        item->backend == &clip_cutter_backend) {
         return FALSE;
     }
 
-    char *line = NULL;
-    gsize length;
+    GError *cut_error = NULL;
+    item->backend = &clip_cutter_backend;
+    item->backend_data = NULL;
+    item->process_id = -1;
+    if (!clip_cutter_backend.start(item, &cut_error)) {
+        g_free(item->error_message);
+        item->error_message = g_strdup(cut_error->message);
+        download_engine_backend_finished(item, cut_error);
+        g_error_free(cut_error);
+        return TRUE;
+    }
+
+    download_engine_set_processing(item, "cutting clips");
+    return TRUE;
+}
+
+void download_engine_backend_finished(DownloadItem *item, const GError *error) {
+    if (download_item_cut_clips(item, error)) {
+        return;
+    }
+
+    if (item->kill_timer_id > 0) {
+        g_source_remove(item->kill_timer_id);
+        item->kill_timer_id = 0;
+    }
+    if (item->info_json_path) {
+        unlink(item->info_json_path);
+        g_clear_pointer(&item->info_json_path, g_free);
+    }
+
+    item->resuming = FALSE;
+    if (item->cancel_requested) {
+        // Only now is nothing writing to the files any more
+        item->status = DOWNLOAD_STATUS_CANCELLED;
+        item->cancel_requested = FALSE;
+        if (item->remove_partial) {
+            download_item_remove_partial_files(item);
+        }
+    } else if (item->pause_requested) {
+        // Terminated on purpose; the next start continues its .part files
+        item->status = DOWNLOAD_STATUS_PAUSED;
+        item->paused_stage = DOWNLOAD_STATUS_QUEUED;
+        item->pause_requested = FALSE;
+        item->resuming = TRUE;
+    } else if (item->status != DOWNLOAD_STATUS_CANCELLED) {
+        if (!error) {
+            item->status = DOWNLOAD_STATUS_COMPLETED;
+            item->progress = 100.0;
+
+            gint64 transfer_time = item->last_progress_time - item->first_progress_time;
+            if (item->bytes_downloaded > 0 && transfer_time > 0) {
+                metrics_histogram_observe(METRIC_THROUGHPUT,
+                                          item->bytes_downloaded * G_USEC_PER_SEC / transfer_time);
+            }
+        } else {
+            item->status = DOWNLOAD_STATUS_FAILED;
+            if (!item->error_message) {
+                item->error_message = g_strdup(error->message);
+            }
+
+            // Stale format URLs are a likely cause, retry with a fresh extraction
+            if (item->metadata) {
+                g_clear_pointer(&item->metadata->info_json, g_free);
+            }
+        }
+    }
+
+    item->process_id = -1;
+    item->backend = NULL;
+    item->backend_data = NULL;
+
+    if (finished_func) {
+        finished_func(item, finished_data);
+    }
+}
+
+// Called once both the output pipe is drained and the child has been
+// reaped, so the final status reflects the real exit code.
+static void download_item_finish(DownloadItem *item) {
+    if (!item->child_exited || item->io_watch_id > 0) {
+        return;
+    }
+
     GError *error = NULL;
+    g_spawn_check_wait_status(item->wait_status, &error);
+    download_engine_backend_finished(item, error);
+    g_clear_error(&error);
+}
+
+static void on_child_exited(GPid pid, gint wait_status, gpointer user_data) {
+    DownloadItem *item = (DownloadItem *)user_data;
 
-    GIOStatus status = g_io_channel_read_line(channel, &line, &length, NULL, &error);
+    // Nothing of a cancelled or paused group may outlive yt-dlp: an orphaned ffmpeg
+    // would keep writing and burning CPU
+    if (item->cancel_requested || item->pause_requested) {
+        kill(-pid, SIGKILL);
+    }
+
+    item->child_watch_id = 0;
+    item->child_exited = TRUE;
+    item->wait_status = wait_status;
+    download_item_finish(item);
+}
+
+static gboolean on_stdout_readable(GIOChannel *channel, GIOCondition cond,
+                                   gpointer user_data) {
+    DownloadItem *item = (DownloadItem *)user_data;
+
+    // Drain pending output before honouring HUP so the last lines
+    // (usually the error message) are not lost
+    if (cond & G_IO_IN) {
+        char *line = NULL;
+        gsize length;
+        GError *error = NULL;
+
+        GIOStatus status = g_io_channel_read_line(channel, &line, &length, NULL, &error);
+
+        if (status == G_IO_STATUS_NORMAL && line) {
+            if (item->first_output_time == 0) {
+                item->first_output_time = g_get_monotonic_time();
+                metrics_histogram_observe(METRIC_SPAWN_LATENCY,
+                                          item->first_output_time - item->start_time);
+            }
+            download_engine_parse_line(item, line);
+            g_free(line);
+            return TRUE;
+        } else if (status == G_IO_STATUS_AGAIN) {
+            return TRUE;
+        }
 
-    if (status == G_IO_STATUS_NORMAL && line) {
-        parse_progress_line(line, item);
         g_free(line);
+        g_clear_error(&error);
+    } else if (!(cond & (G_IO_HUP | G_IO_ERR))) {
         return TRUE;
-    } else if (status == G_IO_STATUS_EOF) {
-        item->status = DOWNLOAD_STATUS_COMPLETED;
+    }
+
+    download_item_close_output(item);
+    download_item_finish(item);
+    return FALSE;
+}
+
+// Hand prefetched metadata to yt-dlp so the download skips extraction: the
+// URL (always the last argument) is replaced by --load-info-json <file>
+char **download_engine_use_prefetched_info(DownloadItem *item, char **args, int argc) {
+    VideoMetadata *meta = item->metadata;
+    if (!meta || !meta->info_json || item->options->playlist ||
+        g_get_monotonic_time() - meta->info_json_time > INFO_JSON_MAX_AGE_US) {
+        return args;
+    }
+
+    char *path = NULL;
+    GError *error = NULL;
+    int fd = g_file_open_tmp("datareel-info-XXXXXX.json", &path, &error);
+    if (fd < 0) {
+        g_warning("Can't store prefetched info: %s", error->message);
+        g_error_free(error);
+        return args;
+    }
+    close(fd);
+
+    if (!g_file_set_contents(path, meta->info_json, -1, &error)) {
+        g_warning("Can't store prefetched info: %s", error->message);
+        g_error_free(error);
+        unlink(path);
+        g_free(path);
+        return args;
+    }
+
+    args = g_renew(char *, args, argc + 2);
+    g_free(args[argc - 1]);
+    args[argc - 1] = g_strdup("--load-info-json");
+    args[argc] = g_strdup(path);
+    args[argc + 1] = NULL;
+
+    g_free(item->info_json_path);
+    item->info_json_path = path;
+    return args;
+}
+
+FormatPlan* download_engine_plan_formats(DownloadItem *item) {
+    FormatPlan *plan = format_planner_plan(item->metadata ? item->metadata->formats : NULL,
+                                           item->options);
+    if (plan) {
+        g_print("Format plan for %s: %s\n", item->url, plan->summary);
+        metrics_counter_add(plan->transcode ? METRIC_PLANS_TRANSCODE : METRIC_PLANS_STREAM_COPY, 1);
+    }
+    return plan;
+}
+
+static gboolean ytdlp_backend_start(DownloadItem *item, GError **error) {
+    // Resolve "auto" fragment parallelism with the scheduler's choice
+    DownloadOptions effective = *item->options;
+    if (effective.concurrent_fragments <= 0) {
+        effective.concurrent_fragments = item->fragment_concurrency;
+    }
+    if (item->scheduled_rate_limit >= 0) {
+        effective.rate_limit = item->scheduled_rate_limit;
+    }
+
+    FormatPlan *plan = download_engine_plan_formats(item);
+    int argc;
+    char **args = ytdlp_build_args(item->url, item->output_path, &effective, plan, &argc);
+    args = download_engine_use_prefetched_info(item, args, argc);
+    format_plan_free(plan);
+
+    pid_t pid;
+    int output_fd;
+
+    if (!spawn_with_output(args, &pid, &output_fd, error)) {
+        ytdlp_free_args(args);
+        return FALSE;
+    }
+    ytdlp_free_args(args);
+
+    item->process_id = pid;
+    item->read_fd = output_fd;
+    resource_control_apply(pid, DOWNLOAD_STATUS_DOWNLOADING);
+
+    // Create GIOChannel for async reading
+    item->io_channel = g_io_channel_unix_new(item->read_fd);
+    g_io_channel_set_encoding(item->io_channel, NULL, NULL);
+    g_io_channel_set_buffered(item->io_channel, FALSE);
+
+    item->io_watch_id = g_io_add_watch(item->io_channel,
+                                      G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                      on_stdout_readable,
+                                      item);
+    item->child_watch_id = g_child_watch_add(pid, on_child_exited, item);
+
+    g_print("Download started with PID: %d\n", pid);
+    return TRUE;
+}
+
+// Signals go to the whole group, so ffmpeg children follow yt-dlp
+static gboolean ytdlp_backend_terminate(DownloadItem *item) {
+    if (kill(-item->process_id, SIGTERM) != 0) {
         return FALSE;
     }
+    // A stopped process only acts on SIGTERM once continued
+    kill(-item->process_id, SIGCONT);
+    return TRUE;
+}
+
+static gboolean ytdlp_backend_kill(DownloadItem *item) {
+    return kill(-item->process_id, SIGKILL) == 0;
+}
+
+static gboolean ytdlp_backend_suspend(DownloadItem *item) {
+    return kill(-item->process_id, SIGSTOP) == 0;
+}
+
+static gboolean ytdlp_backend_resume(DownloadItem *item) {
+    return kill(-item->process_id, SIGCONT) == 0;
+}
 
+static gboolean ytdlp_backend_accepts(const DownloadItem *item) {
+    (void)item;
     return TRUE;
 }
 
+static const DownloadBackend ytdlp_backend = {
+    .name = "yt-dlp",
+    .accepts = ytdlp_backend_accepts,
+    .start = ytdlp_backend_start,
+    .terminate = ytdlp_backend_terminate,
+    .kill = ytdlp_backend_kill,
+    .suspend = ytdlp_backend_suspend,
+    .resume = ytdlp_backend_resume,
+};
+
+void download_engine_fall_back(DownloadItem *item) {
+    GError *error = NULL;
+
+    item->backend = &ytdlp_backend;
+    item->backend_data = NULL;
+    item->process_id = -1;
+    if (item->info_json_path) {
+        unlink(item->info_json_path);
+        g_clear_pointer(&item->info_json_path, g_free);
+    }
+
+    if (item->cancel_requested || item->pause_requested) {
+        // Stopped while the other backend was still deciding
+        error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Interrupted");
+    } else if (ytdlp_backend_start(item, &error)) {
+        g_print("Handed to yt-dlp: %s\n", item->url);
+        return;
+    }
+
+    download_engine_backend_finished(item, error);
+    g_error_free(error);
+}
+
+void download_engine_set_processing(DownloadItem *item, const char *step) {
+    item->processing_step = step;
+    download_item_set_stage(item, DOWNLOAD_STATUS_PROCESSING);
+}
+
 gboolean download_item_start(DownloadItem *item) {
-    if (!item || item->status == DOWNLOAD_STATUS_DOWNLOADING) {
+    if (!item || item->status == DOWNLOAD_STATUS_DOWNLOADING ||
+        item->status == DOWNLOAD_STATUS_PROCESSING) {
         return FALSE;
     }
 
-    int argc;
-    char **args = ytdlp_build_args(item->url, item->output_path, item->options, &argc);
+    // Continuing after a pause is not a new attempt
+    if (!item->resuming) {
+        item->attempts++;
+    }
+    item->stage_suspended = FALSE;
+    item->processing_step = NULL;
+    item->child_exited = FALSE;
+    g_clear_pointer(&item->error_message, g_free);
+    g_clear_pointer(&item->output_file, g_free);
+    item->bytes_downloaded = 0;
+    item->file_bytes = 0;
+    item->first_output_time = 0;
+    item->first_progress_time = 0;
+    item->last_progress_time = 0;
+    item->window_start_bytes = 0;
+    item->cancel_requested = FALSE;
+    item->remove_partial = FALSE;
+    item->pause_requested = FALSE;
+    if (item->partial_files) {
+        g_ptr_array_set_size(item->partial_files, 0);
+    }
 
-    int pipefd[2];
-    if (pipe(pipefd) != 0) {
-        ytdlp_free_args(args);
+    item->start_time = g_get_monotonic_time();
+    item->last_activity_time = item->start_time;
+    item->window_start_time = item->start_time;
+
+    const DownloadBackend *backend = download_engine_pick_backend(item);
+    GError *error = NULL;
+    if (!backend->start(item, &error)) {
+        item->error_message = g_strdup(error->message);
+        g_error_free(error);
         return FALSE;
     }
 
-    pid_t pid = fork();
+    item->backend = backend;
+    item->status = DOWNLOAD_STATUS_DOWNLOADING;
+    metrics_counter_add(METRIC_DOWNLOADS_STARTED, 1);
+    return TRUE;
+}
 
-    if (pid == 0) {
-        // Child process
-        close(pipefd[0]); // Close read end
+static gboolean on_kill_timeout(gpointer user_data) {
+    DownloadItem *item = (DownloadItem *)user_data;
 
-        // Redirect stdout and stderr to pipe
-        dup2(pipefd[1], STDOUT_FILENO);
-        dup2(pipefd[1], STDERR_FILENO);
-        close(pipefd[1]);
+    item->kill_timer_id = 0;
+    if (item->backend) {
+        g_print("%s ignored termination, killing it (%s)\n", item->backend->name, item->url);
+        item->backend->kill(item);
+    }
+    return G_SOURCE_REMOVE;
+}
 
-        execvp(args[0], args);
-        exit(EXIT_FAILURE);
-    } else if (pid > 0) {
-        // Parent process
-        close(pipefd[1]); // Close write end
+// Ask the transfer (for yt-dlp the whole process group, with its ffmpeg)
+// to stop, and kill it if it hasn't after the configured grace period. The
+// item only becomes CANCELLED once the backend has finished; until then
+// cancel_requested is set and the scheduler no longer counts it against a slot.
+gboolean download_item_cancel(DownloadItem *item, gboolean remove_files) {
+    if (!item || item->cancel_requested) {
+        return FALSE;
+    }
 
-        item->process_id = pid;
-        item->status = DOWNLOAD_STATUS_DOWNLOADING;
-        item->read_fd = pipefd[0];
+    if (!item->backend) {
+        // Not running, nothing to wait for
+        if (item->status != DOWNLOAD_STATUS_QUEUED && item->status != DOWNLOAD_STATUS_IDLE &&
+            item->status != DOWNLOAD_STATUS_PAUSED) {
+            return FALSE;
+        }
+        if (remove_files) {
+            download_item_remove_partial_files(item);
+        }
+        item->status = DOWNLOAD_STATUS_CANCELLED;
+        if (finished_func) {
+            finished_func(item, finished_data);
+        }
+        return TRUE;
+    }
 
-        // Make read end non-blocking
-        int flags = fcntl(item->read_fd, F_GETFL, 0);
-        fcntl(item->read_fd, F_SETFL, flags | O_NONBLOCK);
+    if (!item->backend->terminate(item)) {
+        return FALSE;
+    }
 
-        // Create GIOChannel for async reading
-        item->io_channel = g_io_channel_unix_new(item->read_fd);
-        g_io_channel_set_encoding(item->io_channel, NULL, NULL);
-        g_io_channel_set_buffered(item->io_channel, FALSE);
+    item->stage_suspended = FALSE;
+    item->cancel_requested = TRUE;
+    item->remove_partial = remove_files;
+    item->wait_reason = NULL;
+    // A terminating pause may already have armed the timer
+    if (item->kill_timer_id == 0) {
+        item->kill_timer_id = g_timeout_add_seconds(config_get()->kill_timeout_seconds,
+                                                    on_kill_timeout, item);
+    }
+    return TRUE;
+}
 
-        item->io_watch_id = g_io_add_watch(item->io_channel,
-                                          G_IO_IN | G_IO_HUP | G_IO_ERR,
-                                          on_stdout_readable,
-                                          item);
+// Pause an item. It stops counting against its stage either way: in stop
+// mode the process group is frozen and keeps its connections and memory,
+// in terminate mode it exits (like a cancel, but keeping the partial
+// files) and the next start continues from them.
+gboolean download_item_pause(DownloadItem *item, PauseMode mode) {
+    if (!item || item->cancel_requested || item->pause_requested ||
+        item->status == DOWNLOAD_STATUS_PAUSED) {
+        return FALSE;
+    }
 
-        ytdlp_free_args(args);
-        g_print("Download started with PID: %d\n", pid);
+    if (item->status == DOWNLOAD_STATUS_QUEUED && !item->backend) {
+        item->status = DOWNLOAD_STATUS_PAUSED;
+        item->paused_stage = DOWNLOAD_STATUS_QUEUED;
+        item->wait_reason = NULL;
+        return TRUE;
+    }
+
+    if (!item->backend || (item->status != DOWNLOAD_STATUS_DOWNLOADING &&
+                           item->status != DOWNLOAD_STATUS_PROCESSING)) {
+        return FALSE;
+    }
+
+    if (mode == PAUSE_MODE_TERMINATE) {
+        if (!item->backend->terminate(item)) {
+            return FALSE;
+        }
+        item->pause_requested = TRUE;
+        item->kill_timer_id = g_timeout_add_seconds(config_get()->kill_timeout_seconds,
+                                                    on_kill_timeout, item);
+    } else if (!item->stage_suspended && !item->backend->suspend(item)) {
+        return FALSE;
+    }
+
+    item->paused_stage = item->status;
+    item->status = DOWNLOAD_STATUS_PAUSED;
+    item->stage_suspended = FALSE;
+    item->wait_reason = NULL;
+    return TRUE;
+}
+
+// Undo a pause. The item goes back to where it was paused: a frozen
+// process is handed back to the scheduler as suspended and continued once
+// its stage has a free slot, a terminated one is queued again.
+gboolean download_item_unpause(DownloadItem *item) {
+    if (!item || item->status != DOWNLOAD_STATUS_PAUSED || item->cancel_requested ||
+        item->pause_requested) {
+        return FALSE;
+    }
+
+    if (item->backend) {
+        item->status = item->paused_stage;
+        item->stage_suspended = TRUE;
+    } else {
+        item->status = DOWNLOAD_STATUS_QUEUED;
+        item->next_attempt_time = 0;
+        item->queued_time = g_get_monotonic_time();
+    }
+    return TRUE;
+}
+
+// Park a running transfer (for yt-dlp its process group) until a slot in
+// its current stage frees up
+gboolean download_item_suspend(DownloadItem *item) {
+    if (!item || !item->backend || item->stage_suspended) {
+        return FALSE;
+    }
+
+    if (item->backend->suspend(item)) {
+        item->stage_suspended = TRUE;
         return TRUE;
     }
 
-    ytdlp_free_args(args);
     return FALSE;
 }
 
-gboolean download_item_cancel(DownloadItem *item) {
-    if (!item || item->process_id <= 0) {
+gboolean download_item_resume(DownloadItem *item) {
+    if (!item || !item->backend || !item->stage_suspended) {
         return FALSE;
     }
 
-    if (kill(item->process_id, SIGTERM) == 0) {
-        item->status = DOWNLOAD_STATUS_CANCELLED;
+    if (item->backend->resume(item)) {
+        item->stage_suspended = FALSE;
+        // Time spent parked is not a stall
+        item->last_activity_time = g_get_monotonic_time();
+        item->window_start_time = item->last_activity_time;
+        item->window_start_bytes = item->bytes_downloaded;
         return TRUE;
     }
 
     return FALSE;
 }
 
-static gboolean parse_progress_line(const char *line, DownloadItem *item) {
+gboolean download_item_abort(DownloadItem *item, const char *reason) {
+    if (!item || !item->backend || item->status == DOWNLOAD_STATUS_CANCELLED ||
+        item->cancel_requested) {
+        return FALSE;
+    }
+
+    if (!item->backend->kill(item)) {
+        return FALSE;
+    }
+
+    // Kept by download_item_finish, which marks the item FAILED
+    g_free(item->error_message);
+    item->error_message = g_strdup(reason);
+    item->stage_suspended = FALSE;
+    // Don't trip the watchdog again while the process is being reaped
+    item->last_activity_time = g_get_monotonic_time();
+    item->window_start_time = item->last_activity_time;
+    return TRUE;
+}
+
+// Multiplier for a yt-dlp size unit such as "MiB" or "KiB/s"
+static double size_unit_factor(const char *unit) {
+    static const struct {
+        const char *prefix;
+        double factor;
+    } units[] = {
+        { "TiB", 1024.0 * 1024 * 1024 * 1024 },
+        { "GiB", 1024.0 * 1024 * 1024 },
+        { "MiB", 1024.0 * 1024 },
+        { "KiB", 1024.0 },
+        { "B", 1.0 },
+    };
+
+    for (gsize i = 0; i < G_N_ELEMENTS(units); i++) {
+        if (g_str_has_prefix(unit, units[i].prefix)) {
+            return units[i].factor;
+        }
+    }
+    return 0.0;
+}
+
+// Bytes of the current file so far; any change counts as transfer activity
+static void account_file_bytes(DownloadItem *item, int64_t file_bytes) {
+    int64_t delta = file_bytes >= item->file_bytes ? file_bytes - item->file_bytes : file_bytes;
+
+    // After a pause the first report includes what the .part already held
+    if (item->resuming) {
+        delta = 0;
+        item->resuming = FALSE;
+    }
+
+    item->file_bytes = file_bytes;
+    download_engine_add_bytes(item, delta);
+}
+
+// Account bytes transferred from the percentage and total size of the
+// current file. A drop in progress means the next file of a playlist or
+// format pair has started.
+static void update_transferred_bytes(DownloadItem *item, double percent, const char *line) {
+    const char *total_str = strstr(line, " of ");
+    if (!total_str) return;
+
+    total_str += strlen(" of ");
+    while (*total_str == ' ' || *total_str == '~') total_str++;
+
+    float total_val;
+    char unit[10];
+    if (sscanf(total_str, "%f%9s", &total_val, unit) != 2) return;
+
+    account_file_bytes(item, (int64_t)(total_val * size_unit_factor(unit) * percent / 100.0));
+}
+
+void download_engine_add_bytes(DownloadItem *item, int64_t delta) {
+    item->bytes_downloaded += delta;
+    metrics_counter_add(METRIC_BYTES_DOWNLOADED, (uint64_t)delta);
+
+    gint64 now = g_get_monotonic_time();
+    if (delta > 0) {
+        item->last_activity_time = now;
+    }
+    if (item->first_progress_time == 0) {
+        item->first_progress_time = now;
+        metrics_histogram_observe(METRIC_TIME_TO_FIRST_BYTE, now - item->start_time);
+    }
+    item->last_progress_time = now;
+}
+
+static gboolean parse_chomped_line(DownloadItem *item, const char *line) {
     // Parse yt-dlp progress output
     // Format: [download]  45.2% of 123.45MiB at 1.23MiB/s ETA 00:42
 
+    if (g_str_has_prefix(line, "ERROR:")) {
+        g_free(item->error_message);
+        item->error_message = g_strchug(g_strdup(line + strlen("ERROR:")));
+        return TRUE;
+    }
+
+    // Files written for the current entry, removed if it is cancelled. A new
+    // playlist entry starts a new list: finished entries are kept.
+    if (g_str_has_prefix(line, "[download] Downloading item ") ||
+        g_str_has_prefix(line, "[download] Downloading video ")) {
+        if (item->partial_files) {
+            g_ptr_array_set_size(item->partial_files, 0);
+        }
+        return TRUE;
+    }
+    // The last of these names the entry's final file
+    const char *destination = strstr(line, "Destination: ");
+    if (destination && line[0] == '[') {
+        download_engine_track_file(item, destination + strlen("Destination: "));
+        g_free(item->output_file);
+        item->output_file = g_strdup(destination + strlen("Destination: "));
+    }
+    const char *merge_target = strstr(line, "Merging formats into \"");
+    if (merge_target) {
+        char *path = g_strdup(merge_target + strlen("Merging formats into \""));
+        char *quote = strrchr(path, '"');
+        if (quote) *quote = '\0';
+        download_engine_track_file(item, path);
+        g_free(item->output_file);
+        item->output_file = path;
+    }
+    if (g_str_has_prefix(line, "[download] ") && g_str_has_suffix(line, " has already been downloaded")) {
+        g_free(item->output_file);
+        item->output_file = g_strndup(line + strlen("[download] "),
+                                      strlen(line) - strlen("[download] ") -
+                                      strlen(" has already been downloaded"));
+    }
+
+    for (gsize i = 0; i < G_N_ELEMENTS(postprocessor_steps); i++) {
+        if (g_str_has_prefix(line, postprocessor_steps[i].tag)) {
+            item->processing_step = postprocessor_steps[i].step;
+            download_item_set_stage(item, DOWNLOAD_STATUS_PROCESSING);
+            return TRUE;
+        }
+    }
+
     if (strstr(line, "[download]") && strstr(line, "%")) {
+        // Next playlist entry after post-processing the previous one
+        download_item_set_stage(item, DOWNLOAD_STATUS_DOWNLOADING);
+
         float percent;
         if (sscanf(line, "[download] %f%%", &percent) == 1) {
             item->progress = percent;
+            update_transferred_bytes(item, percent, line);
         }
 
         // Parse speed
@@ -164,13 +863,9 @@ static gboolean parse_progress_line(const char *line, DownloadItem *item) {
         if (speed_str) {
             float speed_val;
             char unit[10];
-            if (sscanf(speed_str, "at %f%s", &speed_val, unit) == 2) {
+            if (sscanf(speed_str, "at %f%9s", &speed_val, unit) == 2) {
                 // Convert to bytes/sec
-                if (strstr(unit, "MiB")) {
-                    item->speed = speed_val * 1024 * 1024;
-                } else if (strstr(unit, "KiB")) {
-                    item->speed = speed_val * 1024;
-                }
+                item->speed = speed_val * size_unit_factor(unit);
             }
         }
 
@@ -187,5 +882,38 @@ static gboolean parse_progress_line(const char *line, DownloadItem *item) {
         return TRUE;
     }
 
+    // Live streams and transfers without a Content-Length have no total:
+    // "[download]   12.34MiB at  1.23MiB/s (00:00:10)"
+    float amount;
+    char unit[10];
+    if (g_str_has_prefix(line, "[download] ") && strstr(line, " at ") &&
+        sscanf(line, "[download] %f%9s at", &amount, unit) == 2 && g_str_has_suffix(unit, "B")) {
+        download_item_set_stage(item, DOWNLOAD_STATUS_DOWNLOADING);
+        account_file_bytes(item, (int64_t)(amount * size_unit_factor(unit)));
+
+        char *speed_str = strstr(line, " at ");
+        float speed_val;
+        char speed_unit[10];
+        if (sscanf(speed_str, " at %f%9s", &speed_val, speed_unit) == 2) {
+            item->speed = speed_val * size_unit_factor(speed_unit);
+        }
+        return TRUE;
+    }
+
     return FALSE;
 }
+
+gboolean download_engine_parse_line(DownloadItem *item, const char *line) {
+    // Extractor lines ("[youtube] ...", "[info] ...") show yt-dlp working
+    // before a transfer, for the first entry and each later one of a
+    // playlist. [download] lines only count once bytes move.
+    if (!g_str_has_prefix(line, "[download]")) {
+        item->last_activity_time = g_get_monotonic_time();
+    }
+
+    // Lines come with their newline, which none of the fields may keep
+    char *chomped = g_strchomp(g_strdup(line));
+    gboolean recognised = parse_chomped_line(item, chomped);
+    g_free(chomped);
+    return recognised;
+}
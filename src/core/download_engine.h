@@ -3,11 +3,44 @@
 
 #include "common.h"
 #include "metadata_fetcher.h"
+#include "../utils/config.h"
+
+// Called on the main thread when a download process has exited and its
+// final status (completed, failed or cancelled) is set, or when it was
+// terminated by a pause and is now PAUSED.
+typedef void (*DownloadFinishedFunc)(DownloadItem *item, gpointer user_data);
+
+// Called when a running item moves between the network stage
+// (DOWNLOADING) and the post-processing stage (PROCESSING).
+typedef void (*DownloadStageFunc)(DownloadItem *item, gpointer user_data);
+
+void download_engine_set_finished_func(DownloadFinishedFunc func, gpointer user_data);
+void download_engine_set_stage_func(DownloadStageFunc func, gpointer user_data);
 
 DownloadItem* download_item_new(const char *url, const char *output_path,
                                 DownloadOptions *opts);
 void download_item_free(DownloadItem *item);
 gboolean download_item_start(DownloadItem *item);
-gboolean download_item_cancel(DownloadItem *item);
+// Terminate the item's process group, escalating to SIGKILL after the
+// configured timeout. Queued items are cancelled at once. With remove_files
+// the current entry's partial files are deleted once the group has exited.
+gboolean download_item_cancel(DownloadItem *item, gboolean remove_files);
+
+// Pause in the given mode, see [pause] in the config. A paused item holds
+// no scheduler slot; unpausing hands it back to the scheduler.
+gboolean download_item_pause(DownloadItem *item, PauseMode mode);
+gboolean download_item_unpause(DownloadItem *item);
+
+// Scheduler-side parking of a process group while its stage is full
+gboolean download_item_suspend(DownloadItem *item);
+gboolean download_item_resume(DownloadItem *item);
+
+// Kill a hung download's whole process group. It finishes as FAILED with
+// the given reason, so the scheduler's retry policy applies.
+gboolean download_item_abort(DownloadItem *item, const char *reason);
+
+// Apply one line of yt-dlp output (progress, post-processor step or error)
+// to the item. Returns TRUE if the line was recognised.
+gboolean download_engine_parse_line(DownloadItem *item, const char *line);
 
 #endif
@@ -0,0 +1,60 @@
+#include "download_schedule.h"
+
+// Time-of-day download windows. The scheduler looks up the window for each
+// item on every tick, so window boundaries take effect within a tick.
+
+static gboolean window_has_day(const ScheduleWindow *window, int day) {
+    return window->days == 0 || (window->days & (1 << day));
+}
+
+gboolean download_schedule_is_open(const ScheduleWindow *window, GDateTime *now) {
+    int minute = g_date_time_get_hour(now) * 60 + g_date_time_get_minute(now);
+    int day = g_date_time_get_day_of_week(now) - 1;
+
+    if (window->start_minute == window->end_minute) {
+        return window_has_day(window, day);
+    }
+    if (window->start_minute < window->end_minute) {
+        return minute >= window->start_minute && minute < window->end_minute &&
+               window_has_day(window, day);
+    }
+
+    // Wraps past midnight: the early part belongs to the previous day
+    return (minute >= window->start_minute && window_has_day(window, day)) ||
+           (minute < window->end_minute && window_has_day(window, (day + 6) % 7));
+}
+
+// "example.com" matches example.com and any subdomain of it
+gboolean download_schedule_matches(const ScheduleWindow *window, const char *domain) {
+    if (!window->domains) return TRUE;
+    if (!domain) return FALSE;
+
+    for (int i = 0; window->domains[i] != NULL; i++) {
+        const char *suffix = window->domains[i];
+        gsize domain_len = strlen(domain);
+        gsize suffix_len = strlen(suffix);
+
+        if (g_ascii_strcasecmp(domain, suffix) == 0) return TRUE;
+        if (domain_len > suffix_len && domain[domain_len - suffix_len - 1] == '.' &&
+            g_ascii_strcasecmp(domain + domain_len - suffix_len, suffix) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+int download_schedule_lookup(AppConfig *config, DownloadItem *item, GDateTime *now) {
+    for (int i = 0; i < config->schedule_window_count; i++) {
+        const ScheduleWindow *window = &config->schedule_windows[i];
+        if (download_schedule_matches(window, item->domain) &&
+            download_schedule_is_open(window, now)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int64_t download_schedule_rate_limit(const ScheduleWindow *window) {
+    if (!window || window->rate_limit_kib < 0) return -1;
+    return (int64_t)window->rate_limit_kib * 1024;
+}
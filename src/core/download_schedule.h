@@ -0,0 +1,17 @@
+#ifndef DOWNLOAD_SCHEDULE_H
+#define DOWNLOAD_SCHEDULE_H
+
+#include "common.h"
+#include "../utils/config.h"
+
+// Index into config->schedule_windows of the first window that is open at
+// the given local time and matches the item's host, -1 if none does
+int download_schedule_lookup(AppConfig *config, DownloadItem *item, GDateTime *now);
+
+gboolean download_schedule_is_open(const ScheduleWindow *window, GDateTime *now);
+gboolean download_schedule_matches(const ScheduleWindow *window, const char *domain);
+
+// Rate limit in bytes/s a window imposes, -1 to keep the item's own
+int64_t download_schedule_rate_limit(const ScheduleWindow *window);
+
+#endif
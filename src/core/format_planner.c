@@ -0,0 +1,485 @@
+#include "format_planner.h"
+#include "../utils/config.h"
+#include "../utils/string_utils.h"
+#include <string.h>
+
+typedef enum {
+    CODEC_OTHER,
+    CODEC_H264,
+    CODEC_HEVC,
+    CODEC_VP8,
+    CODEC_VP9,
+    CODEC_AV1,
+    CODEC_AAC,
+    CODEC_OPUS,
+    CODEC_VORBIS,
+    CODEC_MP3,
+    CODEC_FLAC,
+    CODEC_AC3
+} Codec;
+
+#define CODEC_BIT(codec) (1u << (codec))
+
+// yt-dlp reports RFC 6381 style codec strings ("avc1.640028", "mp4a.40.2");
+// the short names are what a user writes in the preferences
+static const struct {
+    const char *prefix;
+    Codec codec;
+} codec_prefixes[] = {
+    { "avc", CODEC_H264 },
+    { "h264", CODEC_H264 },
+    { "hev", CODEC_HEVC },
+    { "hvc", CODEC_HEVC },
+    { "h265", CODEC_HEVC },
+    { "vp8", CODEC_VP8 },
+    { "vp9", CODEC_VP9 },
+    { "vp09", CODEC_VP9 },
+    { "av01", CODEC_AV1 },
+    { "av1", CODEC_AV1 },
+    { "mp4a", CODEC_AAC },
+    { "aac", CODEC_AAC },
+    { "opus", CODEC_OPUS },
+    { "vorbis", CODEC_VORBIS },
+    { "mp3", CODEC_MP3 },
+    { "flac", CODEC_FLAC },
+    { "ac-3", CODEC_AC3 },
+    { "ec-3", CODEC_AC3 },
+};
+
+// Codecs ffmpeg can stream-copy into each container, and the ffmpeg
+// arguments that re-encode a stream that doesn't fit
+typedef struct {
+    const char *name;
+    guint video;
+    guint audio;
+    const char *video_encoder;
+    const char *audio_encoder;
+} Container;
+
+static const Container container_mp4 = {
+    "mp4",
+    CODEC_BIT(CODEC_H264) | CODEC_BIT(CODEC_HEVC) | CODEC_BIT(CODEC_AV1) | CODEC_BIT(CODEC_VP9),
+    CODEC_BIT(CODEC_AAC) | CODEC_BIT(CODEC_MP3) | CODEC_BIT(CODEC_OPUS) | CODEC_BIT(CODEC_FLAC) |
+        CODEC_BIT(CODEC_AC3),
+    "-c:v libx264",
+    "-c:a aac",
+};
+static const Container container_webm = {
+    "webm",
+    CODEC_BIT(CODEC_VP8) | CODEC_BIT(CODEC_VP9) | CODEC_BIT(CODEC_AV1),
+    CODEC_BIT(CODEC_OPUS) | CODEC_BIT(CODEC_VORBIS),
+    "-c:v libvpx-vp9",
+    "-c:a libopus",
+};
+// Holds any codec, so streams that don't fit the target are merged here first
+static const Container container_mkv = { "mkv", ~0u, ~0u, NULL, NULL };
+
+// Audio targets and the codec a stream needs to be copied into them
+typedef struct {
+    const char *name;
+    Codec codec;
+} AudioTarget;
+
+static const AudioTarget audio_targets[] = {
+    [FORMAT_MP3] = { "mp3", CODEC_MP3 },
+    [FORMAT_M4A] = { "m4a", CODEC_AAC },
+    [FORMAT_OPUS] = { "opus", CODEC_OPUS },
+};
+
+static const int quality_max_height[] = {
+    [QUALITY_BEST] = 0,
+    [QUALITY_1080P] = 1080,
+    [QUALITY_720P] = 720,
+    [QUALITY_480P] = 480,
+    [QUALITY_360P] = 360,
+};
+
+// The [formats] preferences together with the item's quality option
+typedef struct {
+    char **vcodecs;
+    char **acodecs;
+    int max_height;         // 0 = no cap
+    int min_fps;
+    int64_t max_size;       // Bytes, 0 = no budget
+    gboolean prefer_smaller;
+} FormatRules;
+
+// The streams taken: a video and an audio stream, or one stream alone
+typedef struct {
+    const FormatInfo *first;
+    const FormatInfo *second;
+    int64_t size;           // 0 when a stream's size isn't known
+    gboolean over_budget;
+} StreamPick;
+
+static Codec codec_of(const char *name) {
+    if (!name) return CODEC_OTHER;
+
+    for (gsize i = 0; i < G_N_ELEMENTS(codec_prefixes); i++) {
+        if (g_ascii_strncasecmp(name, codec_prefixes[i].prefix,
+                                strlen(codec_prefixes[i].prefix)) == 0) {
+            return codec_prefixes[i].codec;
+        }
+    }
+    return CODEC_OTHER;
+}
+
+static gboolean fits(const FormatInfo *format, const Container *container) {
+    return (!format->has_video || (container->video & CODEC_BIT(codec_of(format->vcodec)))) &&
+           (!format->has_audio || (container->audio & CODEC_BIT(codec_of(format->acodec))));
+}
+
+static void rules_load(FormatRules *rules, const DownloadOptions *opts) {
+    AppConfig *config = config_get();
+
+    rules->vcodecs = config->format_vcodecs;
+    rules->acodecs = config->format_acodecs;
+    rules->min_fps = config->format_min_fps;
+    rules->max_size = (int64_t)config->format_max_size_mib * 1024 * 1024;
+    rules->prefer_smaller = config->format_prefer_smaller;
+
+    // The lower of the quality option and the configured cap
+    rules->max_height = config->format_max_height;
+    if (!opts->audio_only && opts->quality >= QUALITY_BEST && opts->quality <= QUALITY_360P) {
+        int quality_height = quality_max_height[opts->quality];
+        if (quality_height > 0 && (rules->max_height == 0 || quality_height < rules->max_height)) {
+            rules->max_height = quality_height;
+        }
+    }
+}
+
+// Position of the codec in a preference list, after all of them if absent
+static int preference_rank(char **preferred, const char *codec) {
+    if (!preferred) return 0;
+
+    Codec family = codec_of(codec);
+    int i;
+    for (i = 0; preferred[i] != NULL; i++) {
+        Codec wanted = codec_of(preferred[i]);
+        if (wanted != CODEC_OTHER ? wanted == family
+                                  : codec && g_ascii_strncasecmp(codec, preferred[i],
+                                                                 strlen(preferred[i])) == 0) {
+            return i;
+        }
+    }
+    return i;
+}
+
+// Smaller first with prefer_smaller, larger otherwise; unknown (0) sizes
+// never decide
+static int compare_size(int64_t a, int64_t b, gboolean prefer_smaller) {
+    if (a <= 0 || b <= 0 || a == b) return 0;
+    return (a < b) == prefer_smaller ? -1 : 1;
+}
+
+// Higher first
+static int compare_higher(int a, int b) {
+    return a == b ? 0 : a > b ? -1 : 1;
+}
+
+// Height, then frame rate, then the codec's place in prefer_vcodecs; among
+// those equal the smaller file with prefer_smaller, then the higher bitrate,
+// then the larger file
+static gint compare_video(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const FormatInfo *x = a, *y = b;
+    const FormatRules *rules = user_data;
+
+    if (x->height != y->height) return compare_higher(x->height, y->height);
+    if (x->fps != y->fps) return compare_higher(x->fps, y->fps);
+
+    int rank = preference_rank(rules->vcodecs, x->vcodec) -
+               preference_rank(rules->vcodecs, y->vcodec);
+    if (rank != 0) return rank;
+
+    if (rules->prefer_smaller) {
+        int size = compare_size(x->filesize, y->filesize, TRUE);
+        if (size != 0) return size;
+    }
+    if (x->tbr != y->tbr) return compare_higher(x->tbr, y->tbr);
+    return compare_size(x->filesize, y->filesize, FALSE);
+}
+
+// The codec's place in prefer_acodecs, then as for video
+static gint compare_audio(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const FormatInfo *x = a, *y = b;
+    const FormatRules *rules = user_data;
+
+    int rank = preference_rank(rules->acodecs, x->acodec) -
+               preference_rank(rules->acodecs, y->acodec);
+    if (rank != 0) return rank;
+
+    if (rules->prefer_smaller) {
+        int size = compare_size(x->filesize, y->filesize, TRUE);
+        if (size != 0) return size;
+    }
+    if (x->tbr != y->tbr) return compare_higher(x->tbr, y->tbr);
+    return compare_size(x->filesize, y->filesize, FALSE);
+}
+
+// The best ranked combination within the budget, the smallest one when none
+// is. Without a second list each stream of the first stands alone. A
+// combination of unknown size is assumed to fit.
+static gboolean pick_streams(GList *first, GList *second, gboolean paired, int64_t budget,
+                             StreamPick *pick) {
+    StreamPick smallest = { 0 };
+
+    for (GList *l = first; l != NULL; l = l->next) {
+        GList *m = second;
+        if (paired && !m) break;
+
+        do {
+            const FormatInfo *a = l->data;
+            const FormatInfo *b = paired ? m->data : NULL;
+            int64_t size = (a->filesize > 0 && (!b || b->filesize > 0))
+                ? a->filesize + (b ? b->filesize : 0) : 0;
+
+            if (budget == 0 || size <= budget) {
+                *pick = (StreamPick){ a, b, size, FALSE };
+                return TRUE;
+            }
+            if (!smallest.first || size < smallest.size) {
+                smallest = (StreamPick){ a, b, size, TRUE };
+            }
+            m = paired ? m->next : NULL;
+        } while (m);
+    }
+
+    *pick = smallest;
+    return smallest.first != NULL;
+}
+
+// "399 (av01, 1080p60)", "251 (opus)"
+static char *describe(const FormatInfo *format) {
+    const char *codec = format->has_video ? format->vcodec : format->acodec;
+    if (!codec) codec = "";
+    int codec_length = (int)strcspn(codec, ".");
+
+    if (!format->has_video) {
+        return g_strdup_printf("%s (%.*s)", format->format_id, codec_length, codec);
+    }
+    if (format->fps > 30) {
+        return g_strdup_printf("%s (%.*s, %dp%d)", format->format_id, codec_length, codec,
+                               format->height, format->fps);
+    }
+    return g_strdup_printf("%s (%.*s, %dp)", format->format_id, codec_length, codec, format->height);
+}
+
+static FormatPlan *plan_new(const StreamPick *pick, gboolean transcode, const char *fallback) {
+    FormatPlan *plan = g_malloc0(sizeof(FormatPlan));
+    plan->transcode = transcode;
+    plan->estimated_size = pick->size;
+    plan->over_budget = pick->over_budget;
+    plan->format = pick->second
+        ? g_strdup_printf("%s+%s/%s", pick->first->format_id, pick->second->format_id, fallback)
+        : g_strdup_printf("%s/%s", pick->first->format_id, fallback);
+    return plan;
+}
+
+// "<action>: <streams> <target>, ~812.4 MB"
+static void plan_describe(FormatPlan *plan, const StreamPick *pick, const char *action,
+                          const char *target) {
+    GString *summary = g_string_new(action);
+    char *first = describe(pick->first);
+
+    g_string_append_printf(summary, ": %s", first);
+    if (pick->second) {
+        char *second = describe(pick->second);
+        g_string_append_printf(summary, " + %s", second);
+        g_free(second);
+    }
+    if (target) {
+        g_string_append_printf(summary, " %s", target);
+    }
+    if (plan->estimated_size > 0) {
+        char *size = string_format_size(plan->estimated_size);
+        g_string_append_printf(summary, ", ~%s", size);
+        g_free(size);
+    }
+    if (plan->over_budget) {
+        g_string_append(summary, ", over the size budget");
+    }
+    if (plan->transcode) {
+        g_string_append(summary, ", CPU-bound");
+    }
+
+    g_free(first);
+    plan->summary = g_string_free(summary, FALSE);
+}
+
+static FormatPlan *plan_audio(GList *formats, const DownloadOptions *opts,
+                              const FormatRules *rules) {
+    const AudioTarget *target = NULL;
+    if (opts->format >= 0 && opts->format < (int)G_N_ELEMENTS(audio_targets) &&
+        audio_targets[opts->format].name) {
+        target = &audio_targets[opts->format];
+    }
+
+    GList *audios = NULL, *matching = NULL;
+    for (GList *l = formats; l != NULL; l = l->next) {
+        FormatInfo *format = l->data;
+        if (!format->has_audio || format->has_video || !format->format_id) continue;
+
+        audios = g_list_prepend(audios, format);
+        if (target && codec_of(format->acodec) == target->codec) {
+            matching = g_list_prepend(matching, format);
+        }
+    }
+    audios = g_list_sort_with_data(audios, compare_audio, (gpointer)rules);
+    matching = g_list_sort_with_data(matching, compare_audio, (gpointer)rules);
+
+    FormatPlan *plan = NULL;
+    StreamPick pick;
+    char *target_text = NULL;
+
+    if (target && pick_streams(matching, NULL, FALSE, rules->max_size, &pick)) {
+        target_text = g_strdup_printf("as %s", target->name);
+        plan = plan_new(&pick, FALSE, "bestaudio/best");
+        plan_describe(plan, &pick, "Stream copy", target_text);
+    } else if (target && pick_streams(audios, NULL, FALSE, rules->max_size, &pick)) {
+        target_text = g_strdup_printf("to %s", target->name);
+        plan = plan_new(&pick, TRUE, "bestaudio/best");
+        plan_describe(plan, &pick, "Converts", target_text);
+    } else if (!target && pick_streams(audios, NULL, FALSE, rules->max_size, &pick)) {
+        // No audio format chosen: the stream is kept as it is
+        plan = plan_new(&pick, FALSE, "bestaudio/best");
+        plan_describe(plan, &pick, "Stream copy", NULL);
+    }
+    // Only muxed formats: yt-dlp extracts the audio as before
+
+    if (plan) {
+        plan->audio_format = target ? target->name : NULL;
+    }
+    g_free(target_text);
+    g_list_free(matching);
+    g_list_free(audios);
+    return plan;
+}
+
+// yt-dlp's own selection with the same caps, for when the IDs are gone
+static char *fallback_selector(const FormatRules *rules) {
+    GString *filter = g_string_new(NULL);
+    if (rules->max_height > 0) {
+        g_string_append_printf(filter, "[height<=%d]", rules->max_height);
+    }
+    if (rules->min_fps > 0) {
+        g_string_append_printf(filter, "[fps>=%d]", rules->min_fps);
+    }
+
+    char *selector = g_strdup_printf("bestvideo%s+bestaudio/best", filter->str);
+    g_string_free(filter, TRUE);
+    return selector;
+}
+
+static FormatPlan *plan_video(GList *formats, const DownloadOptions *opts,
+                              const FormatRules *rules) {
+    const Container *container = &container_mp4;
+    if (opts->format == FORMAT_WEBM) {
+        container = &container_webm;
+    } else if (opts->format == FORMAT_MKV) {
+        container = &container_mkv;
+    }
+
+    GList *videos = NULL, *videos_fit = NULL;
+    GList *audios = NULL, *audios_fit = NULL;
+    GList *muxed_fit = NULL;
+    for (GList *l = formats; l != NULL; l = l->next) {
+        FormatInfo *format = l->data;
+        if (!format->format_id || (!format->has_video && !format->has_audio)) continue;
+        if (format->has_video) {
+            if (rules->max_height > 0 && format->height > rules->max_height) continue;
+            // Frame rates that aren't reported don't rule a stream out
+            if (rules->min_fps > 0 && format->fps > 0 && format->fps < rules->min_fps) continue;
+        }
+
+        gboolean fit = fits(format, container);
+        if (format->has_video && format->has_audio) {
+            if (fit) muxed_fit = g_list_prepend(muxed_fit, format);
+        } else if (format->has_video) {
+            videos = g_list_prepend(videos, format);
+            if (fit) videos_fit = g_list_prepend(videos_fit, format);
+        } else {
+            audios = g_list_prepend(audios, format);
+            if (fit) audios_fit = g_list_prepend(audios_fit, format);
+        }
+    }
+    videos = g_list_sort_with_data(videos, compare_video, (gpointer)rules);
+    videos_fit = g_list_sort_with_data(videos_fit, compare_video, (gpointer)rules);
+    audios = g_list_sort_with_data(audios, compare_audio, (gpointer)rules);
+    audios_fit = g_list_sort_with_data(audios_fit, compare_audio, (gpointer)rules);
+    muxed_fit = g_list_sort_with_data(muxed_fit, compare_video, (gpointer)rules);
+
+    char *fallback = fallback_selector(rules);
+    char *target = g_strdup_printf("into %s", container->name);
+    FormatPlan *plan = NULL;
+    StreamPick pair, muxed;
+    gboolean have_pair = pick_streams(videos_fit, audios_fit, TRUE, rules->max_size, &pair);
+    gboolean have_muxed = pick_streams(muxed_fit, NULL, FALSE, rules->max_size, &muxed);
+
+    // A single stream when it is as good; within the budget beats over it.
+    // A lower resolution in the container's own codecs is preferred to
+    // re-encoding the video.
+    if (have_muxed && (!have_pair || (pair.over_budget && !muxed.over_budget) ||
+                       (pair.over_budget == muxed.over_budget &&
+                        compare_video(pair.first, muxed.first, (gpointer)rules) >= 0))) {
+        plan = plan_new(&muxed, FALSE, fallback);
+        plan_describe(plan, &muxed, "Stream copy", target);
+    } else if (have_pair) {
+        plan = plan_new(&pair, FALSE, fallback);
+        plan_describe(plan, &pair, "Stream copy", target);
+    } else {
+        // A stream-copy merge into the target would fail on the codec that
+        // doesn't fit: merge into MKV, then convert with only that stream
+        // re-encoded. Keeping the video and converting the audio is cheapest.
+        gboolean video_fits = pick_streams(videos_fit, audios, TRUE, rules->max_size, &pair);
+        gboolean audio_fits = !video_fits &&
+                              pick_streams(videos, audios_fit, TRUE, rules->max_size, &pair);
+        if (video_fits || audio_fits ||
+            pick_streams(videos, audios, TRUE, rules->max_size, &pair)) {
+            plan = plan_new(&pair, TRUE, fallback);
+            plan->recode_format = container->name;
+            plan->convert_args = g_strdup_printf("VideoConvertor:%s %s",
+                                                 video_fits ? "-c:v copy" : container->video_encoder,
+                                                 audio_fits ? "-c:a copy" : container->audio_encoder);
+            plan_describe(plan, &pair,
+                          video_fits ? "Re-encodes audio" : audio_fits ? "Re-encodes video"
+                                                                       : "Re-encodes",
+                          target);
+        }
+    }
+
+    if (plan) {
+        plan->container = plan->transcode ? container_mkv.name : container->name;
+    }
+    g_free(target);
+    g_free(fallback);
+    g_list_free(muxed_fit);
+    g_list_free(audios_fit);
+    g_list_free(audios);
+    g_list_free(videos_fit);
+    g_list_free(videos);
+    return plan;
+}
+
+FormatPlan* format_planner_plan(GList *formats, const DownloadOptions *opts) {
+    if (!formats || !opts) return NULL;
+
+    FormatRules rules;
+    rules_load(&rules, opts);
+
+    if (opts->audio_only) {
+        return plan_audio(formats, opts, &rules);
+    }
+    if (opts->quality < QUALITY_BEST || opts->quality > QUALITY_360P) {
+        return NULL;
+    }
+    return plan_video(formats, opts, &rules);
+}
+
+void format_plan_free(FormatPlan *plan) {
+    if (!plan) return;
+
+    g_free(plan->format);
+    g_free(plan->convert_args);
+    g_free(plan->summary);
+    g_free(plan);
+}
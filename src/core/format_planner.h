@@ -0,0 +1,36 @@
+#ifndef FORMAT_PLANNER_H
+#define FORMAT_PLANNER_H
+
+#include "common.h"
+
+// Picks the streams to download from the format list so that producing the
+// requested container or audio format is a stream copy. yt-dlp's own
+// "bestaudio" for MP3/M4A/Opus and "bestvideo+bestaudio" for a container
+// often select codecs that then have to be re-encoded; here a stream that
+// already has the target codec wins, and a transcode is only planned when
+// no such stream exists.
+//
+// Within that, the [formats] rules of the config decide: a height cap and
+// minimum frame rate filter the streams, and the best ranked pair within
+// the size budget is taken. Video ranks by height, then frame rate, then
+// prefer_vcodecs, then size (smaller first with prefer_smaller) and
+// bitrate; audio by prefer_acodecs, then size and bitrate.
+typedef struct {
+    char *format;               // -f selector, exact format IDs first
+    const char *container;      // --merge-output-format, NULL for audio, mkv before a recode
+    const char *audio_format;   // -x --audio-format, NULL = keep the codec
+    const char *recode_format;  // --recode-video, NULL = no video re-encode
+    char *convert_args;         // --postprocessor-args for the recode: copies the stream that fits
+    gboolean transcode;         // Post-processing re-encodes: CPU-bound
+    int64_t estimated_size;     // Sum of the chosen streams, 0 = not known
+    gboolean over_budget;       // Nothing fits max_size_mib; the smallest was taken
+    char *summary;              // One line for the UI and the log
+} FormatPlan;
+
+// NULL when yt-dlp should choose as before: no format list, no stream to
+// plan with, or a video download with a custom format. Audio-only downloads
+// never used the quality option, custom included, so they are planned.
+FormatPlan* format_planner_plan(GList *formats, const DownloadOptions *opts);
+void format_plan_free(FormatPlan *plan);
+
+#endif
@@ -0,0 +1,726 @@
+#include "http_backend.h"
+#include "../utils/config.h"
+#include "../utils/string_utils.h"
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+#define READ_BUFFER_SIZE (64 * 1024)
+#define PROGRESS_INTERVAL_MS 500
+#define STATE_SAVE_INTERVAL_US (5 * G_USEC_PER_SEC)
+#define RETRY_DELAY_US G_USEC_PER_SEC
+#define SPEED_SMOOTHING 0.3
+
+// Direct links the generic extractor would download unchanged
+static const char *media_extensions[] = {
+    "mp4", "m4v", "mkv", "webm", "mov", "avi", "flv", "ts",
+    "mp3", "m4a", "aac", "ogg", "oga", "opus", "flac", "wav", NULL
+};
+
+typedef struct {
+    int64_t start;
+    int64_t end;                // Exclusive, -1 = until the stream ends
+    _Atomic int64_t next;       // First byte not written yet
+    atomic_bool complete;
+} HttpSegment;
+
+typedef struct {
+    DownloadItem *item;         // Main thread only, NULL once released
+    char *url;
+    char *path;
+    char *part_path;
+    char *state_path;
+    int64_t rate_limit;         // Bytes/s for the whole file, 0 = unlimited
+    int connections;
+    int64_t min_segment;
+    int retries;
+
+    // Set by the transfer thread before planned becomes TRUE, fixed after
+    int fd;
+    int64_t total;              // -1 if the server doesn't say
+    char *validator;            // ETag or Last-Modified
+    gboolean ranges;
+    HttpSegment *segments;
+    int segment_count;
+    int64_t resumed_bytes;      // Already in the .part file at the start
+    gboolean present;           // An earlier run's complete file is at path
+    atomic_bool planned;
+
+    GCancellable *cancellable;
+    GMutex lock;
+    GCond resumed;
+    gboolean suspended;         // Under lock
+    gboolean finished;          // Under lock, the state file is settled
+    GError *error;              // Under lock, first failure
+    GThread *thread;
+
+    // Main thread
+    guint progress_id;
+    gboolean baseline_taken;
+    int64_t reported;           // Bytes already accounted to the item
+    gint64 last_tick;
+    gint64 last_state_save;
+} HttpTransfer;
+
+typedef struct {
+    HttpTransfer *transfer;
+    HttpSegment *segment;
+    GInputStream *stream;       // Already open at the segment's start, or NULL
+} HttpSegmentJob;
+
+// Unescaped last path component of an http(s) URL, NULL for anything else
+static char *url_file_name(const char *url) {
+    GUri *uri = g_uri_parse(url, G_URI_FLAGS_NONE, NULL);
+    if (!uri) return NULL;
+
+    char *name = NULL;
+    const char *scheme = g_uri_get_scheme(uri);
+    if (g_ascii_strcasecmp(scheme, "http") == 0 || g_ascii_strcasecmp(scheme, "https") == 0) {
+        char *basename = g_path_get_basename(g_uri_get_path(uri));
+        name = g_uri_unescape_string(basename, NULL);
+        g_free(basename);
+    }
+
+    g_uri_unref(uri);
+    return name;
+}
+
+static gboolean has_media_extension(const char *name) {
+    const char *dot = strrchr(name, '.');
+    if (!dot || dot == name) return FALSE;
+
+    for (int i = 0; media_extensions[i] != NULL; i++) {
+        if (g_ascii_strcasecmp(dot + 1, media_extensions[i]) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Only options that change nothing for a single direct file are allowed:
+// audio extraction, cutting, custom formats and yt-dlp output templates
+// stay with yt-dlp
+static gboolean http_backend_accepts(const DownloadItem *item) {
+    const DownloadOptions *opts = item->options;
+    if (!config_get()->native_downloads || opts->audio_only || opts->output_template ||
+        (opts->time_range_start && *opts->time_range_start) || opts->clips ||
+        (opts->quality == QUALITY_CUSTOM && opts->custom_format)) {
+        return FALSE;
+    }
+
+    char *name = url_file_name(item->url);
+    gboolean accepted = name && has_media_extension(name);
+    g_free(name);
+    return accepted;
+}
+
+static void http_transfer_fail(HttpTransfer *transfer, GError *error) {
+    g_mutex_lock(&transfer->lock);
+    if (!transfer->error) {
+        transfer->error = error;
+        error = NULL;
+    }
+    g_mutex_unlock(&transfer->lock);
+    g_clear_error(&error);
+
+    // The other connections have no reason to continue
+    g_cancellable_cancel(transfer->cancellable);
+}
+
+static gboolean http_transfer_cancelled(HttpTransfer *transfer) {
+    return g_cancellable_is_cancelled(transfer->cancellable);
+}
+
+// Block while the transfer is suspended; FALSE once it is cancelled
+static gboolean http_transfer_wait(HttpTransfer *transfer) {
+    g_mutex_lock(&transfer->lock);
+    while (transfer->suspended && !http_transfer_cancelled(transfer)) {
+        g_cond_wait(&transfer->resumed, &transfer->lock);
+    }
+    g_mutex_unlock(&transfer->lock);
+    return !http_transfer_cancelled(transfer);
+}
+
+static SoupSession *http_session_new(void) {
+    return soup_session_new_with_options("user-agent", "datareel/" APP_VERSION,
+                                         "timeout", 30, NULL);
+}
+
+// GET the file from byte from (to the end if to is -1). Fails for anything
+// but a 2xx answer, worded like yt-dlp so failures are classified alike.
+static GInputStream *http_open(SoupSession *session, HttpTransfer *transfer, int64_t from,
+                               int64_t to, SoupMessage **msg_out, GError **error) {
+    SoupMessage *msg = soup_message_new(SOUP_METHOD_GET, transfer->url);
+    if (!msg) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid URL: %s",
+                    transfer->url);
+        return NULL;
+    }
+    soup_message_headers_set_range(soup_message_get_request_headers(msg), from, to);
+
+    GInputStream *stream = soup_session_send(session, msg, transfer->cancellable, error);
+    guint status = soup_message_get_status(msg);
+    if (stream && !SOUP_STATUS_IS_SUCCESSFUL(status)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "HTTP Error %u: %s", status,
+                    soup_message_get_reason_phrase(msg));
+        g_clear_object(&stream);
+    }
+
+    if (stream && msg_out) {
+        *msg_out = msg;
+    } else {
+        g_object_unref(msg);
+    }
+    return stream;
+}
+
+static gboolean http_segment_done(const HttpSegment *segment) {
+    return atomic_load(&segment->complete);
+}
+
+static gboolean http_write_all(int fd, const guint8 *data, gsize length, int64_t offset,
+                               GError **error) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "Can't write: %s",
+                        g_strerror(errno));
+            return FALSE;
+        }
+        data += written;
+        length -= written;
+        offset += written;
+    }
+    return TRUE;
+}
+
+// Sleep off the share of the rate limit this connection is ahead of
+static void http_throttle(HttpTransfer *transfer, int64_t sent, gint64 since) {
+    if (transfer->rate_limit <= 0) return;
+
+    int64_t share = MAX(transfer->rate_limit / transfer->segment_count, 1);
+    gint64 due = since + sent * G_USEC_PER_SEC / share;
+    gint64 now = g_get_monotonic_time();
+
+    while (now < due && !http_transfer_cancelled(transfer)) {
+        g_usleep(MIN(due - now, G_USEC_PER_SEC / 10));
+        now = g_get_monotonic_time();
+    }
+}
+
+// Transfer one segment, reconnecting from where it stopped after a network
+// error. Writing errors end the whole transfer.
+static void http_segment_run(HttpTransfer *transfer, HttpSegment *segment, GInputStream *stream) {
+    SoupSession *session = stream ? NULL : http_session_new();
+    guint8 *buffer = g_malloc(READ_BUFFER_SIZE);
+    gint64 since = g_get_monotonic_time();
+    int64_t sent = 0;
+    int attempt = 0;
+
+    while (!http_segment_done(segment) && http_transfer_wait(transfer)) {
+        GError *error = NULL;
+        int64_t next = atomic_load(&segment->next);
+
+        if (!stream) {
+            if (!session) {
+                // A server without ranges can only be read in one go
+                http_transfer_fail(transfer, g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                   "Connection lost and the server doesn't support resuming"));
+                break;
+            }
+            stream = http_open(session, transfer, next,
+                               segment->end > 0 ? segment->end - 1 : -1, NULL, &error);
+        }
+
+        gssize n = -1;
+        if (stream) {
+            gsize want = READ_BUFFER_SIZE;
+            if (segment->end > 0) {
+                want = MIN(want, (gsize)(segment->end - next));
+            }
+            n = g_input_stream_read(stream, buffer, want, transfer->cancellable, &error);
+        }
+
+        if (n > 0) {
+            if (!http_write_all(transfer->fd, buffer, n, next, &error)) {
+                http_transfer_fail(transfer, error);
+                break;
+            }
+            atomic_store(&segment->next, next + n);
+            if (segment->end > 0 && next + n >= segment->end) {
+                atomic_store(&segment->complete, TRUE);
+            }
+            sent += n;
+            attempt = 0;
+            http_throttle(transfer, sent, since);
+            continue;
+        }
+
+        if (n == 0) {
+            if (segment->end < 0) {
+                atomic_store(&segment->complete, TRUE);
+                break;
+            }
+            error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                "Connection closed after %" G_GINT64_FORMAT " of %"
+                                G_GINT64_FORMAT " bytes", next, segment->end);
+        }
+
+        g_clear_object(&stream);
+        if (http_transfer_cancelled(transfer)) {
+            g_clear_error(&error);
+            break;
+        }
+        if (++attempt > transfer->retries) {
+            http_transfer_fail(transfer, error);
+            break;
+        }
+        g_debug("Retrying %s from %" G_GINT64_FORMAT ": %s", transfer->url, next,
+                error ? error->message : "");
+        g_clear_error(&error);
+
+        gint64 resume_at = g_get_monotonic_time() + attempt * RETRY_DELAY_US;
+        while (g_get_monotonic_time() < resume_at && !http_transfer_cancelled(transfer)) {
+            g_usleep(G_USEC_PER_SEC / 10);
+        }
+    }
+
+    g_clear_object(&stream);
+    g_clear_object(&session);
+    g_free(buffer);
+}
+
+static gpointer http_segment_thread(gpointer data) {
+    HttpSegmentJob *job = data;
+    http_segment_run(job->transfer, job->segment, job->stream);
+    g_free(job);
+    return NULL;
+}
+
+// Caller holds the lock or is the only thread left
+static void http_transfer_save_state(HttpTransfer *transfer) {
+    GKeyFile *state = g_key_file_new();
+    GPtrArray *segments = g_ptr_array_new_with_free_func(g_free);
+
+    for (int i = 0; i < transfer->segment_count; i++) {
+        HttpSegment *segment = &transfer->segments[i];
+        g_ptr_array_add(segments, g_strdup_printf("%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT
+                                                  ":%" G_GINT64_FORMAT, segment->start,
+                                                  atomic_load(&segment->next), segment->end));
+    }
+
+    g_key_file_set_string(state, "transfer", "url", transfer->url);
+    g_key_file_set_int64(state, "transfer", "total", transfer->total);
+    if (transfer->validator) {
+        g_key_file_set_string(state, "transfer", "validator", transfer->validator);
+    }
+    g_key_file_set_string_list(state, "transfer", "segments",
+                               (const char * const *)segments->pdata, segments->len);
+
+    GError *error = NULL;
+    if (!g_key_file_save_to_file(state, transfer->state_path, &error)) {
+        g_warning("Can't save transfer state: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_ptr_array_unref(segments);
+    g_key_file_free(state);
+}
+
+// Pick up the segments of an interrupted run of the same remote file
+static gboolean http_transfer_load_state(HttpTransfer *transfer) {
+    GKeyFile *state = g_key_file_new();
+    gboolean loaded = FALSE;
+    GStatBuf part;
+
+    if (g_stat(transfer->part_path, &part) == 0 && part.st_size == transfer->total &&
+        g_key_file_load_from_file(state, transfer->state_path, G_KEY_FILE_NONE, NULL)) {
+        char *url = g_key_file_get_string(state, "transfer", "url", NULL);
+        char *validator = g_key_file_get_string(state, "transfer", "validator", NULL);
+        gint64 total = g_key_file_get_int64(state, "transfer", "total", NULL);
+        gsize count = 0;
+        char **segments = g_key_file_get_string_list(state, "transfer", "segments", &count, NULL);
+
+        if (g_strcmp0(url, transfer->url) == 0 && total == transfer->total &&
+            g_strcmp0(validator, transfer->validator) == 0 && count > 0) {
+            transfer->segments = g_new0(HttpSegment, count);
+            transfer->segment_count = count;
+            loaded = TRUE;
+
+            for (gsize i = 0; i < count && loaded; i++) {
+                HttpSegment *segment = &transfer->segments[i];
+                gint64 start, next, end;
+                loaded = sscanf(segments[i], "%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%"
+                                G_GINT64_FORMAT, &start, &next, &end) == 3 &&
+                         start <= next && next <= end && end <= total;
+                segment->start = start;
+                segment->end = end;
+                atomic_store(&segment->next, next);
+                atomic_store(&segment->complete, next == end);
+                transfer->resumed_bytes += next - start;
+            }
+
+            if (!loaded) {
+                g_clear_pointer(&transfer->segments, g_free);
+                transfer->segment_count = 0;
+                transfer->resumed_bytes = 0;
+            }
+        }
+
+        g_strfreev(segments);
+        g_free(validator);
+        g_free(url);
+    }
+
+    g_key_file_free(state);
+    return loaded;
+}
+
+// Even split into as many segments as connections, but none under the minimum
+static void http_transfer_plan(HttpTransfer *transfer) {
+    int count = 1;
+    if (transfer->ranges && transfer->total > 0) {
+        count = CLAMP(transfer->total / transfer->min_segment, 1, transfer->connections);
+    }
+
+    transfer->segments = g_new0(HttpSegment, count);
+    transfer->segment_count = count;
+
+    int64_t size = transfer->total > 0 ? transfer->total / count : -1;
+    for (int i = 0; i < count; i++) {
+        HttpSegment *segment = &transfer->segments[i];
+        segment->start = i * size;
+        segment->end = i == count - 1 ? transfer->total : (i + 1) * size;
+        atomic_store(&segment->next, segment->start);
+        atomic_store(&segment->complete, segment->end == 0);
+    }
+}
+
+static void http_transfer_download(HttpTransfer *transfer) {
+    SoupSession *session = http_session_new();
+    SoupMessage *msg = NULL;
+    GError *error = NULL;
+
+    // The probe asks for everything; a 206 tells the server takes ranges
+    GInputStream *probe = http_open(session, transfer, 0, -1, &msg, &error);
+    if (!probe) {
+        http_transfer_fail(transfer, error);
+        g_object_unref(session);
+        return;
+    }
+
+    SoupMessageHeaders *headers = soup_message_get_response_headers(msg);
+    const char *etag = soup_message_headers_get_one(headers, "ETag");
+    transfer->validator = g_strdup(etag ? etag : soup_message_headers_get_one(headers, "Last-Modified"));
+
+    goffset start, end, total = -1;
+    if (soup_message_get_status(msg) == SOUP_STATUS_PARTIAL_CONTENT) {
+        transfer->ranges = soup_message_headers_get_content_range(headers, &start, &end, &total) &&
+                           total > 0;
+        transfer->total = transfer->ranges ? total : -1;
+    } else {
+        goffset length = soup_message_headers_get_content_length(headers);
+        transfer->total = length > 0 ? length : -1;
+    }
+    g_object_unref(msg);
+
+    // Downloaded by an earlier run, as yt-dlp would report it. A file that
+    // only shares the URL's name, or one the server can't size, is replaced.
+    GStatBuf existing;
+    if (transfer->total > 0 && !g_file_test(transfer->part_path, G_FILE_TEST_EXISTS) &&
+        g_stat(transfer->path, &existing) == 0 && S_ISREG(existing.st_mode) &&
+        existing.st_size == transfer->total) {
+        transfer->present = TRUE;
+        g_object_unref(probe);
+        g_object_unref(session);
+        return;
+    }
+
+    gboolean resumed = transfer->ranges && http_transfer_load_state(transfer);
+    if (!resumed) {
+        http_transfer_plan(transfer);
+    }
+
+    int flags = O_RDWR | O_CREAT | O_CLOEXEC | (resumed ? 0 : O_TRUNC);
+    transfer->fd = open(transfer->part_path, flags, 0644);
+    if (transfer->fd < 0 ||
+        (transfer->total > 0 && ftruncate(transfer->fd, transfer->total) != 0)) {
+        http_transfer_fail(transfer, g_error_new(G_IO_ERROR, g_io_error_from_errno(errno),
+                                                 "Can't create %s: %s", transfer->part_path,
+                                                 g_strerror(errno)));
+        g_object_unref(probe);
+        g_object_unref(session);
+        return;
+    }
+    atomic_store(&transfer->planned, TRUE);
+
+    // Without ranges the probe is the whole download; with them every
+    // segment asks for its own range, resumed ones included
+    GPtrArray *threads = g_ptr_array_new();
+    if (transfer->ranges) {
+        g_input_stream_close(probe, NULL, NULL);
+        g_clear_object(&probe);
+
+        for (int i = 1; i < transfer->segment_count; i++) {
+            HttpSegmentJob *job = g_malloc0(sizeof(HttpSegmentJob));
+            job->transfer = transfer;
+            job->segment = &transfer->segments[i];
+            g_ptr_array_add(threads, g_thread_new("http-segment", http_segment_thread, job));
+        }
+    }
+    g_object_unref(session);
+
+    http_segment_run(transfer, &transfer->segments[0], g_steal_pointer(&probe));
+    for (guint i = 0; i < threads->len; i++) {
+        g_thread_join(g_ptr_array_index(threads, i));
+    }
+    g_ptr_array_unref(threads);
+}
+
+static gboolean http_transfer_complete(HttpTransfer *transfer) {
+    if (!atomic_load(&transfer->planned)) return FALSE;
+
+    for (int i = 0; i < transfer->segment_count; i++) {
+        if (!http_segment_done(&transfer->segments[i])) return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean http_transfer_done(gpointer data);
+
+static gpointer http_transfer_thread(gpointer data) {
+    HttpTransfer *transfer = data;
+
+    http_transfer_download(transfer);
+    gboolean present = transfer->present;
+
+    if (transfer->fd >= 0) {
+        close(transfer->fd);
+        transfer->fd = -1;
+    }
+
+    g_mutex_lock(&transfer->lock);
+    if (present) {
+        // Nothing to do
+    } else if (http_transfer_complete(transfer) && !transfer->error) {
+        // The state stays with the .part file until it is the finished one
+        if (rename(transfer->part_path, transfer->path) != 0) {
+            transfer->error = g_error_new(G_IO_ERROR, g_io_error_from_errno(errno),
+                                          "Can't rename %s: %s", transfer->part_path,
+                                          g_strerror(errno));
+        } else {
+            unlink(transfer->state_path);
+        }
+    } else if (transfer->ranges && atomic_load(&transfer->planned)) {
+        // Kept for the next start, like yt-dlp's --continue
+        http_transfer_save_state(transfer);
+    }
+    if (!transfer->error && !present && !http_transfer_complete(transfer)) {
+        transfer->error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Interrupted");
+    }
+    transfer->finished = TRUE;
+    g_mutex_unlock(&transfer->lock);
+
+    g_idle_add(http_transfer_done, transfer);
+    return NULL;
+}
+
+static int64_t http_transfer_written(HttpTransfer *transfer) {
+    int64_t written = 0;
+    for (int i = 0; i < transfer->segment_count; i++) {
+        written += atomic_load(&transfer->segments[i].next) - transfer->segments[i].start;
+    }
+    return written;
+}
+
+// Move the connections' progress into the item, no output to parse
+static void http_transfer_report(HttpTransfer *transfer) {
+    DownloadItem *item = transfer->item;
+    if (!item || !atomic_load(&transfer->planned)) return;
+
+    if (!transfer->baseline_taken) {
+        transfer->reported = transfer->resumed_bytes;
+        transfer->baseline_taken = TRUE;
+    }
+
+    gint64 now = g_get_monotonic_time();
+    int64_t written = http_transfer_written(transfer);
+    int64_t delta = written - transfer->reported;
+    transfer->reported = written;
+
+    if (delta > 0) {
+        download_engine_add_bytes(item, delta);
+    }
+    item->file_bytes = written;
+
+    if (transfer->last_tick > 0 && now > transfer->last_tick) {
+        double rate = (double)delta * G_USEC_PER_SEC / (now - transfer->last_tick);
+        item->speed = item->speed > 0 ? item->speed + SPEED_SMOOTHING * (rate - item->speed) : rate;
+    }
+    transfer->last_tick = now;
+
+    if (transfer->total > 0) {
+        item->progress = 100.0 * written / transfer->total;
+        g_free(item->eta);
+        item->eta = item->speed >= 1.0
+            ? string_format_duration((int)((transfer->total - written) / item->speed))
+            : NULL;
+    }
+}
+
+static gboolean http_transfer_tick(gpointer data) {
+    HttpTransfer *transfer = data;
+    http_transfer_report(transfer);
+
+    gint64 now = g_get_monotonic_time();
+    if (transfer->ranges && now - transfer->last_state_save > STATE_SAVE_INTERVAL_US) {
+        g_mutex_lock(&transfer->lock);
+        if (!transfer->finished && atomic_load(&transfer->planned)) {
+            http_transfer_save_state(transfer);
+        }
+        g_mutex_unlock(&transfer->lock);
+        transfer->last_state_save = now;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void http_transfer_free(HttpTransfer *transfer) {
+    if (transfer->progress_id > 0) {
+        g_source_remove(transfer->progress_id);
+    }
+    g_clear_error(&transfer->error);
+    g_clear_object(&transfer->cancellable);
+    g_mutex_clear(&transfer->lock);
+    g_cond_clear(&transfer->resumed);
+    g_free(transfer->segments);
+    g_free(transfer->validator);
+    g_free(transfer->url);
+    g_free(transfer->path);
+    g_free(transfer->part_path);
+    g_free(transfer->state_path);
+    g_free(transfer);
+}
+
+static gboolean http_transfer_done(gpointer data) {
+    HttpTransfer *transfer = data;
+    g_thread_join(transfer->thread);
+
+    DownloadItem *item = transfer->item;
+    if (item) {
+        http_transfer_report(transfer);
+        if (!transfer->error) {
+            item->progress = 100.0;
+            g_clear_pointer(&item->eta, g_free);
+        }
+        item->speed = 0;
+        item->backend_data = NULL;
+        download_engine_backend_finished(item, transfer->error);
+    }
+
+    http_transfer_free(transfer);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean http_backend_start(DownloadItem *item, GError **error) {
+    AppConfig *config = config_get();
+
+    if (g_mkdir_with_parents(item->output_path, 0755) != 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "Can't create %s: %s",
+                    item->output_path, g_strerror(errno));
+        return FALSE;
+    }
+
+    char *raw_name = url_file_name(item->url);
+    char *name = string_sanitize_filename(raw_name);
+    g_free(raw_name);
+
+    HttpTransfer *transfer = g_malloc0(sizeof(HttpTransfer));
+    transfer->item = item;
+    transfer->url = g_strdup(item->url);
+    transfer->path = g_build_filename(item->output_path, name, NULL);
+    transfer->part_path = g_strconcat(transfer->path, ".part", NULL);
+    transfer->state_path = g_strconcat(transfer->part_path, ".state", NULL);
+    transfer->rate_limit = item->scheduled_rate_limit >= 0 ? item->scheduled_rate_limit
+                                                           : item->options->rate_limit;
+    transfer->connections = config->native_connections;
+    transfer->min_segment = (int64_t)config->native_min_segment_mib * 1024 * 1024;
+    transfer->retries = config->ytdlp_retries;
+    transfer->fd = -1;
+    transfer->total = -1;
+    transfer->cancellable = g_cancellable_new();
+    g_mutex_init(&transfer->lock);
+    g_cond_init(&transfer->resumed);
+    g_free(name);
+
+    download_engine_track_file(item, transfer->path);
+
+    transfer->thread = g_thread_try_new("http-transfer", http_transfer_thread, transfer, error);
+    if (!transfer->thread) {
+        http_transfer_free(transfer);
+        return FALSE;
+    }
+
+    transfer->last_state_save = g_get_monotonic_time();
+    transfer->progress_id = g_timeout_add(PROGRESS_INTERVAL_MS, http_transfer_tick, transfer);
+    item->backend_data = transfer;
+
+    g_print("Download started natively: %s\n", transfer->path);
+    return TRUE;
+}
+
+static gboolean http_backend_terminate(DownloadItem *item) {
+    HttpTransfer *transfer = item->backend_data;
+    if (!transfer) return FALSE;
+
+    g_mutex_lock(&transfer->lock);
+    g_cancellable_cancel(transfer->cancellable);
+    g_cond_broadcast(&transfer->resumed);
+    g_mutex_unlock(&transfer->lock);
+    return TRUE;
+}
+
+static gboolean http_backend_set_suspended(DownloadItem *item, gboolean suspended) {
+    HttpTransfer *transfer = item->backend_data;
+    if (!transfer) return FALSE;
+
+    g_mutex_lock(&transfer->lock);
+    transfer->suspended = suspended;
+    g_cond_broadcast(&transfer->resumed);
+    g_mutex_unlock(&transfer->lock);
+    return TRUE;
+}
+
+static gboolean http_backend_suspend(DownloadItem *item) {
+    return http_backend_set_suspended(item, TRUE);
+}
+
+static gboolean http_backend_resume(DownloadItem *item) {
+    return http_backend_set_suspended(item, FALSE);
+}
+
+static void http_backend_release(DownloadItem *item) {
+    HttpTransfer *transfer = item->backend_data;
+    if (!transfer) return;
+
+    // The threads wind down on their own and free the transfer
+    transfer->item = NULL;
+    http_backend_terminate(item);
+    item->backend_data = NULL;
+}
+
+// The threads own no processes, so stopping is immediate either way
+const DownloadBackend http_backend = {
+    .name = "native HTTP",
+    .accepts = http_backend_accepts,
+    .start = http_backend_start,
+    .terminate = http_backend_terminate,
+    .kill = http_backend_terminate,
+    .suspend = http_backend_suspend,
+    .resume = http_backend_resume,
+    .release = http_backend_release,
+};
@@ -0,0 +1,12 @@
+#ifndef HTTP_BACKEND_H
+#define HTTP_BACKEND_H
+
+#include "download_backend.h"
+
+// Built-in downloader for direct links to media files (.mp4, .mp3, ...),
+// used instead of yt-dlp when the options need no yt-dlp processing. Splits
+// the file into ranged requests over several connections ([native] in the
+// config) and resumes from a state file kept next to the .part file.
+extern const DownloadBackend http_backend;
+
+#endif
@@ -1,16 +1,103 @@
 #include "metadata_fetcher.h"
+#include "ytdlp_manager.h"
+#include "metrics.h"
+#include "../utils/config.h"
 #include <json-glib/json-glib.h>
 
+typedef struct {
+    MetadataCallback callback;
+    gpointer user_data;
+    char *url;
+    VideoMetadata *cached;
+} MetadataCallbackData;
+
+typedef struct {
+    char **argv;
+    gboolean prefetch;      // Keep the raw JSON
+} MetadataRequest;
+
+typedef struct {
+    ThumbnailCallback callback;
+    gpointer user_data;
+    char *url;
+} ThumbnailCallbackData;
+
+// Bounded LRU cache of fetched metadata, keyed by URL (main thread only)
+static GHashTable *metadata_cache = NULL;
+static GQueue metadata_cache_order = G_QUEUE_INIT;
+
+static GHashTable *prefetch_pending = NULL;   // URLs queued or in flight
+
+static void metadata_request_free(MetadataRequest *request) {
+    g_strfreev(request->argv);
+    g_free(request);
+}
+
+static void metadata_callback_data_free(MetadataCallbackData *callback_data) {
+    g_free(callback_data->url);
+    g_free(callback_data);
+}
+
+static void metadata_cache_trim(int max_entries) {
+    while (metadata_cache_order.length > (guint)max_entries) {
+        char *oldest = g_queue_pop_head(&metadata_cache_order);
+        g_hash_table_remove(metadata_cache, oldest);
+        g_free(oldest);
+    }
+}
+
+static void metadata_cache_insert(const char *url, VideoMetadata *meta) {
+    int max_entries = config_get()->metadata_cache_size;
+    if (max_entries <= 0 || !meta || !meta->title) return;
+
+    if (!metadata_cache) {
+        metadata_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)metadata_free);
+    }
+
+    GList *link = g_queue_find_custom(&metadata_cache_order, url, (GCompareFunc)strcmp);
+    if (link) {
+        g_free(link->data);
+        g_queue_delete_link(&metadata_cache_order, link);
+    }
+
+    // The raw JSON is only useful to the item that is about to start
+    VideoMetadata *copy = metadata_copy(meta);
+    g_clear_pointer(&copy->info_json, g_free);
+    g_hash_table_replace(metadata_cache, g_strdup(url), copy);
+    g_queue_push_tail(&metadata_cache_order, g_strdup(url));
+    metadata_cache_trim(max_entries);
+}
+
+static VideoMetadata *metadata_cache_lookup(const char *url) {
+    if (!metadata_cache) return NULL;
+
+    // Honour a cache size lowered by a config reload
+    metadata_cache_trim(MAX(config_get()->metadata_cache_size, 0));
+
+    VideoMetadata *meta = g_hash_table_lookup(metadata_cache, url);
+    if (meta) {
+        GList *link = g_queue_find_custom(&metadata_cache_order, url, (GCompareFunc)strcmp);
+        g_queue_unlink(&metadata_cache_order, link);
+        g_queue_push_tail_link(&metadata_cache_order, link);
+    }
+    return meta;
+}
+
+static gboolean metadata_deliver_cached(gpointer user_data) {
+    MetadataCallbackData *callback_data = user_data;
+    callback_data->callback(callback_data->cached, callback_data->user_data);
+    metadata_callback_data_free(callback_data);
+    return G_SOURCE_REMOVE;
+}
+
 // Wrapper to convert between callback types
 static void metadata_async_callback(GObject *source_object, GAsyncResult *result, gpointer user_data) {
     // Suppress unused parameter warning
     (void)source_object;
 
     // Retrieve the original callback and user_data
-    struct {
-        MetadataCallback callback;
-        gpointer user_data;
-    } *callback_data = user_data;
+    MetadataCallbackData *callback_data = user_data;
 
     GTask *task = G_TASK(result);
 
@@ -22,36 +109,265 @@ static void metadata_async_callback(GObject *source_object, GAsyncResult *result
         callback_data->callback(NULL, callback_data->user_data);
         g_error_free(error);
     } else {
+        metadata_cache_insert(callback_data->url, metadata);
         callback_data->callback(metadata, callback_data->user_data);
     }
 
     // Free the callback_data structure
-    g_free(callback_data);
+    metadata_callback_data_free(callback_data);
+}
+
+// Set up a fetch, or deliver a cached result and return NULL
+static GTask *metadata_task_new(const char *url, MetadataCallback callback, gpointer user_data,
+                                GAsyncReadyCallback ready) {
+    // Create a structure to hold both the original callback and user_data
+    MetadataCallbackData *callback_data = g_malloc0(sizeof(MetadataCallbackData));
+
+    callback_data->callback = callback;
+    callback_data->user_data = user_data;
+    callback_data->url = g_strdup(url);
+
+    // Serve repeated lookups from the cache without spawning yt-dlp
+    VideoMetadata *cached = metadata_cache_lookup(url);
+    if (cached) {
+        callback_data->cached = metadata_copy(cached);
+        metrics_counter_add(METRIC_METADATA_CACHE_HITS, 1);
+        g_idle_add(metadata_deliver_cached, callback_data);
+        return NULL;
+    }
+
+    // The launch spec is main-thread only, so build the command before handing off
+    MetadataRequest *request = g_malloc0(sizeof(MetadataRequest));
+    request->argv = ytdlp_launch_argv("--dump-json", "--no-playlist", url, NULL);
+
+    GTask *task = g_task_new(NULL, NULL, ready, callback_data);
+    g_task_set_task_data(task, request, (GDestroyNotify)metadata_request_free);
+    return task;
 }
 
 // Fetch video metadata using yt-dlp --dump-json
 void metadata_fetch_async(const char *url, MetadataCallback callback, gpointer user_data) {
-    // Create a structure to hold both the original callback and user_data
-    struct {
-        MetadataCallback callback;
-        gpointer user_data;
-    } *callback_data = g_malloc(sizeof(*callback_data));
+    GTask *task = metadata_task_new(url, callback, user_data, metadata_async_callback);
+    if (task) {
+        work_pool_run_task(WORK_LANE_INTERACTIVE, task, metadata_fetch_thread);
+        g_object_unref(task);
+    }
+}
+
+static void metadata_prefetch_callback(GObject *source_object, GAsyncResult *result,
+                                       gpointer user_data) {
+    MetadataCallbackData *callback_data = user_data;
+    if (prefetch_pending) {
+        g_hash_table_remove(prefetch_pending, callback_data->url);
+    }
+    metadata_async_callback(source_object, result, user_data);
+}
+
+gboolean metadata_prefetch_async(const char *url, MetadataCallback callback, gpointer user_data) {
+    if (metadata_prefetch_pending(url)) {
+        return FALSE;
+    }
+
+    if (!prefetch_pending) {
+        prefetch_pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    GTask *task = metadata_task_new(url, callback, user_data, metadata_prefetch_callback);
+    if (!task) {
+        return TRUE;
+    }
+
+    MetadataRequest *request = g_task_get_task_data(task);
+    request->prefetch = TRUE;
+
+    g_hash_table_add(prefetch_pending, g_strdup(url));
+    metrics_counter_add(METRIC_METADATA_PREFETCHES, 1);
+    work_pool_run_task(WORK_LANE_BACKGROUND, task, metadata_fetch_thread);
+    g_object_unref(task);
+    return TRUE;
+}
+
+gboolean metadata_prefetch_pending(const char *url) {
+    return prefetch_pending && g_hash_table_contains(prefetch_pending, url);
+}
+
+void metadata_prefetch_cleanup(void) {
+    g_clear_pointer(&prefetch_pending, g_hash_table_destroy);
+}
+
+static void thumbnail_fetch_thread(GTask *task, gpointer source,
+                                   gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    (void)cancellable;
+
+    const char *url = task_data;
+    GError *error = NULL;
+    GdkPixbuf *pixbuf = NULL;
+    GFile *thumb_file = g_file_new_for_uri(url);
+    GInputStream *stream = G_INPUT_STREAM(g_file_read(thumb_file, NULL, &error));
+
+    if (stream) {
+        pixbuf = gdk_pixbuf_new_from_stream(stream, NULL, &error);
+        g_object_unref(stream);
+    }
+    g_object_unref(thumb_file);
+
+    if (error) {
+        g_task_return_error(task, error);
+    } else {
+        g_task_return_pointer(task, pixbuf, g_object_unref);
+    }
+}
+
+static void thumbnail_async_callback(GObject *source_object, GAsyncResult *result,
+                                     gpointer user_data) {
+    (void)source_object;
+    ThumbnailCallbackData *callback_data = user_data;
+    GError *error = NULL;
+
+    GdkPixbuf *pixbuf = g_task_propagate_pointer(G_TASK(result), &error);
+    if (error) {
+        g_warning("Failed to download thumbnail: %s", error->message);
+        g_error_free(error);
+    }
+
+    callback_data->callback(callback_data->url, pixbuf, callback_data->user_data);
 
+    g_free(callback_data->url);
+    g_free(callback_data);
+}
+
+void metadata_thumbnail_async(const char *url, WorkLane lane,
+                              ThumbnailCallback callback, gpointer user_data) {
+    ThumbnailCallbackData *callback_data = g_malloc0(sizeof(ThumbnailCallbackData));
     callback_data->callback = callback;
     callback_data->user_data = user_data;
+    callback_data->url = g_strdup(url);
 
-    GTask *task = g_task_new(NULL, NULL, metadata_async_callback, callback_data);
+    GTask *task = g_task_new(NULL, NULL, thumbnail_async_callback, callback_data);
     g_task_set_task_data(task, g_strdup(url), g_free);
-    g_task_run_in_thread(task, metadata_fetch_thread);
+    work_pool_run_task(lane, task, thumbnail_fetch_thread);
     g_object_unref(task);
 }
 
+// Quality choices offered in the options panel; the index of each entry is
+// the VideoQuality value it maps to.
+static const char *quality_labels[] = {
+    "Best Quality", "1080p", "720p", "480p", "360p", "Audio Only", NULL
+};
+
+static char *json_dup_string(JsonObject *obj, const char *member) {
+    const char *value = json_object_get_string_member_with_default(obj, member, NULL);
+    return value ? g_strdup(value) : NULL;
+}
+
+static FormatInfo *format_info_from_json(JsonObject *obj) {
+    FormatInfo *format = g_malloc0(sizeof(FormatInfo));
+
+    format->format_id = json_dup_string(obj, "format_id");
+    format->format_note = json_dup_string(obj, "format_note");
+    format->ext = json_dup_string(obj, "ext");
+    format->vcodec = json_dup_string(obj, "vcodec");
+    format->acodec = json_dup_string(obj, "acodec");
+    format->width = json_object_get_int_member_with_default(obj, "width", 0);
+    format->height = json_object_get_int_member_with_default(obj, "height", 0);
+    format->fps = (int)json_object_get_double_member_with_default(obj, "fps", 0);
+    format->tbr = (int)json_object_get_double_member_with_default(obj, "tbr", 0);
+
+    // Exact size when the server reports it, yt-dlp's estimate otherwise
+    format->filesize = json_object_get_int_member_with_default(obj, "filesize", 0);
+    if (format->filesize <= 0) {
+        format->filesize = json_object_get_int_member_with_default(obj, "filesize_approx", 0);
+    }
+
+    format->has_video = format->vcodec && strcmp(format->vcodec, "none") != 0;
+    format->has_audio = format->acodec && strcmp(format->acodec, "none") != 0;
+
+    return format;
+}
+
+// Parse the output of yt-dlp --dump-json. The thumbnail is not fetched.
+VideoMetadata* metadata_parse_json(const char *json, gssize length, GError **error) {
+    JsonParser *parser = json_parser_new();
+
+    if (!json_parser_load_from_data(parser, json, length, error)) {
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    JsonNode *root = json_parser_get_root(parser);
+    if (!root || !JSON_NODE_HOLDS_OBJECT(root)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "Metadata is not a JSON object");
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    JsonObject *obj = json_node_get_object(root);
+    VideoMetadata *meta = g_malloc0(sizeof(VideoMetadata));
+
+    // Extract metadata
+    meta->title = json_dup_string(obj, "title");
+    meta->uploader = json_dup_string(obj, "uploader");
+    meta->thumbnail_url = json_dup_string(obj, "thumbnail");
+    meta->description = json_dup_string(obj, "description");
+    meta->format_note = json_dup_string(obj, "format_note");
+
+    if (json_object_has_member(obj, "duration")) {
+        int duration = (int)json_object_get_double_member_with_default(obj, "duration", 0);
+        meta->duration = g_strdup_printf("%02d:%02d:%02d",
+                                        duration / 3600,
+                                        (duration % 3600) / 60,
+                                        duration % 60);
+    }
+
+    if (json_object_has_member(obj, "formats")) {
+        JsonArray *formats = json_object_get_array_member(obj, "formats");
+        guint count = formats ? json_array_get_length(formats) : 0;
+
+        for (guint i = 0; i < count; i++) {
+            JsonObject *format_obj = json_array_get_object_element(formats, i);
+            if (format_obj) {
+                meta->formats = g_list_prepend(meta->formats, format_info_from_json(format_obj));
+            }
+        }
+        meta->formats = g_list_reverse(meta->formats);
+    }
+
+    // Size of the selected format(s): explicit, approximate, or the sum of
+    // the separately downloaded video and audio streams
+    meta->filesize = json_object_get_int_member_with_default(obj, "filesize", 0);
+    if (meta->filesize <= 0) {
+        meta->filesize = json_object_get_int_member_with_default(obj, "filesize_approx", 0);
+    }
+    if (meta->filesize <= 0 && json_object_has_member(obj, "requested_formats")) {
+        JsonArray *requested = json_object_get_array_member(obj, "requested_formats");
+        guint count = requested ? json_array_get_length(requested) : 0;
+
+        for (guint i = 0; i < count; i++) {
+            JsonObject *format_obj = json_array_get_object_element(requested, i);
+            gint64 size = json_object_get_int_member_with_default(format_obj, "filesize", 0);
+            if (size <= 0) {
+                size = json_object_get_int_member_with_default(format_obj, "filesize_approx", 0);
+            }
+            meta->filesize += size;
+        }
+    }
+
+    if (meta->formats) {
+        meta->available_qualities = g_strdupv((char **)quality_labels);
+    }
+
+    g_object_unref(parser);
+    return meta;
+}
+
 void metadata_fetch_thread(GTask *task, gpointer source,
                            gpointer task_data, GCancellable *cancellable) {
     (void)source;
     (void)cancellable;
 
-    const char *url = (const char *)task_data;
+    MetadataRequest *request = (MetadataRequest *)task_data;
     VideoMetadata *meta = g_malloc0(sizeof(VideoMetadata));
 
     char *output = NULL;
@@ -59,82 +375,33 @@ void metadata_fetch_thread(GTask *task, gpointer source,
     int exit_status;
     GError *error = NULL;
 
-    char *cmd[] = {
-        "yt-dlp",
-        "--dump-json",
-        "--no-playlist",
-        (char *)url,
-        NULL
-    };
+    gint64 fetch_start = g_get_monotonic_time();
+    gboolean spawned = g_spawn_sync(NULL, request->argv, NULL, G_SPAWN_SEARCH_PATH,
+                                    NULL, NULL, &output, &stderr_output, &exit_status, &error);
 
-    if (g_spawn_sync(NULL, cmd, NULL, G_SPAWN_SEARCH_PATH,
-                    NULL, NULL, &output, &stderr_output, &exit_status, &error)) {
+    metrics_counter_add(METRIC_METADATA_FETCHES, 1);
+    metrics_histogram_observe(METRIC_METADATA_LATENCY, g_get_monotonic_time() - fetch_start);
+
+    if (spawned) {
 
         if (exit_status == 0 && output) {
             // Parse JSON
-            JsonParser *parser = json_parser_new();
             GError *json_error = NULL;
+            VideoMetadata *parsed = metadata_parse_json(output, -1, &json_error);
+
+            if (parsed) {
+                metadata_free(meta);
+                meta = parsed;
 
-            if (json_parser_load_from_data(parser, output, -1, &json_error)) {
-                JsonNode *root = json_parser_get_root(parser);
-
-                if (JSON_NODE_HOLDS_OBJECT(root)) {
-                    JsonObject *obj = json_node_get_object(root);
-
-                    // Extract metadata
-                    if (json_object_has_member(obj, "title")) {
-                        meta->title = g_strdup(json_object_get_string_member(obj, "title"));
-                    }
-                    if (json_object_has_member(obj, "uploader")) {
-                        meta->uploader = g_strdup(json_object_get_string_member(obj, "uploader"));
-                    }
-                    if (json_object_has_member(obj, "duration")) {
-                        int duration = json_object_get_int_member(obj, "duration");
-                        meta->duration = g_strdup_printf("%02d:%02d:%02d",
-                                                        duration / 3600,
-                                                        (duration % 3600) / 60,
-                                                        duration % 60);
-                    }
-                    if (json_object_has_member(obj, "thumbnail")) {
-                        meta->thumbnail_url = g_strdup(json_object_get_string_member(obj, "thumbnail"));
-                    }
-                    if (json_object_has_member(obj, "description")) {
-                        meta->description = g_strdup(json_object_get_string_member(obj, "description"));
-                    }
-                    if (json_object_has_member(obj, "filesize")) {
-                        meta->filesize = json_object_get_int_member(obj, "filesize");
-                    }
-                    if (json_object_has_member(obj, "format_note")) {
-                        meta->format_note = g_strdup(json_object_get_string_member(obj, "format_note"));
-                    }
+                // Lets the download skip extraction with --load-info-json
+                if (request->prefetch) {
+                    meta->info_json = g_steal_pointer(&output);
+                    meta->info_json_time = g_get_monotonic_time();
                 }
             } else {
                 g_warning("Failed to parse JSON: %s", json_error ? json_error->message : "Unknown error");
                 g_clear_error(&json_error);
             }
-            g_object_unref(parser);
-
-            // Download thumbnail
-            if (meta->thumbnail_url) {
-                GError *thumb_error = NULL;
-                GInputStream *stream = NULL;
-                GFile *thumb_file = g_file_new_for_uri(meta->thumbnail_url);
-
-                stream = G_INPUT_STREAM(g_file_read(thumb_file, NULL, &thumb_error));
-
-                if (stream) {
-                    meta->thumbnail_pixbuf = gdk_pixbuf_new_from_stream(stream, NULL, &thumb_error);
-                    g_object_unref(stream);
-                }
-
-                if (thumb_error) {
-                    g_warning("Failed to download thumbnail: %s", thumb_error->message);
-                    g_clear_error(&thumb_error);
-                    meta->thumbnail_pixbuf = NULL;
-                }
-
-                g_object_unref(thumb_file);
-            }
         }
     }
 
@@ -148,6 +415,54 @@ void metadata_fetch_thread(GTask *task, gpointer source,
     }
 }
 
+FormatInfo* format_info_copy(const FormatInfo *format) {
+    FormatInfo *copy = g_malloc0(sizeof(FormatInfo));
+    *copy = *format;
+    copy->format_id = g_strdup(format->format_id);
+    copy->format_note = g_strdup(format->format_note);
+    copy->ext = g_strdup(format->ext);
+    copy->vcodec = g_strdup(format->vcodec);
+    copy->acodec = g_strdup(format->acodec);
+    return copy;
+}
+
+void format_info_free(FormatInfo *format) {
+    if (!format) return;
+
+    g_free(format->format_id);
+    g_free(format->format_note);
+    g_free(format->ext);
+    g_free(format->vcodec);
+    g_free(format->acodec);
+    g_free(format);
+}
+
+VideoMetadata* metadata_copy(const VideoMetadata *meta) {
+    if (!meta) return NULL;
+
+    VideoMetadata *copy = g_malloc0(sizeof(VideoMetadata));
+    copy->title = g_strdup(meta->title);
+    copy->uploader = g_strdup(meta->uploader);
+    copy->duration = g_strdup(meta->duration);
+    copy->thumbnail_url = g_strdup(meta->thumbnail_url);
+    copy->description = g_strdup(meta->description);
+    copy->filesize = meta->filesize;
+    copy->format_note = g_strdup(meta->format_note);
+    copy->available_qualities = g_strdupv(meta->available_qualities);
+    copy->info_json = g_strdup(meta->info_json);
+    copy->info_json_time = meta->info_json_time;
+
+    for (GList *l = meta->formats; l != NULL; l = l->next) {
+        copy->formats = g_list_prepend(copy->formats, format_info_copy(l->data));
+    }
+    copy->formats = g_list_reverse(copy->formats);
+
+    if (meta->thumbnail_pixbuf) {
+        copy->thumbnail_pixbuf = g_object_ref(meta->thumbnail_pixbuf);
+    }
+
+    return copy;
+}
 
 void metadata_free(VideoMetadata *meta) {
     if (!meta) return;
@@ -158,6 +473,9 @@ void metadata_free(VideoMetadata *meta) {
     g_free(meta->thumbnail_url);
     g_free(meta->description);
     g_free(meta->format_note);
+    g_strfreev(meta->available_qualities);
+    g_free(meta->info_json);
+    g_list_free_full(meta->formats, (GDestroyNotify)format_info_free);
 
     if (meta->thumbnail_pixbuf) {
         g_object_unref(meta->thumbnail_pixbuf);
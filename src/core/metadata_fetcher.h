@@ -2,16 +2,37 @@
 #define METADATA_FETCHER_H
 
 #include "common.h"
+#include "work_pool.h"
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <glib.h>
 #include <gtk/gtk.h>
 
 typedef void (*MetadataCallback)(VideoMetadata *metadata, gpointer user_data);
 
+// pixbuf is owned by the callback and NULL on failure
+typedef void (*ThumbnailCallback)(const char *url, GdkPixbuf *pixbuf, gpointer user_data);
+
 void metadata_fetch_thread(GTask *task, gpointer source_object,
                            gpointer task_data, GCancellable *cancellable);
 
+// Interactive lookup for the preview. The thumbnail is not loaded, fetch it
+// separately with metadata_thumbnail_async() so the text shows first.
 void metadata_fetch_async(const char *url, MetadataCallback callback, gpointer user_data);
+
+// Background lookup for a queued item on the low-priority worker lane.
+// Returns FALSE if the URL is already being prefetched.
+gboolean metadata_prefetch_async(const char *url, MetadataCallback callback, gpointer user_data);
+gboolean metadata_prefetch_pending(const char *url);
+void metadata_prefetch_cleanup(void);
+
+void metadata_thumbnail_async(const char *url, WorkLane lane,
+                              ThumbnailCallback callback, gpointer user_data);
+
+VideoMetadata* metadata_parse_json(const char *json, gssize length, GError **error);
+VideoMetadata* metadata_copy(const VideoMetadata *meta);
 void metadata_free(VideoMetadata *meta);
 
+FormatInfo* format_info_copy(const FormatInfo *format);
+void format_info_free(FormatInfo *format);
+
 #endif
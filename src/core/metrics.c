@@ -0,0 +1,399 @@
+#include "metrics.h"
+#include "storage_planner.h"
+#include <stdatomic.h>
+
+// Counters and histogram buckets are plain atomics: recording never takes
+// a lock, so the download engine, the scheduler and the metadata worker
+// threads can all instrument their hot paths.
+
+#define METRIC_MAX_BUCKETS 16
+
+typedef struct {
+    const char *name;
+    const char *help;
+    const char *label;      // Shown in the stats view
+    double scale;           // Divisor converting recorded units to exported ones
+    uint64_t bounds[METRIC_MAX_BUCKETS];
+    gsize n_bounds;
+} HistogramSpec;
+
+#define MS(x) ((uint64_t)(x) * 1000)
+#define SEC(x) ((uint64_t)(x) * G_USEC_PER_SEC)
+#define KIB(x) ((uint64_t)(x) * 1024)
+#define MIB(x) ((uint64_t)(x) * 1024 * 1024)
+
+static const struct {
+    const char *name;
+    const char *help;
+    const char *label;
+} counter_specs[METRIC_COUNTER_COUNT] = {
+    [METRIC_DOWNLOADS_STARTED] = { "datareel_downloads_started_total",
+                                   "yt-dlp download processes started", "Downloads started" },
+    [METRIC_DOWNLOADS_COMPLETED] = { "datareel_downloads_completed_total",
+                                     "Downloads finished successfully", "Completed" },
+    [METRIC_DOWNLOADS_FAILED] = { "datareel_downloads_failed_total",
+                                  "Downloads failed after all retries", "Failed" },
+    [METRIC_DOWNLOADS_CANCELLED] = { "datareel_downloads_cancelled_total",
+                                     "Downloads cancelled by the user", "Cancelled" },
+    [METRIC_RETRIES] = { "datareel_retries_total",
+                         "Failed attempts restarted by the scheduler", "Retries" },
+    [METRIC_STALLS] = { "datareel_stalls_total",
+                        "Downloads killed by the stall watchdog", "Stalls" },
+    [METRIC_BYTES_DOWNLOADED] = { "datareel_downloaded_bytes_total",
+                                  "Bytes transferred as reported by yt-dlp", "Bytes downloaded" },
+    [METRIC_METADATA_FETCHES] = { "datareel_metadata_fetches_total",
+                                  "Metadata lookups that spawned yt-dlp", "Metadata fetches" },
+    [METRIC_METADATA_CACHE_HITS] = { "datareel_metadata_cache_hits_total",
+                                     "Metadata lookups served from the cache", "Metadata cache hits" },
+    [METRIC_METADATA_PREFETCHES] = { "datareel_metadata_prefetches_total",
+                                     "Metadata lookups started ahead for queued items",
+                                     "Metadata prefetches" },
+    [METRIC_PLANS_STREAM_COPY] = { "datareel_plans_stream_copy_total",
+                                   "Downloads planned to need no re-encoding",
+                                   "Stream-copy plans" },
+    [METRIC_PLANS_TRANSCODE] = { "datareel_plans_transcode_total",
+                                 "Downloads planned with an ffmpeg re-encode",
+                                 "Transcode plans" },
+};
+
+static const HistogramSpec histogram_specs[METRIC_HISTOGRAM_COUNT] = {
+    [METRIC_THROUGHPUT] = {
+        "datareel_throughput_bytes_per_second", "Average transfer rate per download",
+        "Throughput", 1.0,
+        { KIB(64), KIB(256), MIB(1), MIB(2), MIB(4), MIB(8), MIB(16), MIB(32),
+          MIB(64), MIB(128) }, 10
+    },
+    [METRIC_TIME_TO_FIRST_BYTE] = {
+        "datareel_time_to_first_byte_seconds", "Process start to first progress report",
+        "Time to first byte", G_USEC_PER_SEC,
+        { MS(250), MS(500), SEC(1), SEC(2), SEC(3), SEC(5), SEC(10), SEC(20),
+          SEC(30), SEC(60) }, 10
+    },
+    [METRIC_METADATA_LATENCY] = {
+        "datareel_metadata_fetch_seconds", "yt-dlp metadata fetch latency",
+        "Metadata fetch", G_USEC_PER_SEC,
+        { MS(500), SEC(1), SEC(2), SEC(3), SEC(5), SEC(10), SEC(20), SEC(30),
+          SEC(60) }, 9
+    },
+    [METRIC_QUICK_PREVIEW_LATENCY] = {
+        "datareel_quick_preview_seconds", "oEmbed or page metadata preview latency",
+        "Quick preview", G_USEC_PER_SEC,
+        { MS(50), MS(100), MS(250), MS(500), SEC(1), SEC(2), SEC(5) }, 7
+    },
+    [METRIC_QUEUE_WAIT] = {
+        "datareel_queue_wait_seconds", "Time spent queued before a start",
+        "Queue wait", G_USEC_PER_SEC,
+        { MS(10), MS(100), MS(500), SEC(1), SEC(5), SEC(15), SEC(30), SEC(60),
+          SEC(300), SEC(900), SEC(3600) }, 11
+    },
+    [METRIC_SPAWN_LATENCY] = {
+        "datareel_spawn_seconds", "Process start to its first output line",
+        "Process spawn", G_USEC_PER_SEC,
+        { MS(10), MS(25), MS(50), MS(100), MS(250), MS(500), SEC(1), SEC(2),
+          SEC(5) }, 9
+    },
+    [METRIC_TIME_TO_DONE] = {
+        "datareel_time_to_done_seconds", "First queued to completed",
+        "Time to done", G_USEC_PER_SEC,
+        { SEC(10), SEC(30), SEC(60), SEC(120), SEC(300), SEC(600), SEC(1200),
+          SEC(1800), SEC(3600), SEC(7200), SEC(14400), SEC(28800) }, 12
+    },
+};
+
+static const char *queue_policy_labels[QUEUE_POLICY_COUNT] = {
+    [QUEUE_POLICY_FIFO] = "fifo",
+    [QUEUE_POLICY_SMALLEST_FIRST] = "smallest_first",
+    [QUEUE_POLICY_AGED_SJF] = "aged_sjf",
+    [QUEUE_POLICY_PRIORITY] = "priority",
+};
+
+static const char *failure_labels[FAILURE_REASON_COUNT] = {
+    [FAILURE_NETWORK] = "network",
+    [FAILURE_HTTP_403] = "http_403",
+    [FAILURE_HTTP_404] = "http_404",
+    [FAILURE_HTTP_429] = "http_429",
+    [FAILURE_UNAVAILABLE] = "unavailable",
+    [FAILURE_DISK_SPACE] = "disk_space",
+    [FAILURE_SPAWN] = "spawn",
+    [FAILURE_STALLED] = "stalled",
+    [FAILURE_OTHER] = "other",
+};
+
+// yt-dlp error substrings, checked in order
+static const struct {
+    const char *needle;
+    FailureReason reason;
+} failure_patterns[] = {
+    { "Stalled", FAILURE_STALLED },
+    { "HTTP Error 403", FAILURE_HTTP_403 },
+    { "HTTP Error 404", FAILURE_HTTP_404 },
+    { "HTTP Error 429", FAILURE_HTTP_429 },
+    { "No space left", FAILURE_DISK_SPACE },
+    { "disk space", FAILURE_DISK_SPACE },
+    { "Video unavailable", FAILURE_UNAVAILABLE },
+    { "Private video", FAILURE_UNAVAILABLE },
+    { "not available", FAILURE_UNAVAILABLE },
+    { "timed out", FAILURE_NETWORK },
+    { "Connection", FAILURE_NETWORK },
+    { "Unable to download", FAILURE_NETWORK },
+    { "name resolution", FAILURE_NETWORK },
+    { "start yt-dlp", FAILURE_SPAWN },
+};
+
+static _Atomic uint64_t counters[METRIC_COUNTER_COUNT];
+static _Atomic uint64_t failures[FAILURE_REASON_COUNT];
+static _Atomic uint64_t histogram_buckets[METRIC_HISTOGRAM_COUNT][METRIC_MAX_BUCKETS + 1];
+static _Atomic uint64_t histogram_sums[METRIC_HISTOGRAM_COUNT];
+static _Atomic uint64_t histogram_counts[METRIC_HISTOGRAM_COUNT];
+static _Atomic uint64_t policy_done_sums[QUEUE_POLICY_COUNT];
+static _Atomic uint64_t policy_done_counts[QUEUE_POLICY_COUNT];
+
+void metrics_counter_add(MetricCounter counter, uint64_t value) {
+    atomic_fetch_add_explicit(&counters[counter], value, memory_order_relaxed);
+}
+
+uint64_t metrics_counter_get(MetricCounter counter) {
+    return atomic_load_explicit(&counters[counter], memory_order_relaxed);
+}
+
+const char* metrics_counter_label(MetricCounter counter) {
+    return counter_specs[counter].label;
+}
+
+void metrics_histogram_observe(MetricHistogram histogram, uint64_t value) {
+    const HistogramSpec *spec = &histogram_specs[histogram];
+    gsize bucket = 0;
+
+    while (bucket < spec->n_bounds && value > spec->bounds[bucket]) {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&histogram_buckets[histogram][bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram_sums[histogram], value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram_counts[histogram], 1, memory_order_relaxed);
+}
+
+uint64_t metrics_histogram_count(MetricHistogram histogram) {
+    return atomic_load_explicit(&histogram_counts[histogram], memory_order_relaxed);
+}
+
+// In exported units (seconds or bytes/s)
+double metrics_histogram_mean(MetricHistogram histogram) {
+    uint64_t count = metrics_histogram_count(histogram);
+    if (count == 0) return 0.0;
+
+    uint64_t sum = atomic_load_explicit(&histogram_sums[histogram], memory_order_relaxed);
+    return (double)sum / count / histogram_specs[histogram].scale;
+}
+
+// Estimated by linear interpolation inside the bucket holding the rank.
+// Values past the last bound are reported as that bound.
+double metrics_histogram_quantile(MetricHistogram histogram, double q) {
+    const HistogramSpec *spec = &histogram_specs[histogram];
+    uint64_t buckets[METRIC_MAX_BUCKETS + 1];
+    uint64_t total = 0;
+
+    for (gsize i = 0; i <= spec->n_bounds; i++) {
+        buckets[i] = atomic_load_explicit(&histogram_buckets[histogram][i], memory_order_relaxed);
+        total += buckets[i];
+    }
+    if (total == 0) return 0.0;
+
+    double rank = CLAMP(q, 0.0, 1.0) * total;
+    uint64_t cumulative = 0;
+
+    for (gsize i = 0; i < spec->n_bounds; i++) {
+        if (buckets[i] > 0 && cumulative + buckets[i] >= rank) {
+            double lower = i > 0 ? (double)spec->bounds[i - 1] : 0.0;
+            double upper = (double)spec->bounds[i];
+            double fraction = (rank - cumulative) / buckets[i];
+            return (lower + (upper - lower) * fraction) / spec->scale;
+        }
+        cumulative += buckets[i];
+    }
+
+    return spec->bounds[spec->n_bounds - 1] / spec->scale;
+}
+
+const char* metrics_histogram_label(MetricHistogram histogram) {
+    return histogram_specs[histogram].label;
+}
+
+gboolean metrics_histogram_is_latency(MetricHistogram histogram) {
+    return histogram != METRIC_THROUGHPUT;
+}
+
+FailureReason metrics_classify_failure(const char *error_message) {
+    if (!error_message) return FAILURE_OTHER;
+
+    for (gsize i = 0; i < G_N_ELEMENTS(failure_patterns); i++) {
+        if (strstr(error_message, failure_patterns[i].needle)) {
+            return failure_patterns[i].reason;
+        }
+    }
+    return FAILURE_OTHER;
+}
+
+void metrics_record_failure(FailureReason reason) {
+    atomic_fetch_add_explicit(&failures[reason], 1, memory_order_relaxed);
+}
+
+uint64_t metrics_failure_count(FailureReason reason) {
+    return atomic_load_explicit(&failures[reason], memory_order_relaxed);
+}
+
+const char* metrics_failure_label(FailureReason reason) {
+    return failure_labels[reason];
+}
+
+void metrics_record_time_to_done(QueuePolicy policy, uint64_t usec) {
+    metrics_histogram_observe(METRIC_TIME_TO_DONE, usec);
+    atomic_fetch_add_explicit(&policy_done_sums[policy], usec, memory_order_relaxed);
+    atomic_fetch_add_explicit(&policy_done_counts[policy], 1, memory_order_relaxed);
+}
+
+uint64_t metrics_time_to_done_count(QueuePolicy policy) {
+    return atomic_load_explicit(&policy_done_counts[policy], memory_order_relaxed);
+}
+
+double metrics_time_to_done_mean(QueuePolicy policy) {
+    uint64_t count = metrics_time_to_done_count(policy);
+    if (count == 0) return 0.0;
+
+    uint64_t sum = atomic_load_explicit(&policy_done_sums[policy], memory_order_relaxed);
+    return (double)sum / count / G_USEC_PER_SEC;
+}
+
+const char* metrics_queue_policy_label(QueuePolicy policy) {
+    return queue_policy_labels[policy];
+}
+
+static void append_label_value(GString *out, const char *value) {
+    for (const char *p = value ? value : ""; *p; p++) {
+        switch (*p) {
+        case '\\': g_string_append(out, "\\\\"); break;
+        case '"':  g_string_append(out, "\\\""); break;
+        case '\n': g_string_append(out, "\\n"); break;
+        default:   g_string_append_c(out, *p); break;
+        }
+    }
+}
+
+static void append_header(GString *out, const char *name, const char *help,
+                          const char *type) {
+    g_string_append_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void render_histogram(GString *out, MetricHistogram histogram) {
+    const HistogramSpec *spec = &histogram_specs[histogram];
+    uint64_t cumulative = 0;
+
+    append_header(out, spec->name, spec->help, "histogram");
+    for (gsize i = 0; i <= spec->n_bounds; i++) {
+        cumulative += atomic_load_explicit(&histogram_buckets[histogram][i], memory_order_relaxed);
+        if (i < spec->n_bounds) {
+            g_string_append_printf(out, "%s_bucket{le=\"%g\"} %" G_GUINT64_FORMAT "\n",
+                                   spec->name, spec->bounds[i] / spec->scale, cumulative);
+        } else {
+            g_string_append_printf(out, "%s_bucket{le=\"+Inf\"} %" G_GUINT64_FORMAT "\n",
+                                   spec->name, cumulative);
+        }
+    }
+
+    uint64_t sum = atomic_load_explicit(&histogram_sums[histogram], memory_order_relaxed);
+    g_string_append_printf(out, "%s_sum %g\n", spec->name, sum / spec->scale);
+    g_string_append_printf(out, "%s_count %" G_GUINT64_FORMAT "\n", spec->name,
+                           metrics_histogram_count(histogram));
+}
+
+static const char *status_labels[] = {
+    [DOWNLOAD_STATUS_IDLE] = "idle",
+    [DOWNLOAD_STATUS_FETCHING_INFO] = "fetching_info",
+    [DOWNLOAD_STATUS_QUEUED] = "queued",
+    [DOWNLOAD_STATUS_DOWNLOADING] = "downloading",
+    [DOWNLOAD_STATUS_PROCESSING] = "processing",
+    [DOWNLOAD_STATUS_PAUSED] = "paused",
+    [DOWNLOAD_STATUS_COMPLETED] = "completed",
+    [DOWNLOAD_STATUS_FAILED] = "failed",
+    [DOWNLOAD_STATUS_CANCELLED] = "cancelled",
+};
+
+static void render_items(GString *out, GList *items) {
+    int per_status[G_N_ELEMENTS(status_labels)] = { 0 };
+
+    for (GList *l = items; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        per_status[item->status]++;
+    }
+
+    append_header(out, "datareel_items", "Tracked download items by status", "gauge");
+    for (gsize i = 0; i < G_N_ELEMENTS(status_labels); i++) {
+        g_string_append_printf(out, "datareel_items{status=\"%s\"} %d\n",
+                               status_labels[i], per_status[i]);
+    }
+
+    append_header(out, "datareel_storage_reserved_bytes",
+                  "Disk space reserved for running downloads", "gauge");
+    g_string_append_printf(out, "datareel_storage_reserved_bytes %" G_GINT64_FORMAT "\n",
+                           storage_planner_reserved_bytes());
+
+    static const struct {
+        const char *name;
+        const char *help;
+    } item_gauges[] = {
+        { "datareel_item_downloaded_bytes", "Bytes transferred by the current attempt" },
+        { "datareel_item_speed_bytes_per_second", "Current transfer rate" },
+        { "datareel_item_attempts", "Times the process was started" },
+    };
+
+    for (gsize g = 0; g < G_N_ELEMENTS(item_gauges); g++) {
+        append_header(out, item_gauges[g].name, item_gauges[g].help, "gauge");
+
+        for (GList *l = items; l != NULL; l = l->next) {
+            DownloadItem *item = l->data;
+            double value = g == 0 ? (double)item->bytes_downloaded
+                         : g == 1 ? item->speed
+                         : item->attempts;
+
+            g_string_append_printf(out, "%s{url=\"", item_gauges[g].name);
+            append_label_value(out, item->url);
+            g_string_append_printf(out, "\",status=\"%s\"} %.0f\n",
+                                   status_labels[item->status], value);
+        }
+    }
+}
+
+char* metrics_render_prometheus(GList *items) {
+    GString *out = g_string_new(NULL);
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        append_header(out, counter_specs[i].name, counter_specs[i].help, "counter");
+        g_string_append_printf(out, "%s %" G_GUINT64_FORMAT "\n", counter_specs[i].name,
+                               metrics_counter_get(i));
+    }
+
+    append_header(out, "datareel_failures_total", "Failed attempts by reason", "counter");
+    for (int i = 0; i < FAILURE_REASON_COUNT; i++) {
+        g_string_append_printf(out, "datareel_failures_total{reason=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                               failure_labels[i], metrics_failure_count(i));
+    }
+
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        render_histogram(out, i);
+    }
+
+    append_header(out, "datareel_policy_time_to_done_seconds",
+                  "First queued to completed by queue policy", "summary");
+    for (int i = 0; i < QUEUE_POLICY_COUNT; i++) {
+        uint64_t sum = atomic_load_explicit(&policy_done_sums[i], memory_order_relaxed);
+        g_string_append_printf(out, "datareel_policy_time_to_done_seconds_sum{policy=\"%s\"} %g\n",
+                               queue_policy_labels[i], (double)sum / G_USEC_PER_SEC);
+        g_string_append_printf(out, "datareel_policy_time_to_done_seconds_count{policy=\"%s\"} %"
+                               G_GUINT64_FORMAT "\n", queue_policy_labels[i],
+                               metrics_time_to_done_count(i));
+    }
+
+    render_items(out, items);
+
+    return g_string_free(out, FALSE);
+}
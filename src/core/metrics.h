@@ -0,0 +1,78 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "common.h"
+#include "../utils/config.h"
+
+// Process-wide instrumentation. Recording is lock-free and safe from any
+// thread; rendering reads a slightly racy but consistent-enough snapshot.
+
+typedef enum {
+    METRIC_DOWNLOADS_STARTED,
+    METRIC_DOWNLOADS_COMPLETED,
+    METRIC_DOWNLOADS_FAILED,
+    METRIC_DOWNLOADS_CANCELLED,
+    METRIC_RETRIES,
+    METRIC_STALLS,
+    METRIC_BYTES_DOWNLOADED,
+    METRIC_METADATA_FETCHES,
+    METRIC_METADATA_CACHE_HITS,
+    METRIC_METADATA_PREFETCHES,
+    METRIC_PLANS_STREAM_COPY,
+    METRIC_PLANS_TRANSCODE,
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+typedef enum {
+    METRIC_THROUGHPUT,          // Average bytes/s of a finished transfer
+    METRIC_TIME_TO_FIRST_BYTE,  // Process start to first progress report
+    METRIC_METADATA_LATENCY,    // yt-dlp --dump-json round trip
+    METRIC_QUICK_PREVIEW_LATENCY, // oEmbed or page metadata round trip
+    METRIC_QUEUE_WAIT,          // Time spent queued before a start
+    METRIC_SPAWN_LATENCY,       // Process start to its first output line
+    METRIC_TIME_TO_DONE,        // First queued to completed
+    METRIC_HISTOGRAM_COUNT
+} MetricHistogram;
+
+typedef enum {
+    FAILURE_NETWORK,
+    FAILURE_HTTP_403,
+    FAILURE_HTTP_404,
+    FAILURE_HTTP_429,
+    FAILURE_UNAVAILABLE,
+    FAILURE_DISK_SPACE,
+    FAILURE_SPAWN,
+    FAILURE_STALLED,
+    FAILURE_OTHER,
+    FAILURE_REASON_COUNT
+} FailureReason;
+
+void metrics_counter_add(MetricCounter counter, uint64_t value);
+uint64_t metrics_counter_get(MetricCounter counter);
+const char* metrics_counter_label(MetricCounter counter);
+
+// Latencies are observed in microseconds, throughput in bytes per second
+void metrics_histogram_observe(MetricHistogram histogram, uint64_t value);
+uint64_t metrics_histogram_count(MetricHistogram histogram);
+double metrics_histogram_mean(MetricHistogram histogram);
+double metrics_histogram_quantile(MetricHistogram histogram, double q);
+const char* metrics_histogram_label(MetricHistogram histogram);
+gboolean metrics_histogram_is_latency(MetricHistogram histogram);
+
+FailureReason metrics_classify_failure(const char *error_message);
+void metrics_record_failure(FailureReason reason);
+uint64_t metrics_failure_count(FailureReason reason);
+const char* metrics_failure_label(FailureReason reason);
+
+// Time from first queued to completed, attributed to the queue policy
+// that started the item, so policies can be compared on the same workload
+void metrics_record_time_to_done(QueuePolicy policy, uint64_t usec);
+uint64_t metrics_time_to_done_count(QueuePolicy policy);
+double metrics_time_to_done_mean(QueuePolicy policy);  // Seconds
+const char* metrics_queue_policy_label(QueuePolicy policy);
+
+// Prometheus text exposition format, including per-item gauges for the
+// given DownloadItem list
+char* metrics_render_prometheus(GList *items);
+
+#endif
@@ -1,27 +1,562 @@
 #include "process_manager.h"
+#include "download_engine.h"
+#include "storage_planner.h"
+#include "download_schedule.h"
+#include "concurrency_controller.h"
+#include "metadata_fetcher.h"
+#include "metrics.h"
+#include "../utils/config.h"
 
-// Placeholder for managing multiple download processes
-// Future: queue management, concurrent downloads, process monitoring
+// Download scheduler: queued items are started as slots free up, failed
+// items are retried with exponential backoff. Limits are taken from the
+// live configuration, so changing the config file retunes a running
+// instance without a restart.
+//
+// Running items are accounted in two stages with separate pools: the
+// network stage (DOWNLOADING) and the post-processing stage (PROCESSING,
+// ffmpeg merges and embedding). An item entering a stage whose pool is
+// full is stopped until a slot frees up, so a CPU-heavy merge never holds
+// a network slot.
+//
+// Queued items are started in the order of the configured queue policy.
+// Sizes come from the metadata (or the storage planner's estimate), so a
+// huge item at the head no longer holds back a batch of short clips; with
+// aging, waiting time is credited against size so it still gets its turn.
+//
+// Download windows ([schedule:NAME] in the config) add per-window limits on
+// top. When a window opens or closes, running downloads that now exceed its
+// concurrency or run at the wrong rate are terminated and queued again;
+// --continue picks up their partial files once the window lets them start.
+
+#define SCHEDULER_TICK_MS 500
+#define RETRY_BACKOFF_MAX_SHIFT 6
 
 static GList *active_downloads = NULL;
+static guint scheduler_tick_id = 0;
+static guint config_watch_id = 0;
+
+static void process_manager_schedule(void);
+
+static int max_processing_slots(AppConfig *config) {
+    if (config->max_concurrent_processing > 0) {
+        return config->max_concurrent_processing;
+    }
+    return (int)g_get_num_processors();
+}
+
+static int stage_limit(AppConfig *config, DownloadStatus stage) {
+    return stage == DOWNLOAD_STATUS_PROCESSING ? max_processing_slots(config)
+                                               : concurrency_controller_global_limit(config);
+}
+
+// Items actively running (not suspended) in a stage, excluding one item.
+// An item being cancelled gives up its slot as soon as it is signalled.
+static int stage_running(DownloadStatus stage, DownloadItem *exclude) {
+    int running = 0;
+    for (GList *l = active_downloads; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        if (item != exclude && item->status == stage && !item->stage_suspended &&
+            !item->cancel_requested) {
+            running++;
+        }
+    }
+    return running;
+}
+
+static int domain_running(const char *domain) {
+    int running = 0;
+    for (GList *l = active_downloads; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        if (item->status == DOWNLOAD_STATUS_DOWNLOADING && !item->stage_suspended &&
+            !item->cancel_requested && g_strcmp0(item->domain, domain) == 0) {
+            running++;
+        }
+    }
+    return running;
+}
+
+// Split the fragment budget over the downloads expected to run alongside
+// this one: a short queue lets a few large files use many connections,
+// a long queue backs off to one or two fragments per item.
+static int fragment_share(AppConfig *config, int network_running) {
+    int queued = 0;
+    for (GList *l = active_downloads; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        if (item->status == DOWNLOAD_STATUS_QUEUED) queued++;
+    }
+
+    int expected = MIN(network_running + MAX(queued, 1), stage_limit(config, DOWNLOAD_STATUS_DOWNLOADING));
+    int share = config->fragment_budget / MAX(expected, 1);
+    return CLAMP(share, 1, config->max_fragments_per_item);
+}
+
+static void on_stage_changed(DownloadItem *item, gpointer user_data) {
+    (void)user_data;
+    AppConfig *config = config_get();
+
+    if (stage_running(item->status, item) >= stage_limit(config, item->status)) {
+        if (download_item_suspend(item)) {
+            item->wait_reason = item->status == DOWNLOAD_STATUS_PROCESSING
+                                ? "waiting for post-processing slot"
+                                : "waiting for network slot";
+        }
+    }
+
+    // The stage it left has a free slot now
+    process_manager_schedule();
+}
+
+// Kill transfers that stopped making progress so they don't hold a slot
+// forever; the retry policy then restarts them. Only the network stage is
+// watched: ffmpeg is quiet for long stretches while it works.
+static void check_stalls(AppConfig *config, gint64 now) {
+    gint64 window = (gint64)config->stall_seconds * G_USEC_PER_SEC;
+    gint64 extract_window = (gint64)config->extract_seconds * G_USEC_PER_SEC;
+    if (window <= 0 && extract_window <= 0) return;
+
+    for (GList *l = active_downloads; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        if (item->status != DOWNLOAD_STATUS_DOWNLOADING || item->stage_suspended ||
+            item->cancel_requested || !item->backend) {
+            continue;
+        }
+
+        char *reason = NULL;
+        if (item->first_progress_time == 0) {
+            // Still extracting: no bytes are expected yet, only output
+            if (extract_window > 0 && now - item->last_activity_time > extract_window) {
+                reason = g_strdup_printf("Stalled: no output for %d s while extracting",
+                                         config->extract_seconds);
+            }
+        } else if (window <= 0) {
+            // Transfer watchdog off
+        } else if (now - item->last_activity_time > window) {
+            reason = g_strdup_printf("Stalled: no data for %d s", config->stall_seconds);
+        } else if (now - item->window_start_time > window) {
+            // Rolling throughput floor, checked once per window
+            int64_t bytes = item->bytes_downloaded - item->window_start_bytes;
+            int64_t rate = bytes * G_USEC_PER_SEC / (now - item->window_start_time);
+
+            if (config->min_speed_kib > 0 && item->first_progress_time > 0 &&
+                rate < (int64_t)config->min_speed_kib * 1024) {
+                reason = g_strdup_printf("Stalled: %" G_GINT64_FORMAT " KiB/s over %d s",
+                                         rate / 1024, config->stall_seconds);
+            }
+            item->window_start_time = now;
+            item->window_start_bytes = item->bytes_downloaded;
+        }
+
+        if (reason && download_item_abort(item, reason)) {
+            g_print("Watchdog: %s (%s)\n", reason, item->url);
+            metrics_counter_add(METRIC_STALLS, 1);
+            concurrency_controller_report(config, item->domain, "stall");
+        }
+        g_free(reason);
+    }
+}
+
+// Running downloads a window allows, -1 for no limit
+static int window_limit(AppConfig *config, int window) {
+    return window >= 0 ? config->schedule_windows[window].max_downloads : -1;
+}
+
+static gboolean window_has_room(AppConfig *config, int window, const int *window_running) {
+    int limit = window_limit(config, window);
+    return limit < 0 || window_running[window] < limit;
+}
+
+// Bring running downloads in line with the windows open right now, counting
+// the ones kept per window. Items paused for a window are queued again so
+// the start loop decides when they may continue.
+static void apply_download_windows(AppConfig *config, GDateTime *local, int *window_running) {
+    for (GList *l = active_downloads; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+
+        if (item->status == DOWNLOAD_STATUS_PAUSED && item->schedule_paused &&
+            !item->pause_requested) {
+            download_item_unpause(item);
+            item->schedule_paused = FALSE;
+            continue;
+        }
+
+        if (item->status != DOWNLOAD_STATUS_DOWNLOADING || !item->backend ||
+            item->cancel_requested || item->pause_requested) {
+            continue;
+        }
+
+        int window = download_schedule_lookup(config, item, local);
+        const ScheduleWindow *spec = window >= 0 ? &config->schedule_windows[window] : NULL;
+        gboolean over_limit = !window_has_room(config, window, window_running);
+        gboolean rethrottle = download_schedule_rate_limit(spec) != item->scheduled_rate_limit;
+
+        if (!over_limit && !rethrottle) {
+            if (window >= 0) window_running[window]++;
+            continue;
+        }
+
+        // yt-dlp can't change its rate limit while running, so both cases
+        // restart the transfer from its partial files
+        if (download_item_pause(item, PAUSE_MODE_TERMINATE)) {
+            item->schedule_paused = TRUE;
+            g_print("Schedule: %s %s (%s)\n", over_limit ? "pausing" : "re-throttling",
+                    item->url, spec ? spec->name : "no window");
+        }
+    }
+}
+
+typedef struct {
+    DownloadItem *item;
+    int rank;               // Priority class, lower starts first
+    double key;             // Policy order within a class, lower starts first
+} QueueCandidate;
+
+static const int priority_rank[] = {
+    [DOWNLOAD_PRIORITY_HIGH] = 0,
+    [DOWNLOAD_PRIORITY_NORMAL] = 1,
+    [DOWNLOAD_PRIORITY_LOW] = 2,
+};
+
+// Bytes still to transfer; a resumed item only has its remainder left
+static double remaining_bytes(DownloadItem *item) {
+    double size = (double)storage_planner_estimate_size(item);
+    return size * (100.0 - CLAMP(item->progress, 0.0, 100.0)) / 100.0;
+}
+
+static void queue_candidate_rank(AppConfig *config, QueueCandidate *candidate, gint64 now) {
+    DownloadItem *item = candidate->item;
+    double aging = (double)config->aging_mib_per_minute * 1024 * 1024 / 60;
+    double waited = (double)(now - item->queued_time) / G_USEC_PER_SEC;
+
+    candidate->rank = 0;
+    candidate->key = 0.0;
+
+    switch (config->queue_policy) {
+        case QUEUE_POLICY_FIFO:
+            // The stable sort keeps list order
+            break;
+        case QUEUE_POLICY_SMALLEST_FIRST:
+            candidate->key = remaining_bytes(item);
+            break;
+        case QUEUE_POLICY_PRIORITY:
+            candidate->rank = priority_rank[item->options->priority];
+            candidate->key = remaining_bytes(item) - waited * aging;
+            break;
+        case QUEUE_POLICY_AGED_SJF:
+        default:
+            candidate->key = remaining_bytes(item) - waited * aging;
+            break;
+    }
+}
+
+static gint compare_queue_candidates(gconstpointer a, gconstpointer b) {
+    const QueueCandidate *x = a;
+    const QueueCandidate *y = b;
+
+    if (x->rank != y->rank) return x->rank - y->rank;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+// Queued items ready to start, in policy order
+static GArray *queue_candidates(AppConfig *config, gint64 now) {
+    GArray *candidates = g_array_new(FALSE, FALSE, sizeof(QueueCandidate));
+
+    for (GList *l = active_downloads; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        if (item->status != DOWNLOAD_STATUS_QUEUED || item->next_attempt_time > now) {
+            continue;
+        }
+
+        QueueCandidate candidate = { .item = item };
+        queue_candidate_rank(config, &candidate, now);
+        g_array_append_val(candidates, candidate);
+    }
+
+    g_array_sort(candidates, compare_queue_candidates);
+    return candidates;
+}
+
+static void on_thumbnail_prefetched(const char *url, GdkPixbuf *pixbuf, gpointer user_data) {
+    DownloadItem *item = user_data;
+
+    if (pixbuf && g_list_find(active_downloads, item) && item->metadata &&
+        !item->metadata->thumbnail_pixbuf &&
+        g_strcmp0(item->metadata->thumbnail_url, url) == 0) {
+        item->metadata->thumbnail_pixbuf = pixbuf;
+        return;
+    }
+    if (pixbuf) {
+        g_object_unref(pixbuf);
+    }
+}
+
+static void on_metadata_prefetched(VideoMetadata *meta, gpointer user_data) {
+    DownloadItem *item = user_data;
+
+    // The item may have been removed while the lookup ran
+    if (meta && g_list_find(active_downloads, item) && !item->metadata) {
+        item->metadata = meta;
+        if (meta->thumbnail_url) {
+            metadata_thumbnail_async(meta->thumbnail_url, WORK_LANE_BACKGROUND,
+                                     on_thumbnail_prefetched, item);
+        }
+        return;
+    }
+    metadata_free(meta);
+}
+
+// Resolve metadata for the next items in line while they wait, so sizes for
+// ordering and disk planning are known and the download itself can skip
+// extraction. Candidates are in start order; the ones still queued follow.
+static void prefetch_metadata(AppConfig *config, GArray *candidates) {
+    int budget = config->prefetch_depth;
+
+    for (guint i = 0; i < candidates->len && budget > 0; i++) {
+        DownloadItem *item = g_array_index(candidates, QueueCandidate, i).item;
+        if (item->status != DOWNLOAD_STATUS_QUEUED || item->options->playlist) {
+            continue;
+        }
+        budget--;
+
+        if (!item->metadata && !metadata_prefetch_pending(item->url)) {
+            metadata_prefetch_async(item->url, on_metadata_prefetched, item);
+        }
+    }
+}
+
+static gboolean is_finished(DownloadItem *item) {
+    return item->status == DOWNLOAD_STATUS_COMPLETED ||
+           item->status == DOWNLOAD_STATUS_FAILED ||
+           item->status == DOWNLOAD_STATUS_CANCELLED;
+}
+
+static void on_download_finished(DownloadItem *item, gpointer user_data) {
+    (void)user_data;
+    AppConfig *config = config_get();
+
+    storage_planner_release(item);
+
+    if (item->status == DOWNLOAD_STATUS_FAILED) {
+        FailureReason reason = metrics_classify_failure(item->error_message);
+        metrics_record_failure(reason);
+
+        // The site is throttling us: fewer parallel requests to it
+        if (reason == FAILURE_HTTP_429 || reason == FAILURE_HTTP_403) {
+            concurrency_controller_report(config, item->domain, metrics_failure_label(reason));
+        }
+    }
+
+    if (item->status == DOWNLOAD_STATUS_FAILED &&
+        item->attempts <= config->max_retries) {
+        int shift = MIN(item->attempts - 1, RETRY_BACKOFF_MAX_SHIFT);
+        gint64 delay = (gint64)config->retry_backoff_seconds * G_USEC_PER_SEC << shift;
+
+        g_print("Download failed (%s), retry %d/%d in %" G_GINT64_FORMAT "s\n",
+                item->error_message ? item->error_message : "unknown error",
+                item->attempts, config->max_retries, delay / G_USEC_PER_SEC);
+
+        item->next_attempt_time = g_get_monotonic_time() + delay;
+        item->queued_time = g_get_monotonic_time();
+        item->status = DOWNLOAD_STATUS_QUEUED;
+        metrics_counter_add(METRIC_RETRIES, 1);
+    } else if (item->status == DOWNLOAD_STATUS_FAILED) {
+        metrics_counter_add(METRIC_DOWNLOADS_FAILED, 1);
+    } else if (item->status == DOWNLOAD_STATUS_COMPLETED) {
+        metrics_counter_add(METRIC_DOWNLOADS_COMPLETED, 1);
+        metrics_record_time_to_done(item->queue_policy, g_get_monotonic_time() - item->added_time);
+    } else if (item->status == DOWNLOAD_STATUS_CANCELLED) {
+        metrics_counter_add(METRIC_DOWNLOADS_CANCELLED, 1);
+    }
+
+    // Refill the freed slot right away instead of waiting for the next tick
+    process_manager_schedule();
+}
+
+static void process_manager_schedule(void) {
+    AppConfig *config = config_get();
+    gint64 now = g_get_monotonic_time();
+
+    GList *l = active_downloads;
+    while (l != NULL) {
+        GList *next = l->next;
+        DownloadItem *item = l->data;
+
+        if (is_finished(item)) {
+            active_downloads = g_list_delete_link(active_downloads, l);
+        }
+        l = next;
+    }
+
+    check_stalls(config, now);
+
+    GDateTime *local = g_date_time_new_now_local();
+    int *window_running = g_new0(int, MAX(config->schedule_window_count, 1));
+    apply_download_windows(config, local, window_running);
+
+    int network_running = stage_running(DOWNLOAD_STATUS_DOWNLOADING, NULL);
+    int processing_running = stage_running(DOWNLOAD_STATUS_PROCESSING, NULL);
+
+    // Continue suspended items first: they already hold partial work
+    for (l = active_downloads; l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        if (!item->stage_suspended) continue;
+
+        int *running = item->status == DOWNLOAD_STATUS_PROCESSING ? &processing_running
+                                                                  : &network_running;
+        if (*running < stage_limit(config, item->status) && download_item_resume(item)) {
+            item->wait_reason = NULL;
+            (*running)++;
+        }
+    }
+
+    int network_limit = stage_limit(config, DOWNLOAD_STATUS_DOWNLOADING);
+    GArray *candidates = queue_candidates(config, now);
+    for (guint i = 0; i < candidates->len && network_running < network_limit; i++) {
+        DownloadItem *item = g_array_index(candidates, QueueCandidate, i).item;
+
+        int domain_limit = concurrency_controller_domain_limit(config, item->domain);
+        if (domain_limit >= 0 && domain_running(item->domain) >= domain_limit) {
+            item->wait_reason = "adaptive limit for this site";
+            continue;
+        }
+
+        int window = download_schedule_lookup(config, item, local);
+        if (!window_has_room(config, window, window_running)) {
+            item->wait_reason = window_limit(config, window) == 0
+                                ? "outside download window"
+                                : "download window is full";
+            continue;
+        }
+
+        // Hold back items that would fill the disk; smaller ones may still fit
+        StoragePlanResult plan = storage_planner_reserve(item);
+        if (plan == STORAGE_PLAN_WAIT) {
+            item->wait_reason = "waiting for disk space";
+            continue;
+        } else if (plan == STORAGE_PLAN_NO_SPACE) {
+            item->status = DOWNLOAD_STATUS_FAILED;
+            g_free(item->error_message);
+            item->error_message = g_strdup("Not enough disk space");
+            metrics_record_failure(FAILURE_DISK_SPACE);
+            metrics_counter_add(METRIC_DOWNLOADS_FAILED, 1);
+            continue;
+        }
+        item->wait_reason = NULL;
+        item->fragment_concurrency = fragment_share(config, network_running);
+        item->scheduled_rate_limit =
+            download_schedule_rate_limit(window >= 0 ? &config->schedule_windows[window] : NULL);
+        item->queue_policy = config->queue_policy;
+
+        if (download_item_start(item)) {
+            metrics_histogram_observe(METRIC_QUEUE_WAIT, now - item->queued_time);
+            network_running++;
+            if (window >= 0) window_running[window]++;
+        } else {
+            storage_planner_release(item);
+            item->status = DOWNLOAD_STATUS_FAILED;
+            if (!item->error_message) {
+                item->error_message = g_strdup("Failed to start yt-dlp");
+            }
+            metrics_record_failure(FAILURE_SPAWN);
+            metrics_counter_add(METRIC_DOWNLOADS_FAILED, 1);
+        }
+    }
+
+    prefetch_metadata(config, candidates);
+
+    g_array_free(candidates, TRUE);
+    g_free(window_running);
+    g_date_time_unref(local);
+}
+
+static gboolean scheduler_tick(gpointer user_data) {
+    (void)user_data;
+    concurrency_controller_sample(config_get(), active_downloads, g_get_monotonic_time());
+    process_manager_schedule();
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_config_changed(AppConfig *config, gpointer user_data) {
+    (void)user_data;
+    if (!config->adaptive_concurrency) {
+        concurrency_controller_reset();
+    }
+    g_print("Scheduler: %d network slots%s, %d post-processing slots\n",
+            stage_limit(config, DOWNLOAD_STATUS_DOWNLOADING),
+            config->adaptive_concurrency ? " (adaptive)" : "", max_processing_slots(config));
+    process_manager_schedule();
+}
+
+void process_manager_init(void) {
+    if (scheduler_tick_id > 0) return;
+
+    download_engine_set_finished_func(on_download_finished, NULL);
+    download_engine_set_stage_func(on_stage_changed, NULL);
+    config_watch_id = config_add_watch(on_config_changed, NULL);
+    scheduler_tick_id = g_timeout_add(SCHEDULER_TICK_MS, scheduler_tick, NULL);
+}
 
 void process_manager_add(DownloadItem *item) {
     if (item) {
+        item->status = DOWNLOAD_STATUS_QUEUED;
+        item->next_attempt_time = 0;
+        item->queued_time = g_get_monotonic_time();
+        item->added_time = item->queued_time;
         active_downloads = g_list_append(active_downloads, item);
+        process_manager_schedule();
     }
 }
 
 void process_manager_remove(DownloadItem *item) {
     if (item) {
+        storage_planner_release(item);
         active_downloads = g_list_remove(active_downloads, item);
     }
 }
 
+gboolean process_manager_pause(DownloadItem *item) {
+    // Keep an item the schedule paused paused for good
+    if (item->status == DOWNLOAD_STATUS_PAUSED && item->schedule_paused) {
+        item->schedule_paused = FALSE;
+        return TRUE;
+    }
+    if (!download_item_pause(item, config_get()->pause_mode)) {
+        return FALSE;
+    }
+    process_manager_schedule();
+    return TRUE;
+}
+
+gboolean process_manager_resume(DownloadItem *item) {
+    if (!download_item_unpause(item)) {
+        return FALSE;
+    }
+    item->schedule_paused = FALSE;
+    if (item->stage_suspended) {
+        item->wait_reason = item->status == DOWNLOAD_STATUS_PROCESSING
+                            ? "waiting for post-processing slot"
+                            : "waiting for network slot";
+    }
+    process_manager_schedule();
+    return TRUE;
+}
+
 GList *process_manager_get_all(void) {
     return active_downloads;
 }
 
 void process_manager_cleanup(void) {
+    if (scheduler_tick_id > 0) {
+        g_source_remove(scheduler_tick_id);
+        scheduler_tick_id = 0;
+    }
+    if (config_watch_id > 0) {
+        config_remove_watch(config_watch_id);
+        config_watch_id = 0;
+    }
+    download_engine_set_finished_func(NULL, NULL);
+    download_engine_set_stage_func(NULL, NULL);
+
     g_list_free(active_downloads);
     active_downloads = NULL;
+    concurrency_controller_reset();
 }
@@ -3,8 +3,14 @@
 
 #include "common.h"
 
+void process_manager_init(void);
 void process_manager_add(DownloadItem *item);
 void process_manager_remove(DownloadItem *item);
+
+// Pause or resume an item and reschedule, so the slot it frees (or needs)
+// is accounted right away
+gboolean process_manager_pause(DownloadItem *item);
+gboolean process_manager_resume(DownloadItem *item);
 GList *process_manager_get_all(void);
 void process_manager_cleanup(void);
 
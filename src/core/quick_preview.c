@@ -0,0 +1,409 @@
+#include "quick_preview.h"
+#include "metrics.h"
+#include "../utils/config.h"
+#include "../utils/string_utils.h"
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+// Only the head of a page is needed for its meta tags
+#define PAGE_READ_LIMIT (512 * 1024)
+#define READ_CHUNK_SIZE (16 * 1024)
+
+// Sites with a public oEmbed endpoint, matched on the host and its subdomains
+static const struct {
+    const char *domain;
+    const char *endpoint;
+} oembed_providers[] = {
+    { "youtube.com", "https://www.youtube.com/oembed" },
+    { "youtu.be", "https://www.youtube.com/oembed" },
+    { "vimeo.com", "https://vimeo.com/api/oembed.json" },
+    { "dailymotion.com", "https://www.dailymotion.com/services/oembed" },
+    { "soundcloud.com", "https://soundcloud.com/oembed" },
+};
+
+typedef struct {
+    char *url;
+    QuickPreviewCallback callback;
+    gpointer user_data;
+    gboolean oembed;            // Current request is the oEmbed one
+    GCancellable *cancellable;
+    guint timeout_id;
+    GInputStream *stream;
+    GByteArray *body;
+    gint64 start_time;
+} QuickPreviewRequest;
+
+static SoupSession *preview_session = NULL;
+
+static void quick_preview_send(QuickPreviewRequest *request, const char *request_url);
+
+static void quick_preview_request_free(QuickPreviewRequest *request) {
+    if (request->timeout_id > 0) {
+        g_source_remove(request->timeout_id);
+    }
+    g_clear_object(&request->stream);
+    g_clear_object(&request->cancellable);
+    if (request->body) {
+        g_byte_array_unref(request->body);
+    }
+    g_free(request->url);
+    g_free(request);
+}
+
+static void quick_preview_finish(QuickPreviewRequest *request, VideoMetadata *meta) {
+    if (meta) {
+        metrics_histogram_observe(METRIC_QUICK_PREVIEW_LATENCY,
+                                  g_get_monotonic_time() - request->start_time);
+    }
+    request->callback(request->url, meta, request->user_data);
+    quick_preview_request_free(request);
+}
+
+static gboolean on_quick_preview_timeout(gpointer user_data) {
+    QuickPreviewRequest *request = user_data;
+    request->timeout_id = 0;
+    g_cancellable_cancel(request->cancellable);
+    return G_SOURCE_REMOVE;
+}
+
+static const char *oembed_endpoint_for(const char *url) {
+    const char *override = config_get()->oembed_endpoint;
+    if (override) return override;
+
+    char *domain = string_extract_domain(url);
+    if (!domain) return NULL;
+
+    const char *endpoint = NULL;
+    gsize domain_len = strlen(domain);
+    for (gsize i = 0; i < G_N_ELEMENTS(oembed_providers) && !endpoint; i++) {
+        const char *suffix = oembed_providers[i].domain;
+        gsize suffix_len = strlen(suffix);
+
+        if (g_ascii_strcasecmp(domain, suffix) == 0 ||
+            (domain_len > suffix_len && domain[domain_len - suffix_len - 1] == '.' &&
+             g_ascii_strcasecmp(domain + domain_len - suffix_len, suffix) == 0)) {
+            endpoint = oembed_providers[i].endpoint;
+        }
+    }
+
+    g_free(domain);
+    return endpoint;
+}
+
+// The oEmbed answer failed or was empty, try the page itself
+static void quick_preview_fall_back(QuickPreviewRequest *request) {
+    if (!request->oembed || g_cancellable_is_cancelled(request->cancellable)) {
+        quick_preview_finish(request, NULL);
+        return;
+    }
+    request->oembed = FALSE;
+    quick_preview_send(request, request->url);
+}
+
+static void quick_preview_parse(QuickPreviewRequest *request) {
+    const char *body = (const char *)request->body->data;
+    gsize length = request->body->len;
+
+    VideoMetadata *meta = request->oembed ? quick_preview_parse_oembed(body, length)
+                                          : quick_preview_parse_html(body, length);
+    if (!meta) {
+        quick_preview_fall_back(request);
+        return;
+    }
+
+    // og:image may be relative to the page
+    if (!request->oembed && meta->thumbnail_url) {
+        char *resolved = g_uri_resolve_relative(request->url, meta->thumbnail_url,
+                                                G_URI_FLAGS_NONE, NULL);
+        g_free(meta->thumbnail_url);
+        meta->thumbnail_url = resolved;
+    }
+    quick_preview_finish(request, meta);
+}
+
+static void on_quick_preview_read(GObject *source, GAsyncResult *result, gpointer user_data) {
+    QuickPreviewRequest *request = user_data;
+    GError *error = NULL;
+
+    GBytes *chunk = g_input_stream_read_bytes_finish(G_INPUT_STREAM(source), result, &error);
+    if (!chunk) {
+        g_debug("Quick preview read failed: %s", error->message);
+        g_error_free(error);
+        quick_preview_fall_back(request);
+        return;
+    }
+
+    gsize size = 0;
+    const guint8 *data = g_bytes_get_data(chunk, &size);
+    g_byte_array_append(request->body, data, size);
+    g_bytes_unref(chunk);
+
+    // A page's meta tags are all in its head, stop reading after it
+    gboolean head_done = !request->oembed && size > 0 &&
+                         g_strstr_len((const char *)request->body->data,
+                                      request->body->len, "</head>") != NULL;
+
+    if (size == 0 || head_done || request->body->len >= PAGE_READ_LIMIT) {
+        quick_preview_parse(request);
+        return;
+    }
+
+    g_input_stream_read_bytes_async(request->stream, READ_CHUNK_SIZE, G_PRIORITY_DEFAULT,
+                                    request->cancellable, on_quick_preview_read, request);
+}
+
+static void on_quick_preview_sent(GObject *source, GAsyncResult *result, gpointer user_data) {
+    QuickPreviewRequest *request = user_data;
+    SoupMessage *msg = soup_session_get_async_result_message(SOUP_SESSION(source), result);
+    GError *error = NULL;
+
+    GInputStream *stream = soup_session_send_finish(SOUP_SESSION(source), result, &error);
+    if (!stream) {
+        g_debug("Quick preview request failed: %s", error->message);
+        g_error_free(error);
+        quick_preview_fall_back(request);
+        return;
+    }
+
+    if (!SOUP_STATUS_IS_SUCCESSFUL(soup_message_get_status(msg))) {
+        g_object_unref(stream);
+        quick_preview_fall_back(request);
+        return;
+    }
+
+    // The URL may be the media itself: only a page is worth reading, and the
+    // headers say so before any of the body is fetched
+    if (!request->oembed) {
+        const char *type = soup_message_headers_get_content_type(
+            soup_message_get_response_headers(msg), NULL);
+        if (g_strcmp0(type, "text/html") != 0 &&
+            g_strcmp0(type, "application/xhtml+xml") != 0) {
+            g_debug("Quick preview skips %s content", type ? type : "untyped");
+            g_object_unref(stream);
+            quick_preview_finish(request, NULL);
+            return;
+        }
+    }
+
+    g_clear_object(&request->stream);
+    request->stream = stream;
+    g_byte_array_set_size(request->body, 0);
+    g_input_stream_read_bytes_async(stream, READ_CHUNK_SIZE, G_PRIORITY_DEFAULT,
+                                    request->cancellable, on_quick_preview_read, request);
+}
+
+static void quick_preview_send(QuickPreviewRequest *request, const char *request_url) {
+    SoupMessage *msg = soup_message_new(SOUP_METHOD_GET, request_url);
+    if (!msg) {
+        quick_preview_fall_back(request);
+        return;
+    }
+
+    soup_session_send_async(preview_session, msg, G_PRIORITY_DEFAULT, request->cancellable,
+                            on_quick_preview_sent, request);
+    g_object_unref(msg);
+}
+
+void quick_preview_fetch_async(const char *url, QuickPreviewCallback callback, gpointer user_data) {
+    AppConfig *config = config_get();
+
+    QuickPreviewRequest *request = g_malloc0(sizeof(QuickPreviewRequest));
+    request->url = g_strdup(url);
+    request->callback = callback;
+    request->user_data = user_data;
+
+    if (!config->quick_preview || !string_is_valid_url(url)) {
+        quick_preview_finish(request, NULL);
+        return;
+    }
+
+    if (!preview_session) {
+        preview_session = soup_session_new_with_options("user-agent", "datareel/" APP_VERSION,
+                                                        NULL);
+    }
+
+    request->cancellable = g_cancellable_new();
+    request->body = g_byte_array_new();
+    request->start_time = g_get_monotonic_time();
+    request->timeout_id = g_timeout_add(config->quick_preview_timeout_ms,
+                                        on_quick_preview_timeout, request);
+
+    const char *endpoint = oembed_endpoint_for(url);
+    if (endpoint) {
+        request->oembed = TRUE;
+
+        char *escaped = g_uri_escape_string(url, NULL, FALSE);
+        char *request_url = g_strdup_printf("%s%cformat=json&url=%s", endpoint,
+                                            strchr(endpoint, '?') ? '&' : '?', escaped);
+        quick_preview_send(request, request_url);
+        g_free(request_url);
+        g_free(escaped);
+    } else {
+        quick_preview_send(request, url);
+    }
+}
+
+static char *json_dup_string(JsonObject *obj, const char *member) {
+    const char *value = json_object_get_string_member_with_default(obj, member, NULL);
+    return value && *value ? g_strdup(value) : NULL;
+}
+
+VideoMetadata* quick_preview_parse_oembed(const char *body, gsize length) {
+    JsonParser *parser = json_parser_new();
+    VideoMetadata *meta = NULL;
+
+    if (json_parser_load_from_data(parser, body, length, NULL)) {
+        JsonNode *root = json_parser_get_root(parser);
+
+        if (JSON_NODE_HOLDS_OBJECT(root)) {
+            JsonObject *obj = json_node_get_object(root);
+            char *title = json_dup_string(obj, "title");
+
+            if (title) {
+                meta = g_malloc0(sizeof(VideoMetadata));
+                meta->title = title;
+                meta->uploader = json_dup_string(obj, "author_name");
+                meta->thumbnail_url = json_dup_string(obj, "thumbnail_url");
+            }
+        }
+    }
+
+    g_object_unref(parser);
+    return meta;
+}
+
+// The few entities that show up in titles; NULL if text isn't UTF-8
+static char *html_unescape(const char *text) {
+    static const struct {
+        const char *entity;
+        const char *text;
+    } entities[] = {
+        { "&quot;", "\"" }, { "&#39;", "'" }, { "&#x27;", "'" }, { "&apos;", "'" },
+        { "&lt;", "<" }, { "&gt;", ">" }, { "&amp;", "&" },
+    };
+    if (!g_utf8_validate(text, -1, NULL)) return NULL;
+
+    char *result = g_strdup(text);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(entities); i++) {
+        if (strstr(result, entities[i].entity)) {
+            char *replaced = string_replace_all(result, entities[i].entity, entities[i].text);
+            g_free(result);
+            result = replaced;
+        }
+    }
+    return result;
+}
+
+// Value of a tag attribute, from its regex match
+static char *match_attribute(GMatchInfo *match, int group) {
+    char *value = g_match_info_fetch(match, group);
+    if (value && !*value) {
+        g_free(value);
+        value = g_match_info_fetch(match, group + 1);
+    }
+    return value;
+}
+
+VideoMetadata* quick_preview_parse_html(const char *body, gsize length) {
+    static GRegex *meta_regex = NULL;
+    static GRegex *attribute_regex = NULL;
+    static GRegex *title_regex = NULL;
+
+    if (!meta_regex) {
+        meta_regex = g_regex_new("<meta\\s[^>]*>", G_REGEX_CASELESS | G_REGEX_RAW, 0, NULL);
+        attribute_regex = g_regex_new("([a-zA-Z:-]+)\\s*=\\s*(?:\"([^\"]*)\"|'([^']*)')",
+                                      G_REGEX_RAW, 0, NULL);
+        title_regex = g_regex_new("<title[^>]*>([^<]*)</title>",
+                                  G_REGEX_CASELESS | G_REGEX_RAW, 0, NULL);
+    }
+
+    char *title = NULL;
+    char *site = NULL;
+    char *author = NULL;
+    char *image = NULL;
+    GMatchInfo *tag_match = NULL;
+
+    g_regex_match_full(meta_regex, body, length, 0, 0, &tag_match, NULL);
+    while (g_match_info_matches(tag_match)) {
+        char *tag = g_match_info_fetch(tag_match, 0);
+        char *key = NULL;
+        char *content = NULL;
+        GMatchInfo *attribute_match = NULL;
+
+        g_regex_match(attribute_regex, tag, 0, &attribute_match);
+        while (g_match_info_matches(attribute_match)) {
+            char *name = g_match_info_fetch(attribute_match, 1);
+            if (g_ascii_strcasecmp(name, "property") == 0 || g_ascii_strcasecmp(name, "name") == 0) {
+                g_free(key);
+                key = match_attribute(attribute_match, 2);
+            } else if (g_ascii_strcasecmp(name, "content") == 0) {
+                g_free(content);
+                content = match_attribute(attribute_match, 2);
+            }
+            g_free(name);
+            g_match_info_next(attribute_match, NULL);
+        }
+        g_match_info_free(attribute_match);
+
+        char **target = NULL;
+        if (key && content && *content) {
+            if (g_ascii_strcasecmp(key, "og:title") == 0 || g_ascii_strcasecmp(key, "twitter:title") == 0) {
+                target = &title;
+            } else if (g_ascii_strcasecmp(key, "og:image") == 0 || g_ascii_strcasecmp(key, "twitter:image") == 0) {
+                target = &image;
+            } else if (g_ascii_strcasecmp(key, "og:site_name") == 0) {
+                target = &site;
+            } else if (g_ascii_strcasecmp(key, "author") == 0) {
+                target = &author;
+            }
+        }
+
+        // The first of og: and twitter: wins
+        if (target && !*target) {
+            *target = html_unescape(content);
+        }
+
+        g_free(key);
+        g_free(content);
+        g_free(tag);
+        g_match_info_next(tag_match, NULL);
+    }
+    g_match_info_free(tag_match);
+
+    if (!title) {
+        GMatchInfo *title_match = NULL;
+        if (g_regex_match_full(title_regex, body, length, 0, 0, &title_match, NULL)) {
+            char *raw = g_match_info_fetch(title_match, 1);
+            char *trimmed = string_trim(raw);
+            if (trimmed && *trimmed) {
+                title = html_unescape(trimmed);
+            }
+            g_free(trimmed);
+            g_free(raw);
+        }
+        g_match_info_free(title_match);
+    }
+
+    VideoMetadata *meta = NULL;
+    if (title) {
+        meta = g_malloc0(sizeof(VideoMetadata));
+        meta->title = g_steal_pointer(&title);
+        meta->uploader = author ? g_steal_pointer(&author) : g_steal_pointer(&site);
+        meta->thumbnail_url = g_steal_pointer(&image);
+    }
+
+    g_free(title);
+    g_free(site);
+    g_free(author);
+    g_free(image);
+    return meta;
+}
+
+void quick_preview_cleanup(void) {
+    if (preview_session) {
+        soup_session_abort(preview_session);
+        g_clear_object(&preview_session);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef QUICK_PREVIEW_H
+#define QUICK_PREVIEW_H
+
+#include "common.h"
+
+// First phase of the preview: title, uploader and thumbnail URL from the
+// site's oEmbed endpoint, or from the page's Open Graph tags, fetched
+// directly over HTTP. Answers well before yt-dlp has extracted the formats;
+// the full metadata replaces it when metadata_fetch_async() finishes.
+
+// meta is owned by the callback and NULL when nothing was found, the request
+// failed or [preview] quick is off. Called on the main thread.
+typedef void (*QuickPreviewCallback)(const char *url, VideoMetadata *meta, gpointer user_data);
+
+void quick_preview_fetch_async(const char *url, QuickPreviewCallback callback, gpointer user_data);
+
+// Parsers for the two response kinds; NULL without a title
+VideoMetadata* quick_preview_parse_oembed(const char *body, gsize length);
+VideoMetadata* quick_preview_parse_html(const char *body, gsize length);
+
+void quick_preview_cleanup(void);
+
+#endif
@@ -0,0 +1,261 @@
+// prlimit() and getpgid()
+#define _GNU_SOURCE
+
+#include "resource_control.h"
+#include "../utils/config.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define CPU_MAX_PERIOD_US 100000
+
+// No glibc wrapper for ioprio_set(2)
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_WHO_PGRP 2
+
+typedef enum {
+    CGROUP_UNKNOWN,     // Not set up yet
+    CGROUP_READY,
+    CGROUP_UNAVAILABLE  // Using the per-process fallback
+} CgroupState;
+
+static CgroupState cgroup_state = CGROUP_UNKNOWN;
+static char *cgroup_base = NULL;
+static guint config_watch_id = 0;
+
+static const char* stage_cgroup_name(DownloadStatus stage) {
+    return stage == DOWNLOAD_STATUS_PROCESSING ? "processing" : "download";
+}
+
+static gboolean cgroup_write(const char *dir, const char *file, const char *value) {
+    char *path = g_build_filename(dir, file, NULL);
+    FILE *f = fopen(path, "w");
+    gboolean ok = FALSE;
+
+    if (f) {
+        // cgroupfs reports errors on write or close, not on open
+        ok = fputs(value, f) >= 0;
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok) {
+        g_debug("cgroup: cannot write '%s' to %s: %s", value, path, g_strerror(errno));
+    }
+
+    g_free(path);
+    return ok;
+}
+
+// Our own cgroup v2 directory, from the "0::/path" line
+static char* current_cgroup_dir(void) {
+    char *contents = NULL;
+    char *dir = NULL;
+
+    if (!g_file_get_contents("/proc/self/cgroup", &contents, NULL, NULL)) {
+        return NULL;
+    }
+
+    char **lines = g_strsplit(contents, "\n", -1);
+    for (int i = 0; lines[i] != NULL; i++) {
+        if (g_str_has_prefix(lines[i], "0::")) {
+            dir = g_build_filename(CGROUP_ROOT, lines[i] + strlen("0::"), NULL);
+            break;
+        }
+    }
+
+    g_strfreev(lines);
+    g_free(contents);
+    return dir;
+}
+
+static void cgroup_configure_stage(AppConfig *config, DownloadStatus stage) {
+    char *dir = g_build_filename(cgroup_base, stage_cgroup_name(stage), NULL);
+    gboolean processing = stage == DOWNLOAD_STATUS_PROCESSING;
+
+    char *weight = g_strdup_printf("%d", processing ? config->processing_cpu_weight
+                                                    : config->download_cpu_weight);
+    cgroup_write(dir, "cpu.weight", weight);
+    g_free(weight);
+
+    int cpu_percent = processing ? config->processing_cpu_max_percent : 0;
+    char *cpu_max = cpu_percent > 0
+        ? g_strdup_printf("%" G_GINT64_FORMAT " %d",
+                          (gint64)CPU_MAX_PERIOD_US * cpu_percent / 100 * g_get_num_processors(),
+                          CPU_MAX_PERIOD_US)
+        : g_strdup_printf("max %d", CPU_MAX_PERIOD_US);
+    cgroup_write(dir, "cpu.max", cpu_max);
+    g_free(cpu_max);
+
+    char *memory_max = config->memory_max_mb > 0
+        ? g_strdup_printf("%" G_GINT64_FORMAT, (gint64)config->memory_max_mb * 1024 * 1024)
+        : g_strdup("max");
+    cgroup_write(dir, "memory.max", memory_max);
+    g_free(memory_max);
+
+    char *io_weight = g_strdup_printf("default %d", processing ? config->processing_io_weight
+                                                               : config->download_io_weight);
+    cgroup_write(dir, "io.weight", io_weight);
+    g_free(io_weight);
+
+    g_free(dir);
+}
+
+static void on_config_changed(AppConfig *config, gpointer user_data) {
+    (void)user_data;
+    if (cgroup_state == CGROUP_READY) {
+        cgroup_configure_stage(config, DOWNLOAD_STATUS_DOWNLOADING);
+        cgroup_configure_stage(config, DOWNLOAD_STATUS_PROCESSING);
+    }
+}
+
+// cpu, memory and io are all enabled for the cgroup
+static gboolean cgroup_has_controllers(const char *dir) {
+    static const char * const required[] = { "cpu", "memory", "io" };
+    char *path = g_build_filename(dir, "cgroup.controllers", NULL);
+    char *contents = NULL;
+    gboolean ok = g_file_get_contents(path, &contents, NULL, NULL);
+
+    if (ok) {
+        char **enabled = g_strsplit_set(g_strstrip(contents), " \n", -1);
+        for (gsize i = 0; i < G_N_ELEMENTS(required) && ok; i++) {
+            ok = g_strv_contains((const char * const *)enabled, required[i]);
+            if (!ok) {
+                g_debug("cgroup: controller %s not delegated to %s", required[i], dir);
+            }
+        }
+        g_strfreev(enabled);
+    }
+
+    g_free(contents);
+    g_free(path);
+    return ok;
+}
+
+// Build <our cgroup>/{main,download,processing}. cgroup v2 only allows
+// controllers to be enabled for children of a cgroup without processes of
+// its own, so the application first moves itself into "main".
+static gboolean cgroup_setup(AppConfig *config) {
+    char *base = current_cgroup_dir();
+    if (!base) return FALSE;
+
+    char *main_dir = g_build_filename(base, "main", NULL);
+    char *pid = g_strdup_printf("%d", getpid());
+    gboolean ok = (g_mkdir(main_dir, 0755) == 0 || errno == EEXIST) &&
+                  cgroup_write(main_dir, "cgroup.procs", pid);
+    g_free(pid);
+    g_free(main_dir);
+
+    if (ok) {
+        // Fails for controllers the parent didn't delegate, checked below
+        cgroup_write(base, "cgroup.subtree_control", "+cpu");
+        cgroup_write(base, "cgroup.subtree_control", "+memory");
+        cgroup_write(base, "cgroup.subtree_control", "+io");
+
+        for (int i = 0; i < 2 && ok; i++) {
+            char *dir = g_build_filename(base, i == 0 ? "download" : "processing", NULL);
+            ok = g_mkdir(dir, 0755) == 0 || errno == EEXIST;
+            g_free(dir);
+        }
+    }
+
+    // Without the controllers the stage cgroups limit nothing; the
+    // nice/ioprio/rlimit fallback does better
+    if (ok) {
+        char *download_dir = g_build_filename(base, "download", NULL);
+        ok = cgroup_has_controllers(download_dir);
+        g_free(download_dir);
+    }
+
+    if (!ok) {
+        g_free(base);
+        return FALSE;
+    }
+
+    cgroup_base = base;
+    cgroup_configure_stage(config, DOWNLOAD_STATUS_DOWNLOADING);
+    cgroup_configure_stage(config, DOWNLOAD_STATUS_PROCESSING);
+    g_print("Resource control: using cgroup subtree %s\n", base);
+    return TRUE;
+}
+
+// cgroup.procs moves single processes, so every member of the group
+// (the downloader and any ffmpeg it started) is moved by scanning /proc
+static void cgroup_move_group(pid_t pgid, DownloadStatus stage) {
+    char *dir = g_build_filename(cgroup_base, stage_cgroup_name(stage), NULL);
+    DIR *proc = opendir("/proc");
+
+    if (!proc) {
+        g_free(dir);
+        return;
+    }
+
+    for (struct dirent *entry; (entry = readdir(proc)) != NULL;) {
+        if (!g_ascii_isdigit(entry->d_name[0])) continue;
+
+        pid_t pid = atoi(entry->d_name);
+        if (pid == pgid || getpgid(pid) == pgid) {
+            cgroup_write(dir, "cgroup.procs", entry->d_name);
+        }
+    }
+
+    closedir(proc);
+    g_free(dir);
+}
+
+static void apply_fallback(AppConfig *config, pid_t pgid, DownloadStatus stage) {
+    gboolean processing = stage == DOWNLOAD_STATUS_PROCESSING;
+
+    int nice_level = processing ? config->processing_nice : config->download_nice;
+    if (setpriority(PRIO_PGRP, pgid, nice_level) != 0) {
+        g_debug("setpriority(%d): %s", pgid, g_strerror(errno));
+    }
+
+#ifdef __linux__
+    int io_level = processing ? config->processing_io_level : config->download_io_level;
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PGRP, pgid,
+            (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | io_level);
+
+    // Inherited by the ffmpeg processes started afterwards
+    if (config->memory_max_mb > 0) {
+        struct rlimit limit;
+        limit.rlim_cur = limit.rlim_max = (rlim_t)config->memory_max_mb * 1024 * 1024;
+        prlimit(pgid, RLIMIT_DATA, &limit, NULL);
+    }
+#endif
+}
+
+void resource_control_apply(pid_t pgid, DownloadStatus stage) {
+    AppConfig *config = config_get();
+
+    if (pgid <= 0) return;
+
+    if (cgroup_state == CGROUP_UNKNOWN && config->use_cgroups) {
+        cgroup_state = cgroup_setup(config) ? CGROUP_READY : CGROUP_UNAVAILABLE;
+        if (cgroup_state == CGROUP_UNAVAILABLE) {
+            g_print("Resource control: no delegated cgroup, using nice/ioprio/rlimits\n");
+        }
+        config_watch_id = config_add_watch(on_config_changed, NULL);
+    }
+
+    if (cgroup_state == CGROUP_READY && config->use_cgroups) {
+        cgroup_move_group(pgid, stage);
+    } else {
+        apply_fallback(config, pgid, stage);
+    }
+}
+
+void resource_control_cleanup(void) {
+    if (config_watch_id > 0) {
+        config_remove_watch(config_watch_id);
+        config_watch_id = 0;
+    }
+    // The stage cgroups are kept: they may still hold running children,
+    // and the next start reuses them
+    g_clear_pointer(&cgroup_base, g_free);
+    cgroup_state = CGROUP_UNKNOWN;
+}
@@ -0,0 +1,17 @@
+#ifndef RESOURCE_CONTROL_H
+#define RESOURCE_CONTROL_H
+
+#include "common.h"
+
+// Per-stage resource limits for download processes. When the session
+// delegates a writable cgroup v2 subtree, processes are placed in a
+// "download" or "processing" child cgroup with CPU weight, CPU and memory
+// caps, and IO weight. Otherwise nice, ioprio and rlimits are set on the
+// process group instead.
+//
+// Apply on spawn and on every stage change; pgid is the process group the
+// downloader and its ffmpeg children run in.
+void resource_control_apply(pid_t pgid, DownloadStatus stage);
+void resource_control_cleanup(void);
+
+#endif
@@ -0,0 +1,86 @@
+// pipe2() and posix_spawn_file_actions_addclosefrom_np()
+#define _GNU_SOURCE
+
+#include "spawn.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+
+extern char **environ;
+
+static gboolean make_cloexec_pipe(int pipefd[2]) {
+#if defined(__linux__) || defined(__FreeBSD__)
+    return pipe2(pipefd, O_CLOEXEC) == 0;
+#else
+    // Not atomic: another thread forking in between could leak the fds
+    if (pipe(pipefd) != 0) return FALSE;
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+    return TRUE;
+#endif
+}
+
+gboolean spawn_with_output(char **argv, pid_t *pid, int *output_fd, GError **error) {
+    int pipefd[2];
+
+    if (!make_cloexec_pipe(pipefd)) {
+        int saved_errno = errno;
+        g_set_error(error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                    "Failed to create pipe: %s", g_strerror(saved_errno));
+        return FALSE;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    // dup2 clears close-on-exec on the target, so only these survive exec
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDERR_FILENO);
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 34)
+    // Also drop descriptors opened by libraries without close-on-exec
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+#endif
+
+    // Start from default signal handling and an empty mask, whatever the
+    // GUI has set up for itself
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP;
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    int result = posix_spawnp(pid, argv[0], &actions, &attr, argv, environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipefd[1]);
+
+    if (result != 0) {
+        close(pipefd[0]);
+        g_set_error(error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                    "Failed to execute %s: %s", argv[0], g_strerror(result));
+        return FALSE;
+    }
+
+    int fd_flags = fcntl(pipefd[0], F_GETFL, 0);
+    fcntl(pipefd[0], F_SETFL, fd_flags | O_NONBLOCK);
+
+    *output_fd = pipefd[0];
+    return TRUE;
+}
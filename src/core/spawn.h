@@ -0,0 +1,16 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "common.h"
+
+// Start argv in a new process group, with stdout and stderr merged into a
+// pipe. The group id equals the returned pid, so signals and resource
+// limits can reach the ffmpeg processes yt-dlp starts. The child gets
+// /dev/null as stdin and no other descriptors of ours: every fd we create
+// is close-on-exec, and on glibc the rest are closed explicitly. Uses
+// posix_spawn, so the cost doesn't grow with the size of our heap.
+//
+// On success *output_fd is the non-blocking, close-on-exec read end.
+gboolean spawn_with_output(char **argv, pid_t *pid, int *output_fd, GError **error);
+
+#endif
@@ -0,0 +1,208 @@
+#include "storage_planner.h"
+#include "format_planner.h"
+#include "../utils/config.h"
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+// Pre-flight disk space planning: before an item starts, its expected size
+// is reserved on the target volume. Items that don't fit next to the
+// already running downloads stay queued instead of failing halfway.
+
+// yt-dlp keeps the downloaded streams until the merged or converted output
+// is written, so the peak usage is about twice the final size
+#define PEAK_USAGE_FACTOR 2
+
+typedef struct {
+    DownloadItem *item;
+    dev_t device;
+    int64_t estimate;       // Expected final size
+    int64_t bytes;          // Reserved peak usage
+} StorageReservation;
+
+static GList *reservations = NULL;
+
+static const int quality_max_height[] = {
+    [QUALITY_BEST] = 0,
+    [QUALITY_1080P] = 1080,
+    [QUALITY_720P] = 720,
+    [QUALITY_480P] = 480,
+    [QUALITY_360P] = 360,
+    [QUALITY_AUDIO_ONLY] = 0,
+    [QUALITY_CUSTOM] = 0,
+};
+
+// Largest video and audio streams matching the options, approximating what
+// yt-dlp's bestvideo[height<=N]+bestaudio selection will download
+static int64_t estimate_from_formats(GList *formats, DownloadOptions *opts) {
+    int max_height = 0;
+    if (opts && opts->quality >= 0 && opts->quality < (int)G_N_ELEMENTS(quality_max_height)) {
+        max_height = quality_max_height[opts->quality];
+    }
+    gboolean audio_only = opts && (opts->audio_only || opts->quality == QUALITY_AUDIO_ONLY);
+
+    int64_t best_video = 0;
+    int64_t best_audio = 0;
+
+    for (GList *l = formats; l != NULL; l = l->next) {
+        FormatInfo *format = l->data;
+        if (format->filesize <= 0) continue;
+
+        if (format->has_video) {
+            if (max_height > 0 && format->height > max_height) continue;
+            best_video = MAX(best_video, format->filesize);
+        } else if (format->has_audio) {
+            best_audio = MAX(best_audio, format->filesize);
+        }
+    }
+
+    return audio_only ? best_audio : best_video + best_audio;
+}
+
+int64_t storage_planner_estimate_size(DownloadItem *item) {
+    int64_t size = 0;
+
+    if (item->metadata) {
+        // The streams the format rules will actually pick
+        FormatPlan *plan = format_planner_plan(item->metadata->formats, item->options);
+        if (plan) {
+            size = plan->estimated_size;
+            format_plan_free(plan);
+        }
+        if (size <= 0) {
+            size = item->metadata->filesize;
+        }
+        if (size <= 0) {
+            size = estimate_from_formats(item->metadata->formats, item->options);
+        }
+    }
+
+    if (size <= 0) {
+        size = (int64_t)config_get()->unknown_size_mb * 1024 * 1024;
+    }
+
+    return size;
+}
+
+// Bytes still to be written by downloads already running on a volume
+static int64_t outstanding_bytes(dev_t device) {
+    int64_t total = 0;
+
+    for (GList *l = reservations; l != NULL; l = l->next) {
+        StorageReservation *reservation = l->data;
+        if (reservation->device != device) continue;
+
+        int64_t written = (int64_t)(reservation->estimate * reservation->item->progress / 100.0);
+        total += MAX(reservation->bytes - written, 0);
+    }
+
+    return total;
+}
+
+static gboolean has_reservations(dev_t device) {
+    for (GList *l = reservations; l != NULL; l = l->next) {
+        StorageReservation *reservation = l->data;
+        if (reservation->device == device) return TRUE;
+    }
+    return FALSE;
+}
+
+// Candidate output roots: the item's own path, plus the configured extra
+// roots when the item uses the default location and may be spread
+static GPtrArray *candidate_roots(DownloadItem *item) {
+    AppConfig *config = config_get();
+    GPtrArray *roots = g_ptr_array_new();
+
+    g_ptr_array_add(roots, item->output_path);
+
+    if (config->output_roots &&
+        g_strcmp0(item->output_path, config->default_download_path) == 0) {
+        for (int i = 0; config->output_roots[i] != NULL; i++) {
+            g_ptr_array_add(roots, config->output_roots[i]);
+        }
+    }
+
+    return roots;
+}
+
+StoragePlanResult storage_planner_reserve(DownloadItem *item) {
+    AppConfig *config = config_get();
+    int64_t estimate = storage_planner_estimate_size(item);
+    int64_t needed = estimate * PEAK_USAGE_FACTOR;
+    int64_t min_free = (int64_t)config->min_free_mb * 1024 * 1024;
+
+    storage_planner_release(item);
+
+    GPtrArray *roots = candidate_roots(item);
+    const char *best_root = NULL;
+    dev_t best_device = 0;
+    int64_t best_available = G_MININT64;
+    gboolean any_busy = FALSE;
+
+    for (guint i = 0; i < roots->len; i++) {
+        const char *root = g_ptr_array_index(roots, i);
+        struct statvfs vfs;
+        struct stat st;
+
+        if (statvfs(root, &vfs) != 0 || stat(root, &st) != 0) {
+            continue;
+        }
+
+        int64_t available = (int64_t)vfs.f_bavail * (int64_t)vfs.f_frsize
+                            - outstanding_bytes(st.st_dev) - min_free;
+        any_busy |= has_reservations(st.st_dev);
+
+        // Spread across volumes: prefer the one with the most headroom
+        if (available > best_available) {
+            best_available = available;
+            best_root = root;
+            best_device = st.st_dev;
+        }
+    }
+
+    if (!best_root) {
+        // Path can't be inspected: let yt-dlp report the real error
+        g_ptr_array_free(roots, TRUE);
+        return STORAGE_PLAN_OK;
+    }
+
+    if (best_available < needed) {
+        g_ptr_array_free(roots, TRUE);
+        return any_busy ? STORAGE_PLAN_WAIT : STORAGE_PLAN_NO_SPACE;
+    }
+
+    if (strcmp(best_root, item->output_path) != 0) {
+        g_print("Storage: placing download on %s\n", best_root);
+        g_free(item->output_path);
+        item->output_path = g_strdup(best_root);
+    }
+    g_ptr_array_free(roots, TRUE);
+
+    StorageReservation *reservation = g_malloc0(sizeof(StorageReservation));
+    reservation->item = item;
+    reservation->device = best_device;
+    reservation->estimate = estimate;
+    reservation->bytes = needed;
+    reservations = g_list_prepend(reservations, reservation);
+
+    return STORAGE_PLAN_OK;
+}
+
+void storage_planner_release(DownloadItem *item) {
+    for (GList *l = reservations; l != NULL; l = l->next) {
+        StorageReservation *reservation = l->data;
+        if (reservation->item == item) {
+            reservations = g_list_delete_link(reservations, l);
+            g_free(reservation);
+            return;
+        }
+    }
+}
+
+int64_t storage_planner_reserved_bytes(void) {
+    int64_t total = 0;
+    for (GList *l = reservations; l != NULL; l = l->next) {
+        StorageReservation *reservation = l->data;
+        total += reservation->bytes;
+    }
+    return total;
+}
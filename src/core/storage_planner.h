@@ -0,0 +1,17 @@
+#ifndef STORAGE_PLANNER_H
+#define STORAGE_PLANNER_H
+
+#include "common.h"
+
+typedef enum {
+    STORAGE_PLAN_OK,
+    STORAGE_PLAN_WAIT,      // Fits once running downloads release space
+    STORAGE_PLAN_NO_SPACE   // Does not fit even with nothing else running
+} StoragePlanResult;
+
+int64_t storage_planner_estimate_size(DownloadItem *item);
+StoragePlanResult storage_planner_reserve(DownloadItem *item);
+void storage_planner_release(DownloadItem *item);
+int64_t storage_planner_reserved_bytes(void);
+
+#endif
@@ -0,0 +1,155 @@
+#include "work_pool.h"
+#include "../utils/config.h"
+#include <stdatomic.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+// Niceness of background threads (and the processes they start)
+#define BACKGROUND_NICE 10
+
+typedef struct {
+    GTask *task;
+    GTaskThreadFunc func;
+    WorkLane lane;
+    gint64 queued_time;
+} WorkJob;
+
+static const char *lane_labels[WORK_LANE_COUNT] = {
+    [WORK_LANE_INTERACTIVE] = "interactive",
+    [WORK_LANE_BACKGROUND] = "background",
+};
+
+static GThreadPool *lane_pools[WORK_LANE_COUNT];
+static _Atomic gboolean stopping = FALSE;
+static _Atomic uint64_t lane_queued[WORK_LANE_COUNT];
+static _Atomic uint64_t lane_running[WORK_LANE_COUNT];
+static _Atomic uint64_t lane_completed[WORK_LANE_COUNT];
+static _Atomic uint64_t lane_wait_sum[WORK_LANE_COUNT];
+static _Atomic uint64_t lane_wait_max[WORK_LANE_COUNT];
+
+static int lane_limit(WorkLane lane) {
+    AppConfig *config = config_get();
+    return lane == WORK_LANE_INTERACTIVE ? config->interactive_workers
+                                         : config->background_workers;
+}
+
+static void work_job_run(gpointer data, gpointer user_data) {
+    WorkJob *job = data;
+    WorkLane lane = GPOINTER_TO_INT(user_data);
+
+    // Background threads belong to an exclusive pool, so lowering one
+    // never affects an unrelated job
+    static _Thread_local gboolean lowered = FALSE;
+    if (lane == WORK_LANE_BACKGROUND && !lowered) {
+#ifdef __linux__
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), BACKGROUND_NICE);
+#endif
+        lowered = TRUE;
+    }
+
+    uint64_t wait = (uint64_t)(g_get_monotonic_time() - job->queued_time);
+    atomic_fetch_sub_explicit(&lane_queued[lane], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&lane_running[lane], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&lane_wait_sum[lane], wait, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&lane_wait_max[lane], memory_order_relaxed);
+    while (wait > max && !atomic_compare_exchange_weak_explicit(&lane_wait_max[lane], &max, wait,
+                                                                memory_order_relaxed,
+                                                                memory_order_relaxed)) {
+    }
+
+    // Jobs still queued at shutdown return instead of running
+    if (atomic_load_explicit(&stopping, memory_order_relaxed)) {
+        g_task_return_new_error(job->task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                "Shutting down");
+    } else {
+        job->func(job->task, g_task_get_source_object(job->task),
+                  g_task_get_task_data(job->task), g_task_get_cancellable(job->task));
+    }
+
+    atomic_fetch_sub_explicit(&lane_running[lane], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&lane_completed[lane], 1, memory_order_relaxed);
+    g_object_unref(job->task);
+    g_free(job);
+}
+
+void work_pool_run_task(WorkLane lane, GTask *task, GTaskThreadFunc func) {
+    int limit = MAX(lane_limit(lane), 1);
+
+    if (!lane_pools[lane]) {
+        lane_pools[lane] = g_thread_pool_new(work_job_run, GINT_TO_POINTER(lane), limit,
+                                             lane == WORK_LANE_BACKGROUND, NULL);
+    } else if (g_thread_pool_get_max_threads(lane_pools[lane]) != limit) {
+        // Follow a config reload
+        g_thread_pool_set_max_threads(lane_pools[lane], limit, NULL);
+    }
+
+    WorkJob *job = g_malloc0(sizeof(WorkJob));
+    job->task = g_object_ref(task);
+    job->func = func;
+    job->lane = lane;
+    job->queued_time = g_get_monotonic_time();
+
+    atomic_fetch_add_explicit(&lane_queued[lane], 1, memory_order_relaxed);
+    g_thread_pool_push(lane_pools[lane], job, NULL);
+}
+
+void work_pool_get_stats(WorkLane lane, WorkLaneStats *stats) {
+    stats->queued = atomic_load_explicit(&lane_queued[lane], memory_order_relaxed);
+    stats->running = atomic_load_explicit(&lane_running[lane], memory_order_relaxed);
+    stats->completed = atomic_load_explicit(&lane_completed[lane], memory_order_relaxed);
+
+    uint64_t started = stats->completed + stats->running;
+    uint64_t wait_sum = atomic_load_explicit(&lane_wait_sum[lane], memory_order_relaxed);
+    stats->mean_wait = started > 0 ? (double)wait_sum / started / G_USEC_PER_SEC : 0.0;
+    stats->max_wait = (double)atomic_load_explicit(&lane_wait_max[lane], memory_order_relaxed)
+                      / G_USEC_PER_SEC;
+}
+
+const char* work_pool_lane_label(WorkLane lane) {
+    return lane_labels[lane];
+}
+
+char* work_pool_render_prometheus(void) {
+    static const struct {
+        const char *name;
+        const char *help;
+        const char *type;
+    } series[] = {
+        { "datareel_work_queue_depth", "Jobs waiting for a worker thread", "gauge" },
+        { "datareel_work_running", "Jobs running on a worker thread", "gauge" },
+        { "datareel_work_completed_total", "Jobs finished", "counter" },
+        { "datareel_work_wait_seconds_max", "Longest wait for a worker thread", "gauge" },
+    };
+    GString *out = g_string_new(NULL);
+
+    for (gsize s = 0; s < G_N_ELEMENTS(series); s++) {
+        g_string_append_printf(out, "# HELP %s %s\n# TYPE %s %s\n", series[s].name,
+                               series[s].help, series[s].name, series[s].type);
+        for (int lane = 0; lane < WORK_LANE_COUNT; lane++) {
+            WorkLaneStats stats;
+            work_pool_get_stats(lane, &stats);
+            double value = s == 0 ? stats.queued
+                         : s == 1 ? stats.running
+                         : s == 2 ? stats.completed
+                         : stats.max_wait;
+            g_string_append_printf(out, "%s{lane=\"%s\"} %g\n", series[s].name,
+                                   lane_labels[lane], value);
+        }
+    }
+
+    return g_string_free(out, FALSE);
+}
+
+void work_pool_cleanup(void) {
+    atomic_store_explicit(&stopping, TRUE, memory_order_relaxed);
+    for (int lane = 0; lane < WORK_LANE_COUNT; lane++) {
+        if (lane_pools[lane]) {
+            g_thread_pool_free(lane_pools[lane], FALSE, TRUE);
+            lane_pools[lane] = NULL;
+        }
+    }
+}
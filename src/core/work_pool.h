@@ -0,0 +1,39 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include "common.h"
+
+// Thread pool for blocking helper jobs (yt-dlp lookups, thumbnail
+// downloads), split into lanes with their own threads and limits
+// ([workers] in the config). The interactive lane serves what the user is
+// waiting for and never queues behind background work; background threads
+// run niced, and so do the processes they start.
+typedef enum {
+    WORK_LANE_INTERACTIVE,  // Preview of the URL being entered
+    WORK_LANE_BACKGROUND,   // Prefetches and thumbnails for queued items
+    WORK_LANE_COUNT
+} WorkLane;
+
+typedef struct {
+    uint64_t queued;        // Waiting for a thread
+    uint64_t running;
+    uint64_t completed;
+    double mean_wait;       // Seconds from submission to start
+    double max_wait;        // Longest wait seen
+} WorkLaneStats;
+
+// Run func on a lane thread, like g_task_run_in_thread(). The pool keeps a
+// reference to the task until func returns.
+void work_pool_run_task(WorkLane lane, GTask *task, GTaskThreadFunc func);
+
+void work_pool_get_stats(WorkLane lane, WorkLaneStats *stats);
+const char* work_pool_lane_label(WorkLane lane);
+
+// Lane gauges and counters in Prometheus text format
+char* work_pool_render_prometheus(void);
+
+// Waits for running jobs; queued ones return G_IO_ERROR_CANCELLED without
+// running, so every task still completes
+void work_pool_cleanup(void);
+
+#endif
@@ -1,32 +1,130 @@
 #include "ytdlp_manager.h"
+#include "clip_cutter.h"
+#include "../utils/config.h"
 #include <gio/gio.h>
+#include <stdarg.h>
 
-// Check if yt-dlp is installed and get version
-YtdlpInfo* ytdlp_get_info(void) {
-    YtdlpInfo *info = g_malloc0(sizeof(YtdlpInfo));
+// Launch spec: the argv prefix every yt-dlp invocation starts with. It is
+// resolved once against PATH and cached, so spawning never searches PATH,
+// and rebuilt only when the configuration changes.
+static YtdlpLaunchSpec *launch_spec = NULL;
+static guint launch_config_watch_id = 0;
+
+static void ytdlp_launch_spec_free(YtdlpLaunchSpec *spec) {
+    if (!spec) return;
+    g_strfreev(spec->argv);
+    g_free(spec);
+}
+
+// Absolute path of a program name or path, NULL if it isn't executable
+static char* resolve_program(const char *program) {
+    return program && *program ? g_find_program_in_path(program) : NULL;
+}
+
+static YtdlpLaunchSpec* ytdlp_launch_spec_build(AppConfig *config) {
+    YtdlpLaunchSpec *spec = g_malloc0(sizeof(YtdlpLaunchSpec));
+    GPtrArray *argv = g_ptr_array_new();
 
-    // Check if yt-dlp exists in PATH
-    char *path = g_find_program_in_path("yt-dlp");
-    if (path) {
-        info->path = path;
-        info->is_installed = TRUE;
-
-        // Get version
-        char *output = NULL;
-        char *cmd[] = {"yt-dlp", "--version", NULL};
-
-        if (g_spawn_sync(NULL, cmd, NULL, G_SPAWN_SEARCH_PATH,
-                        NULL, NULL, &output, NULL, NULL, NULL)) {
-            if (output) {
-                g_strchomp(output);
-                info->version = output;
+    if (config->ytdlp_launch_mode == YTDLP_LAUNCH_BINARY) {
+        char *binary = resolve_program(config->ytdlp_binary);
+        spec->resolved = binary != NULL;
+        g_ptr_array_add(argv, binary ? binary : g_strdup(config->ytdlp_binary));
+    } else {
+        char *interpreter = config->python_venv
+                            ? g_build_filename(config->python_venv, "bin", "python", NULL)
+                            : g_strdup(config->python_interpreter);
+        char *python = resolve_program(interpreter);
+        spec->resolved = python != NULL;
+        g_ptr_array_add(argv, python ? python : g_strdup(interpreter));
+        g_free(interpreter);
+
+        for (int i = 0; config->interpreter_flags && config->interpreter_flags[i]; i++) {
+            g_ptr_array_add(argv, g_strdup(config->interpreter_flags[i]));
+        }
+
+        if (config->ytdlp_launch_mode == YTDLP_LAUNCH_PYTHON_MODULE) {
+            g_ptr_array_add(argv, g_strdup("-m"));
+            g_ptr_array_add(argv, g_strdup("yt_dlp"));
+        } else {
+            // A zipapp is run by path, but may be installed in PATH like
+            // the official yt-dlp release
+            char *zipapp = resolve_program(config->ytdlp_binary);
+            if (!zipapp && g_file_test(config->ytdlp_binary, G_FILE_TEST_IS_REGULAR)) {
+                zipapp = g_canonicalize_filename(config->ytdlp_binary, NULL);
             }
+            spec->resolved = spec->resolved && zipapp != NULL;
+            g_ptr_array_add(argv, zipapp ? zipapp : g_strdup(config->ytdlp_binary));
         }
-    } else {
-        info->is_installed = FALSE;
     }
 
-    return info;
+    g_ptr_array_add(argv, NULL);
+    spec->argv = (char **)g_ptr_array_free(argv, FALSE);
+    return spec;
+}
+
+static void on_launch_config_changed(AppConfig *config, gpointer user_data) {
+    (void)user_data;
+    YtdlpLaunchSpec *spec = ytdlp_launch_spec_build(config);
+
+    if (launch_spec && g_strv_equal((const char * const *)spec->argv,
+                                    (const char * const *)launch_spec->argv)) {
+        ytdlp_launch_spec_free(spec);
+        return;
+    }
+
+    ytdlp_launch_spec_free(launch_spec);
+    launch_spec = spec;
+
+    // A different launcher may mean a different yt-dlp
+    ytdlp_invalidate_info();
+}
+
+const YtdlpLaunchSpec* ytdlp_get_launch_spec(void) {
+    if (!launch_spec) {
+        launch_spec = ytdlp_launch_spec_build(config_get());
+        if (!launch_config_watch_id) {
+            launch_config_watch_id = config_add_watch(on_launch_config_changed, NULL);
+        }
+
+        char *command = g_strjoinv(" ", launch_spec->argv);
+        g_print("yt-dlp launcher: %s%s\n", command,
+                launch_spec->resolved ? "" : " (not found)");
+        g_free(command);
+    }
+    return launch_spec;
+}
+
+// Full argv: the launch prefix followed by the NULL-terminated arguments
+char** ytdlp_launch_argv(const char *first_arg, ...) {
+    const YtdlpLaunchSpec *spec = ytdlp_get_launch_spec();
+    GPtrArray *argv = g_ptr_array_new();
+    va_list ap;
+
+    for (int i = 0; spec->argv[i] != NULL; i++) {
+        g_ptr_array_add(argv, g_strdup(spec->argv[i]));
+    }
+
+    va_start(ap, first_arg);
+    for (const char *arg = first_arg; arg != NULL; arg = va_arg(ap, const char *)) {
+        g_ptr_array_add(argv, g_strdup(arg));
+    }
+    va_end(ap);
+
+    g_ptr_array_add(argv, NULL);
+    return (char **)g_ptr_array_free(argv, FALSE);
+}
+
+// Version info is cached for the whole session: spawning yt-dlp means a
+// Python interpreter startup, so it is only re-run after an update.
+static YtdlpInfo *cached_info = NULL;
+static GList *pending_info_tasks = NULL;
+
+static YtdlpInfo* ytdlp_info_copy(const YtdlpInfo *info) {
+    YtdlpInfo *copy = g_malloc0(sizeof(YtdlpInfo));
+    copy->version = g_strdup(info->version);
+    copy->path = g_strdup(info->path);
+    copy->is_installed = info->is_installed;
+    return copy;
 }
 
 void ytdlp_info_free(YtdlpInfo *info) {
@@ -36,28 +134,224 @@ void ytdlp_info_free(YtdlpInfo *info) {
     g_free(info);
 }
 
-// Update yt-dlp to latest version
-gboolean ytdlp_update(GError **error) {
-    char *cmd[] = {"yt-dlp", "-U", NULL};
-    int exit_status;
+void ytdlp_invalidate_info(void) {
+    g_clear_pointer(&cached_info, ytdlp_info_free);
+}
+
+// Complete every caller waiting on the in-flight version check
+static void ytdlp_info_resolve_pending(YtdlpInfo *info) {
+    GList *tasks = pending_info_tasks;
+    pending_info_tasks = NULL;
+
+    for (GList *l = tasks; l != NULL; l = l->next) {
+        GTask *task = l->data;
+        g_task_return_pointer(task, ytdlp_info_copy(info), (GDestroyNotify)ytdlp_info_free);
+        g_object_unref(task);
+    }
+    g_list_free(tasks);
+}
+
+static void on_version_communicated(GObject *source, GAsyncResult *result, gpointer user_data) {
+    GSubprocess *process = G_SUBPROCESS(source);
+    YtdlpInfo *info = user_data;
+    char *output = NULL;
+    GError *error = NULL;
+
+    if (g_subprocess_communicate_utf8_finish(process, result, &output, NULL, &error) &&
+        g_subprocess_get_successful(process) && output) {
+        info->version = g_strdup(g_strstrip(output));
+    } else if (error) {
+        g_warning("yt-dlp --version failed: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_free(output);
+    g_object_unref(process);
+
+    ytdlp_invalidate_info();
+    cached_info = info;
+    ytdlp_info_resolve_pending(info);
+}
+
+// Check if yt-dlp is installed and get its version without blocking
+void ytdlp_get_info_async(GCancellable *cancellable, GAsyncReadyCallback callback,
+                          gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+
+    if (cached_info) {
+        g_task_return_pointer(task, ytdlp_info_copy(cached_info), (GDestroyNotify)ytdlp_info_free);
+        g_object_unref(task);
+        return;
+    }
+
+    gboolean in_flight = pending_info_tasks != NULL;
+    pending_info_tasks = g_list_append(pending_info_tasks, task);
+    if (in_flight) return;
+
+    YtdlpInfo *info = g_malloc0(sizeof(YtdlpInfo));
+    const YtdlpLaunchSpec *spec = ytdlp_get_launch_spec();
+
+    info->path = g_strjoinv(" ", spec->argv);
+    if (!spec->resolved) {
+        // Not cached, so installing yt-dlp is picked up by the next check
+        info->is_installed = FALSE;
+        ytdlp_info_resolve_pending(info);
+        ytdlp_info_free(info);
+        return;
+    }
+    info->is_installed = TRUE;
+
+    // Get version
+    char **cmd = ytdlp_launch_argv("--version", NULL);
+    GError *error = NULL;
+    GSubprocess *process = g_subprocess_newv((const char * const *)cmd,
+                                             G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                             G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+                                             &error);
+    g_strfreev(cmd);
+    if (!process) {
+        g_warning("Failed to run %s: %s", info->path, error->message);
+        g_error_free(error);
+        ytdlp_info_resolve_pending(info);
+        ytdlp_info_free(info);
+        return;
+    }
+
+    // Not tied to the caller's cancellable: other callers may be waiting
+    g_subprocess_communicate_utf8_async(process, NULL, NULL, on_version_communicated, info);
+}
+
+YtdlpInfo* ytdlp_get_info_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+typedef struct {
+    GSubprocess *process;
+    GDataInputStream *output;
+    YtdlpOutputFunc output_func;
+    gpointer output_data;
+} YtdlpUpdateData;
+
+static void ytdlp_update_data_free(YtdlpUpdateData *data) {
+    g_clear_object(&data->output);
+    g_clear_object(&data->process);
+    g_free(data);
+}
+
+static void on_update_exited(GObject *source, GAsyncResult *result, gpointer user_data) {
+    GTask *task = user_data;
+    GError *error = NULL;
+
+    if (!g_subprocess_wait_finish(G_SUBPROCESS(source), result, &error)) {
+        g_task_return_error(task, error);
+    } else if (!g_subprocess_get_successful(G_SUBPROCESS(source))) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                "yt-dlp -U exited with status %d",
+                                g_subprocess_get_exit_status(G_SUBPROCESS(source)));
+    } else {
+        g_task_return_boolean(task, TRUE);
+    }
+
+    // Whatever happened, the installed version may have changed
+    ytdlp_invalidate_info();
+    g_object_unref(task);
+}
+
+static void on_update_line(GObject *source, GAsyncResult *result, gpointer user_data) {
+    GTask *task = user_data;
+    YtdlpUpdateData *data = g_task_get_task_data(task);
+    GError *error = NULL;
 
-    if (!g_spawn_sync(NULL, cmd, NULL, G_SPAWN_SEARCH_PATH,
-                     NULL, NULL, NULL, NULL, &exit_status, error)) {
-        return FALSE;
+    char *line = g_data_input_stream_read_line_finish_utf8(G_DATA_INPUT_STREAM(source),
+                                                           result, NULL, &error);
+    if (line) {
+        if (data->output_func && !g_cancellable_is_cancelled(g_task_get_cancellable(task))) {
+            data->output_func(line, data->output_data);
+        }
+        g_free(line);
+        g_data_input_stream_read_line_async(data->output, G_PRIORITY_DEFAULT, NULL,
+                                            on_update_line, task);
+        return;
     }
+    g_clear_error(&error);
 
-    return exit_status == 0;
+    // Output closed: wait for the exit status
+    g_subprocess_wait_async(data->process, NULL, on_update_exited, task);
+}
+
+// Update yt-dlp to the latest version, streaming its output line by line.
+// Cancelling only stops the output: killing the updater midway could leave
+// a broken install, so it always runs to completion.
+void ytdlp_update_async(YtdlpOutputFunc output_func, gpointer output_data,
+                        GCancellable *cancellable, GAsyncReadyCallback callback,
+                        gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    GError *error = NULL;
+
+    char **cmd = ytdlp_launch_argv("-U", NULL);
+    GSubprocess *process = g_subprocess_newv((const char * const *)cmd,
+                                             G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                             G_SUBPROCESS_FLAGS_STDERR_MERGE,
+                                             &error);
+    g_strfreev(cmd);
+    if (!process) {
+        g_task_return_error(task, error);
+        g_object_unref(task);
+        return;
+    }
+
+    YtdlpUpdateData *data = g_malloc0(sizeof(YtdlpUpdateData));
+    data->process = process;
+    data->output = g_data_input_stream_new(g_subprocess_get_stdout_pipe(process));
+    data->output_func = output_func;
+    data->output_data = output_data;
+    g_task_set_task_data(task, data, (GDestroyNotify)ytdlp_update_data_free);
+
+    // The pipe is drained to the end even after cancelling, or yt-dlp could
+    // block on it mid-update
+    g_data_input_stream_read_line_async(data->output, G_PRIORITY_DEFAULT, NULL,
+                                        on_update_line, task);
+}
+
+gboolean ytdlp_update_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_boolean(G_TASK(result), error);
 }
 
 // Build command line arguments from DownloadOptions
 char** ytdlp_build_args(const char *url, const char *output_path,
-                        DownloadOptions *opts, int *argc) {
+                        DownloadOptions *opts, const FormatPlan *plan, int *argc) {
     GPtrArray *args = g_ptr_array_new();
+    const YtdlpLaunchSpec *spec = ytdlp_get_launch_spec();
 
-    g_ptr_array_add(args, g_strdup("yt-dlp"));
+    for (int i = 0; spec->argv[i] != NULL; i++) {
+        g_ptr_array_add(args, g_strdup(spec->argv[i]));
+    }
 
     // Quality and format
-    if (opts->audio_only) {
+    if (plan) {
+        // Streams chosen from the format list, converted only if unavoidable
+        if (opts->audio_only) {
+            g_ptr_array_add(args, g_strdup("-x"));
+            if (plan->audio_format) {
+                g_ptr_array_add(args, g_strdup("--audio-format"));
+                g_ptr_array_add(args, g_strdup(plan->audio_format));
+            }
+        }
+        g_ptr_array_add(args, g_strdup("-f"));
+        g_ptr_array_add(args, g_strdup(plan->format));
+        if (plan->container) {
+            g_ptr_array_add(args, g_strdup("--merge-output-format"));
+            g_ptr_array_add(args, g_strdup(plan->container));
+        }
+        if (plan->recode_format) {
+            g_ptr_array_add(args, g_strdup("--recode-video"));
+            g_ptr_array_add(args, g_strdup(plan->recode_format));
+        }
+        if (plan->convert_args) {
+            g_ptr_array_add(args, g_strdup("--postprocessor-args"));
+            g_ptr_array_add(args, g_strdup(plan->convert_args));
+        }
+    } else if (opts->audio_only) {
         g_ptr_array_add(args, g_strdup("-x"));
 
         switch (opts->format) {
@@ -147,8 +441,18 @@ char** ytdlp_build_args(const char *url, const char *output_path,
         g_ptr_array_add(args, g_strdup_printf("%d", opts->max_downloads));
     }
 
+    // Clips: one section covering all of them, cut apart locally afterwards
+    int cover_start = 0, cover_end = -1;
+    gboolean clips = clip_cover(opts->clips, &cover_start, &cover_end);
+    char *cover_end_text = cover_end >= 0 ? g_strdup_printf("%d", cover_end) : g_strdup("inf");
+
     // Time range
-    if (opts->time_range_start && strlen(opts->time_range_start) > 0) {
+    if (clips) {
+        if (cover_start > 0 || cover_end >= 0) {
+            g_ptr_array_add(args, g_strdup("--download-sections"));
+            g_ptr_array_add(args, g_strdup_printf("*%d-%s", cover_start, cover_end_text));
+        }
+    } else if (opts->time_range_start && strlen(opts->time_range_start) > 0) {
         g_ptr_array_add(args, g_strdup("--download-sections"));
         char *range = g_strdup_printf("*%s-%s",
                                      opts->time_range_start,
@@ -156,17 +460,47 @@ char** ytdlp_build_args(const char *url, const char *output_path,
         g_ptr_array_add(args, range);
     }
 
+    // Rate limit and network retries
+    if (opts->rate_limit > 0) {
+        g_ptr_array_add(args, g_strdup("--limit-rate"));
+        g_ptr_array_add(args, g_strdup_printf("%" G_GINT64_FORMAT, opts->rate_limit));
+    }
+    g_ptr_array_add(args, g_strdup("--retries"));
+    g_ptr_array_add(args, g_strdup_printf("%d", config_get()->ytdlp_retries));
+
+    // Pick up .part files left by a paused or killed run
+    g_ptr_array_add(args, g_strdup("--continue"));
+
+    // Fragment parallelism and transfer sizes
+    if (opts->concurrent_fragments > 1) {
+        g_ptr_array_add(args, g_strdup("--concurrent-fragments"));
+        g_ptr_array_add(args, g_strdup_printf("%d", opts->concurrent_fragments));
+    }
+    if (opts->http_chunk_size > 0) {
+        g_ptr_array_add(args, g_strdup("--http-chunk-size"));
+        g_ptr_array_add(args, g_strdup_printf("%" G_GINT64_FORMAT, opts->http_chunk_size));
+    }
+    if (opts->buffer_size > 0) {
+        g_ptr_array_add(args, g_strdup("--buffer-size"));
+        g_ptr_array_add(args, g_strdup_printf("%" G_GINT64_FORMAT, opts->buffer_size));
+    }
+
     // Progress output
     g_ptr_array_add(args, g_strdup("--newline"));
     g_ptr_array_add(args, g_strdup("--progress"));
 
     // Output path
     g_ptr_array_add(args, g_strdup("-o"));
-    if (opts->output_template) {
+    if (clips) {
+        // Named after the span, so a rerun with the same clips reuses it
+        g_ptr_array_add(args, g_strdup_printf("%s/%%(title)s.source-%d-%s.%%(ext)s",
+                                              output_path, cover_start, cover_end_text));
+    } else if (opts->output_template) {
         g_ptr_array_add(args, g_strdup_printf("%s/%s", output_path, opts->output_template));
     } else {
         g_ptr_array_add(args, g_strdup_printf("%s/%%(title)s.%%(ext)s", output_path));
     }
+    g_free(cover_end_text);
 
     // URL (must be last)
     g_ptr_array_add(args, g_strdup(url));
@@ -2,12 +2,36 @@
 #define YTDLP_MANAGER_H
 
 #include "common.h"
+#include "format_planner.h"
+#include <gio/gio.h>
 
-YtdlpInfo* ytdlp_get_info(void);
+typedef void (*YtdlpOutputFunc)(const char *line, gpointer user_data);
+
+// Resolved command prefix shared by every yt-dlp invocation, e.g.
+// {"/usr/bin/python3", "-I", "-m", "yt_dlp", NULL}. Main thread only; the
+// pointer is invalidated when the configuration changes.
+typedef struct {
+    char **argv;
+    gboolean resolved;      // The executables were found
+} YtdlpLaunchSpec;
+
+const YtdlpLaunchSpec* ytdlp_get_launch_spec(void);
+char** ytdlp_launch_argv(const char *first_arg, ...) G_GNUC_NULL_TERMINATED;
+
+void ytdlp_get_info_async(GCancellable *cancellable, GAsyncReadyCallback callback,
+                          gpointer user_data);
+YtdlpInfo* ytdlp_get_info_finish(GAsyncResult *result, GError **error);
+void ytdlp_invalidate_info(void);
 void ytdlp_info_free(YtdlpInfo *info);
-gboolean ytdlp_update(GError **error);
+
+void ytdlp_update_async(YtdlpOutputFunc output_func, gpointer output_data,
+                        GCancellable *cancellable, GAsyncReadyCallback callback,
+                        gpointer user_data);
+gboolean ytdlp_update_finish(GAsyncResult *result, GError **error);
+
+// plan, when given, replaces the selection derived from the quality and format
 char** ytdlp_build_args(const char *url, const char *output_path,
-                        DownloadOptions *opts, int *argc);
+                        DownloadOptions *opts, const FormatPlan *plan, int *argc);
 void ytdlp_free_args(char **args);
 
 #endif
@@ -1,8 +1,50 @@
 #include "common.h"
 #include "ui/main_window.h"
+#include "core/aria2_backend.h"
+#include "core/control_server.h"
+#include "core/http_backend.h"
+#include "core/metadata_fetcher.h"
+#include "core/process_manager.h"
+#include "core/quick_preview.h"
+#include "core/resource_control.h"
+#include "core/work_pool.h"
+#include "core/ytdlp_manager.h"
+#include "utils/config.h"
+
+static void on_startup_version_checked(GObject *source, GAsyncResult *result,
+                                       gpointer user_data) {
+    (void)source;
+    (void)user_data;
+    YtdlpInfo *info = ytdlp_get_info_finish(result, NULL);
+
+    if (info && info->is_installed) {
+        g_print("yt-dlp %s at %s\n", info->version ? info->version : "(unknown version)",
+                info->path);
+    } else {
+        g_warning("yt-dlp is not installed");
+    }
+    ytdlp_info_free(info);
+}
 
 static void on_activate(GtkApplication *app, gpointer user_data) {
     (void)user_data;
+
+    config_monitor_start();
+    download_engine_register_backend(&http_backend);
+    download_engine_register_backend(&aria2_backend);
+    process_manager_init();
+
+    GError *error = NULL;
+    if (!control_server_start(&error)) {
+        g_warning("Control socket unavailable: %s", error->message);
+        g_error_free(error);
+    }
+
+    // Warm the version cache in the background so Settings opens instantly
+    if (config_get()->auto_check_updates) {
+        ytdlp_get_info_async(NULL, on_startup_version_checked, NULL);
+    }
+
     GtkWidget *window = main_window_new(app);
     gtk_window_present(GTK_WINDOW(window));
 }
@@ -17,5 +59,14 @@ int main(int argc, char *argv[]) {
     status = g_application_run(G_APPLICATION(app), argc, argv);
     g_object_unref(app);
 
+    control_server_stop();
+    process_manager_cleanup();
+    aria2_backend_cleanup();
+    quick_preview_cleanup();
+    work_pool_cleanup();
+    metadata_prefetch_cleanup();
+    resource_control_cleanup();
+    config_cleanup();
+
     return status;
 }
@@ -1,17 +1,23 @@
 #include "download_item_widget.h"
+#include "../core/process_manager.h"
 
 typedef struct {
     DownloadItem *item;
     GtkWidget *thumbnail;
+    GdkPixbuf *shown_thumbnail; // Compared only, the metadata holds the reference
     GtkWidget *title_label;
     GtkWidget *progress_bar;
     GtkWidget *status_label;
     GtkWidget *speed_label;
+    GtkWidget *pause_button;
     GtkWidget *cancel_button;
     guint update_timer;
+    const char *status_class;   // CSS class currently applied to the status label
 } DownloadItemWidgetData;
 
 static gboolean update_progress(gpointer user_data);
+static void update_thumbnail(DownloadItemWidgetData *data);
+static void on_pause_clicked(GtkButton *button, gpointer user_data);
 static void on_cancel_clicked(GtkButton *button, gpointer user_data);
 
 GtkWidget* download_item_widget_new(DownloadItem *item) {
@@ -33,20 +39,9 @@ GtkWidget* download_item_widget_new(DownloadItem *item) {
     data->thumbnail = gtk_image_new();
     gtk_widget_set_size_request(data->thumbnail, 120, 90);
 
-    if (item->metadata && item->metadata->thumbnail_pixbuf) {
-        GdkPixbuf *scaled = gdk_pixbuf_scale_simple(
-            item->metadata->thumbnail_pixbuf,
-            120, 90,
-            GDK_INTERP_BILINEAR
-        );
-        GdkTexture *texture = gdk_texture_new_for_pixbuf(scaled);
-        gtk_image_set_from_paintable(GTK_IMAGE(data->thumbnail), GDK_PAINTABLE(texture));
-        g_object_unref(scaled);
-        g_object_unref(texture);
-    } else {
-        gtk_image_set_from_icon_name(GTK_IMAGE(data->thumbnail), "video-x-generic");
-        gtk_image_set_icon_size(GTK_IMAGE(data->thumbnail), GTK_ICON_SIZE_LARGE);
-    }
+    gtk_image_set_from_icon_name(GTK_IMAGE(data->thumbnail), "video-x-generic");
+    gtk_image_set_icon_size(GTK_IMAGE(data->thumbnail), GTK_ICON_SIZE_LARGE);
+    update_thumbnail(data);
 
     gtk_box_append(GTK_BOX(main_box), data->thumbnail);
 
@@ -120,6 +115,13 @@ GtkWidget* download_item_widget_new(DownloadItem *item) {
 
     gtk_box_append(GTK_BOX(content_box), status_box);
 
+    // Pause/resume button
+    data->pause_button = gtk_button_new_from_icon_name("media-playback-pause");
+    gtk_widget_set_valign(data->pause_button, GTK_ALIGN_CENTER);
+    gtk_widget_set_tooltip_text(data->pause_button, "Pause Download");
+    g_signal_connect(data->pause_button, "clicked", G_CALLBACK(on_pause_clicked), data);
+    gtk_box_append(GTK_BOX(main_box), data->pause_button);
+
     // Cancel button
     data->cancel_button = gtk_button_new_from_icon_name("process-stop");
     gtk_widget_set_valign(data->cancel_button, GTK_ALIGN_CENTER);
@@ -135,6 +137,23 @@ GtkWidget* download_item_widget_new(DownloadItem *item) {
     return list_row;
 }
 
+// Thumbnails of queued items arrive later from the background prefetch
+static void update_thumbnail(DownloadItemWidgetData *data) {
+    VideoMetadata *meta = data->item->metadata;
+    if (!meta || !meta->thumbnail_pixbuf || meta->thumbnail_pixbuf == data->shown_thumbnail) {
+        return;
+    }
+
+    GdkPixbuf *scaled = gdk_pixbuf_scale_simple(meta->thumbnail_pixbuf, 120, 90,
+                                                GDK_INTERP_BILINEAR);
+    GdkTexture *texture = gdk_texture_new_for_pixbuf(scaled);
+    gtk_image_set_from_paintable(GTK_IMAGE(data->thumbnail), GDK_PAINTABLE(texture));
+    g_object_unref(scaled);
+    g_object_unref(texture);
+
+    data->shown_thumbnail = meta->thumbnail_pixbuf;
+}
+
 static gboolean update_progress(gpointer user_data) {
     DownloadItemWidgetData *data = (DownloadItemWidgetData *)user_data;
     DownloadItem *item = data->item;
@@ -144,13 +163,20 @@ static gboolean update_progress(gpointer user_data) {
         return FALSE;
     }
 
-    // Update progress bar
-    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(data->progress_bar),
-                                  item->progress / 100.0);
+    update_thumbnail(data);
+
+    // Update progress bar; post-processing has no measurable progress
+    if (item->status == DOWNLOAD_STATUS_PROCESSING) {
+        gtk_progress_bar_pulse(GTK_PROGRESS_BAR(data->progress_bar));
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(data->progress_bar), "Processing");
+    } else {
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(data->progress_bar),
+                                      item->progress / 100.0);
 
-    char *progress_text = g_strdup_printf("%.1f%%", item->progress);
-    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(data->progress_bar), progress_text);
-    g_free(progress_text);
+        char *progress_text = g_strdup_printf("%.1f%%", item->progress);
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(data->progress_bar), progress_text);
+        g_free(progress_text);
+    }
 
     // Update status
     const char *status_text = NULL;
@@ -173,6 +199,9 @@ static gboolean update_progress(gpointer user_data) {
         case DOWNLOAD_STATUS_PROCESSING:
             status_text = "Processing...";
             break;
+        case DOWNLOAD_STATUS_PAUSED:
+            status_text = item->pause_requested ? "Pausing..." : "Paused";
+            break;
         case DOWNLOAD_STATUS_COMPLETED:
             status_text = "✓ Completed";
             status_class = "success";
@@ -196,7 +225,33 @@ static gboolean update_progress(gpointer user_data) {
             break;
     }
 
-    gtk_label_set_text(GTK_LABEL(data->status_label), status_text);
+    if (g_strcmp0(status_class, data->status_class) != 0) {
+        if (data->status_class) {
+            gtk_widget_remove_css_class(data->status_label, data->status_class);
+        }
+        if (status_class) {
+            gtk_widget_add_css_class(data->status_label, status_class);
+        }
+        data->status_class = status_class;
+    }
+
+    if (item->cancel_requested) {
+        gtk_label_set_text(GTK_LABEL(data->status_label), "Cancelling...");
+    } else if (item->status == DOWNLOAD_STATUS_QUEUED && item->wait_reason) {
+        char *queued_text = g_strdup_printf("Queued (%s)", item->wait_reason);
+        gtk_label_set_text(GTK_LABEL(data->status_label), queued_text);
+        g_free(queued_text);
+    } else if (item->status == DOWNLOAD_STATUS_PROCESSING) {
+        // Post-processing runs locally: show the step instead of a speed
+        char *processing_text = g_strdup_printf("Processing: %s%s%s",
+                                                item->processing_step ? item->processing_step : "ffmpeg",
+                                                item->wait_reason ? " — " : "",
+                                                item->wait_reason ? item->wait_reason : "");
+        gtk_label_set_text(GTK_LABEL(data->status_label), processing_text);
+        g_free(processing_text);
+    } else {
+        gtk_label_set_text(GTK_LABEL(data->status_label), status_text);
+    }
 
     // Update speed and ETA
     if (item->status == DOWNLOAD_STATUS_DOWNLOADING) {
@@ -221,10 +276,18 @@ static gboolean update_progress(gpointer user_data) {
         gtk_label_set_text(GTK_LABEL(data->speed_label), "");
     }
 
+    // Pause/resume button
+    gboolean paused = item->status == DOWNLOAD_STATUS_PAUSED;
+    gtk_button_set_icon_name(GTK_BUTTON(data->pause_button),
+                             paused ? "media-playback-start" : "media-playback-pause");
+    gtk_widget_set_tooltip_text(data->pause_button, paused ? "Resume Download" : "Pause Download");
+    gtk_widget_set_sensitive(data->pause_button, !item->cancel_requested && !item->pause_requested);
+
     // Stop timer if download is finished
     if (item->status == DOWNLOAD_STATUS_COMPLETED ||
         item->status == DOWNLOAD_STATUS_FAILED ||
         item->status == DOWNLOAD_STATUS_CANCELLED) {
+        gtk_widget_set_visible(data->pause_button, FALSE);
         data->update_timer = 0;
         return FALSE;
     }
@@ -232,12 +295,25 @@ static gboolean update_progress(gpointer user_data) {
     return TRUE;
 }
 
+static void on_pause_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    DownloadItemWidgetData *data = (DownloadItemWidgetData *)user_data;
+
+    if (!data->item) return;
+
+    if (data->item->status == DOWNLOAD_STATUS_PAUSED) {
+        process_manager_resume(data->item);
+    } else {
+        process_manager_pause(data->item);
+    }
+}
+
 static void on_cancel_clicked(GtkButton *button, gpointer user_data) {
     (void)button;
     DownloadItemWidgetData *data = (DownloadItemWidgetData *)user_data;
 
     if (data->item) {
-        download_item_cancel(data->item);
+        download_item_cancel(data->item, TRUE);
         gtk_widget_set_sensitive(data->cancel_button, FALSE);
     }
 }
@@ -1,4 +1,8 @@
 #include "download_options.h"
+#include "../core/clip_cutter.h"
+#include "../core/format_planner.h"
+#include "../core/metadata_fetcher.h"
+#include "../utils/config.h"
 
 typedef struct {
     GtkWidget *quality_combo;
@@ -9,9 +13,38 @@ typedef struct {
     GtkWidget *playlist_check;
     GtkWidget *time_start_entry;
     GtkWidget *time_end_entry;
+    GtkWidget *clips_entry;
     GtkWidget *custom_format_entry;
+    GtkWidget *fragments_spin;
+    GtkWidget *priority_combo;
+    GtkWidget *plan_label;
+    GList *formats;             // FormatInfo* of the entered URL, for the plan
 } DownloadOptionsWidgets;
 
+static void download_options_widgets_free(DownloadOptionsWidgets *widgets) {
+    g_list_free_full(widgets->formats, (GDestroyNotify)format_info_free);
+    g_free(widgets);
+}
+
+// Tell up front whether the chosen output is a stream copy or a re-encode
+static void update_plan_label(DownloadOptionsWidgets *widgets) {
+    DownloadOptions opts = {
+        .quality = gtk_combo_box_get_active(GTK_COMBO_BOX(widgets->quality_combo)),
+        .format = gtk_combo_box_get_active(GTK_COMBO_BOX(widgets->format_combo)),
+        .audio_only = gtk_check_button_get_active(GTK_CHECK_BUTTON(widgets->audio_only_check)),
+    };
+    FormatPlan *plan = format_planner_plan(widgets->formats, &opts);
+
+    gtk_label_set_text(GTK_LABEL(widgets->plan_label), plan ? plan->summary : "");
+    gtk_widget_set_visible(widgets->plan_label, plan != NULL);
+    format_plan_free(plan);
+}
+
+static void on_plan_input_changed(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    update_plan_label(user_data);
+}
+
 GtkWidget* download_options_panel_new(void) {
     GtkWidget *frame = gtk_frame_new("Download Options");
     gtk_widget_set_margin_top(frame, 6);
@@ -27,6 +60,7 @@ GtkWidget* download_options_panel_new(void) {
     gtk_frame_set_child(GTK_FRAME(frame), grid);
 
     DownloadOptionsWidgets *widgets = g_malloc0(sizeof(DownloadOptionsWidgets));
+    DownloadOptions *defaults = &config_get()->default_options;
     int row = 0;
 
     // Quality selector (initially shows placeholder)
@@ -54,7 +88,7 @@ GtkWidget* download_options_panel_new(void) {
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(widgets->format_combo), "MP3");
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(widgets->format_combo), "M4A");
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(widgets->format_combo), "Opus");
-    gtk_combo_box_set_active(GTK_COMBO_BOX(widgets->format_combo), 0);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(widgets->format_combo), defaults->format);
     gtk_widget_set_hexpand(widgets->format_combo, TRUE);
     gtk_grid_attach(GTK_GRID(grid), widgets->format_combo, 1, row++, 1, 1);
 
@@ -90,21 +124,73 @@ GtkWidget* download_options_panel_new(void) {
 
     gtk_grid_attach(GTK_GRID(grid), time_box, 1, row++, 1, 1);
 
+    // Clips, all cut from one download
+    label = gtk_label_new("Clips:");
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID(grid), label, 0, row, 1, 1);
+
+    widgets->clips_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(widgets->clips_entry), "e.g. 10:00-11:30, 1:02:00-1:03:15");
+    gtk_widget_set_tooltip_text(widgets->clips_entry,
+                                "Downloads the part covering all clips once, then cuts each clip from it");
+    gtk_widget_set_hexpand(widgets->clips_entry, TRUE);
+    gtk_grid_attach(GTK_GRID(grid), widgets->clips_entry, 1, row++, 1, 1);
+
+    // Parallel fragments (0 lets the scheduler decide)
+    label = gtk_label_new("Parallel Fragments:");
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID(grid), label, 0, row, 1, 1);
+
+    widgets->fragments_spin = gtk_spin_button_new_with_range(0, 64, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(widgets->fragments_spin),
+                              defaults->concurrent_fragments);
+    gtk_widget_set_tooltip_text(widgets->fragments_spin,
+                                "0 = automatic, based on how many downloads are running");
+    gtk_grid_attach(GTK_GRID(grid), widgets->fragments_spin, 1, row++, 1, 1);
+
+    // Priority class (ordering under the "priority" queue policy)
+    label = gtk_label_new("Priority:");
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID(grid), label, 0, row, 1, 1);
+
+    widgets->priority_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(widgets->priority_combo), "Normal");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(widgets->priority_combo), "High");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(widgets->priority_combo), "Low");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(widgets->priority_combo), defaults->priority);
+    gtk_grid_attach(GTK_GRID(grid), widgets->priority_combo, 1, row++, 1, 1);
+
     // Checkboxes
     widgets->audio_only_check = gtk_check_button_new_with_label("Audio Only");
+    gtk_check_button_set_active(GTK_CHECK_BUTTON(widgets->audio_only_check), defaults->audio_only);
     gtk_grid_attach(GTK_GRID(grid), widgets->audio_only_check, 0, row++, 2, 1);
 
     widgets->subtitles_check = gtk_check_button_new_with_label("Download Subtitles");
+    gtk_check_button_set_active(GTK_CHECK_BUTTON(widgets->subtitles_check), defaults->subtitles);
     gtk_grid_attach(GTK_GRID(grid), widgets->subtitles_check, 0, row++, 2, 1);
 
     widgets->thumbnail_check = gtk_check_button_new_with_label("Embed Thumbnail");
-    gtk_check_button_set_active(GTK_CHECK_BUTTON(widgets->thumbnail_check), TRUE);
+    gtk_check_button_set_active(GTK_CHECK_BUTTON(widgets->thumbnail_check), defaults->embed_thumbnail);
     gtk_grid_attach(GTK_GRID(grid), widgets->thumbnail_check, 0, row++, 2, 1);
 
     widgets->playlist_check = gtk_check_button_new_with_label("Download Full Playlist");
+    gtk_check_button_set_active(GTK_CHECK_BUTTON(widgets->playlist_check), defaults->playlist);
     gtk_grid_attach(GTK_GRID(grid), widgets->playlist_check, 0, row++, 2, 1);
 
-    g_object_set_data_full(G_OBJECT(frame), "options-widgets", widgets, g_free);
+    // Stream copy or re-encode, once the formats are known
+    widgets->plan_label = gtk_label_new(NULL);
+    gtk_widget_set_halign(widgets->plan_label, GTK_ALIGN_START);
+    gtk_label_set_wrap(GTK_LABEL(widgets->plan_label), TRUE);
+    gtk_widget_add_css_class(widgets->plan_label, "dim-label");
+    gtk_widget_set_visible(widgets->plan_label, FALSE);
+    gtk_grid_attach(GTK_GRID(grid), widgets->plan_label, 0, row++, 2, 1);
+
+    g_signal_connect(widgets->quality_combo, "changed", G_CALLBACK(on_plan_input_changed), widgets);
+    g_signal_connect(widgets->format_combo, "changed", G_CALLBACK(on_plan_input_changed), widgets);
+    g_signal_connect(widgets->audio_only_check, "toggled", G_CALLBACK(on_plan_input_changed), widgets);
+
+    g_object_set_data_full(G_OBJECT(frame), "options-widgets", widgets,
+                           (GDestroyNotify)download_options_widgets_free);
 
     return frame;
 }
@@ -115,6 +201,12 @@ void download_options_update_from_metadata(GtkWidget *panel, VideoMetadata *meta
     DownloadOptionsWidgets *widgets = g_object_get_data(G_OBJECT(panel), "options-widgets");
     if (!widgets) return;
 
+    g_list_free_full(widgets->formats, (GDestroyNotify)format_info_free);
+    widgets->formats = NULL;
+    for (GList *l = meta->formats; l != NULL; l = l->next) {
+        widgets->formats = g_list_prepend(widgets->formats, format_info_copy(l->data));
+    }
+
     // Clear existing items
     gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(widgets->quality_combo));
 
@@ -125,8 +217,12 @@ void download_options_update_from_metadata(GtkWidget *panel, VideoMetadata *meta
                                            meta->available_qualities[i]);
         }
 
-        // Select "Best Quality" by default
-        gtk_combo_box_set_active(GTK_COMBO_BOX(widgets->quality_combo), 0);
+        // Select the configured default quality, "Best Quality" otherwise
+        int default_quality = config_get()->default_options.quality;
+        if (default_quality >= (int)g_strv_length(meta->available_qualities)) {
+            default_quality = 0;
+        }
+        gtk_combo_box_set_active(GTK_COMBO_BOX(widgets->quality_combo), default_quality);
         gtk_widget_set_sensitive(widgets->quality_combo, TRUE);
 
         g_print("Updated quality options from metadata (%d options)\n",
@@ -144,6 +240,9 @@ void download_options_reset(GtkWidget *panel) {
     DownloadOptionsWidgets *widgets = g_object_get_data(G_OBJECT(panel), "options-widgets");
     if (!widgets) return;
 
+    g_list_free_full(widgets->formats, (GDestroyNotify)format_info_free);
+    widgets->formats = NULL;
+
     // Reset to placeholder state
     gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(widgets->quality_combo));
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(widgets->quality_combo),
@@ -157,6 +256,7 @@ DownloadOptions* download_options_get(GtkWidget *panel) {
     if (!widgets) return NULL;
 
     DownloadOptions *opts = g_malloc0(sizeof(DownloadOptions));
+    AppConfig *config = config_get();
 
     // Quality
     int quality_idx = gtk_combo_box_get_active(GTK_COMBO_BOX(widgets->quality_combo));
@@ -182,6 +282,24 @@ DownloadOptions* download_options_get(GtkWidget *panel) {
         opts->time_range_end = g_strdup(end);
     }
 
+    // Clips, ranges that don't parse are dropped
+    char **ranges = g_strsplit_set(gtk_editable_get_text(GTK_EDITABLE(widgets->clips_entry)), ",;", -1);
+    GPtrArray *clips = g_ptr_array_new();
+    for (int i = 0; ranges[i] != NULL; i++) {
+        int clip_start, clip_end;
+        char *range = g_strstrip(ranges[i]);
+        if (*range && clip_parse_range(range, &clip_start, &clip_end)) {
+            g_ptr_array_add(clips, g_strdup(range));
+        }
+    }
+    g_strfreev(ranges);
+    if (clips->len > 0) {
+        g_ptr_array_add(clips, NULL);
+        opts->clips = (char **)g_ptr_array_free(clips, FALSE);
+    } else {
+        g_ptr_array_free(clips, TRUE);
+    }
+
     // Custom format
     if (opts->quality == QUALITY_CUSTOM) {
         const char *custom = gtk_editable_get_text(GTK_EDITABLE(widgets->custom_format_entry));
@@ -190,5 +308,15 @@ DownloadOptions* download_options_get(GtkWidget *panel) {
         }
     }
 
+    opts->concurrent_fragments =
+        gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(widgets->fragments_spin));
+    opts->priority = (DownloadPriority)gtk_combo_box_get_active(GTK_COMBO_BOX(widgets->priority_combo));
+
+    // Settings that are only configured globally
+    opts->output_template = g_strdup(config->default_options.output_template);
+    opts->rate_limit = (int64_t)config->rate_limit_kib * 1024;
+    opts->http_chunk_size = (int64_t)config->http_chunk_size_kib * 1024;
+    opts->buffer_size = (int64_t)config->buffer_size_kib * 1024;
+
     return opts;
 }
@@ -2,8 +2,12 @@
 #include "download_options.h"
 #include "download_item_widget.h"
 #include "settings_panel.h"
+#include "stats_window.h"
 #include "../core/download_engine.h"
 #include "../core/metadata_fetcher.h"
+#include "../core/process_manager.h"
+#include "../core/quick_preview.h"
+#include "../utils/config.h"
 #include "../utils/string_utils.h"
 
 typedef struct {
@@ -16,6 +20,10 @@ typedef struct {
     GtkWidget *preview_thumbnail;
     GtkWidget *preview_title;
     GtkWidget *preview_info;
+    GtkWidget *window;
+    gboolean destroyed;         // Window closed; lookups still running ignore it
+    char *preview_url;          // URL the preview is being filled for
+    gboolean preview_complete;  // Full metadata arrived, quick results are stale
     GList *active_downloads;
 } MainWindowData;
 
@@ -23,14 +31,69 @@ static void on_folder_selected(GObject *source, GAsyncResult *result, gpointer u
 static void on_browse_clicked(GtkButton *button, gpointer user_data);
 static void on_download_clicked(GtkButton *button, gpointer user_data);
 static void on_settings_clicked(GtkButton *button, gpointer user_data);
+static void on_stats_clicked(GtkButton *button, gpointer user_data);
 static void on_url_changed(GtkEditable *editable, gpointer user_data);
 static void on_metadata_fetched(VideoMetadata *meta, gpointer user_data);
+static void on_quick_preview(const char *url, VideoMetadata *meta, gpointer user_data);
+static void on_thumbnail_fetched(const char *url, GdkPixbuf *pixbuf, gpointer user_data);
+
+static guint url_timeout_id = 0;
+
+static void main_window_data_free(MainWindowData *data) {
+    g_free(data->preview_url);
+    g_free(data);
+}
+
+static void on_window_destroy(GtkWidget *window, gpointer user_data) {
+    (void)window;
+    MainWindowData *data = user_data;
+
+    data->destroyed = TRUE;
+    if (url_timeout_id > 0) {
+        g_source_remove(url_timeout_id);
+        url_timeout_id = 0;
+    }
+}
+
+// Lookups may answer after the window is gone or previews another URL:
+// their callbacks get a weak reference to the window and the URL they were
+// started for instead of the window data
+typedef struct {
+    GWeakRef window;
+    char *preview_url;
+} WindowRef;
+
+static WindowRef *window_ref_new(MainWindowData *data) {
+    WindowRef *ref = g_new0(WindowRef, 1);
+    g_weak_ref_init(&ref->window, data->window);
+    ref->preview_url = g_strdup(data->preview_url);
+    return ref;
+}
+
+// The window data, or NULL once the window is destroyed or the URL it was
+// taken for is no longer previewed. Frees ref.
+static MainWindowData *window_ref_take(WindowRef *ref) {
+    GObject *window = g_weak_ref_get(&ref->window);
+    g_weak_ref_clear(&ref->window);
+
+    MainWindowData *data = window ? g_object_get_data(window, "window-data") : NULL;
+    if (data && (data->destroyed || !data->preview_url ||
+                 g_strcmp0(ref->preview_url, data->preview_url) != 0)) {
+        data = NULL;
+    }
+
+    if (window) g_object_unref(window);
+    g_free(ref->preview_url);
+    g_free(ref);
+    return data;
+}
 
 GtkWidget* main_window_new(GtkApplication *app) {
     MainWindowData *data = g_malloc0(sizeof(MainWindowData));
 
     // Create main window
     GtkWidget *window = gtk_application_window_new(app);
+    data->window = window;
     gtk_window_set_title(GTK_WINDOW(window), APP_NAME);
     gtk_window_set_default_size(GTK_WINDOW(window), 1000, 700);
 
@@ -44,6 +107,11 @@ GtkWidget* main_window_new(GtkApplication *app) {
     g_signal_connect(settings_button, "clicked", G_CALLBACK(on_settings_clicked), window);
     gtk_header_bar_pack_end(GTK_HEADER_BAR(header_bar), settings_button);
 
+    GtkWidget *stats_button = gtk_button_new_from_icon_name("utilities-system-monitor");
+    gtk_widget_set_tooltip_text(stats_button, "Statistics");
+    g_signal_connect(stats_button, "clicked", G_CALLBACK(on_stats_clicked), window);
+    gtk_header_bar_pack_end(GTK_HEADER_BAR(header_bar), stats_button);
+
     // Main container
     GtkWidget *paned = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
     gtk_window_set_child(GTK_WINDOW(window), paned);
@@ -106,7 +174,7 @@ GtkWidget* main_window_new(GtkApplication *app) {
     gtk_frame_set_child(GTK_FRAME(path_frame), path_box);
 
     data->path_entry = gtk_entry_new();
-    gtk_editable_set_text(GTK_EDITABLE(data->path_entry), g_get_home_dir());
+    gtk_editable_set_text(GTK_EDITABLE(data->path_entry), config_get()->default_download_path);
     gtk_widget_set_hexpand(data->path_entry, TRUE);
     gtk_box_append(GTK_BOX(path_box), data->path_entry);
 
@@ -157,7 +225,9 @@ GtkWidget* main_window_new(GtkApplication *app) {
     gtk_box_append(GTK_BOX(right_box), scrolled);
 
     // Store data
-    g_object_set_data_full(G_OBJECT(window), "window-data", data, g_free);
+    g_object_set_data_full(G_OBJECT(window), "window-data", data,
+                           (GDestroyNotify)main_window_data_free);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_window_destroy), data);
 
     return window;
 }
@@ -210,32 +280,25 @@ static void on_download_clicked(GtkButton *button, gpointer user_data) {
     // Create download item
     DownloadItem *item = download_item_new(url, path, opts);
 
-    // Copy metadata if already fetched
+    // Copy metadata if already fetched; a quick preview alone has no formats
+    // or size, leave the item to the prefetch instead
     VideoMetadata *preview_meta = g_object_get_data(G_OBJECT(data->preview_box), "metadata");
-    if (preview_meta) {
-        item->metadata = g_malloc0(sizeof(VideoMetadata));
-        if (preview_meta->title) item->metadata->title = g_strdup(preview_meta->title);
-        if (preview_meta->uploader) item->metadata->uploader = g_strdup(preview_meta->uploader);
-        if (preview_meta->duration) item->metadata->duration = g_strdup(preview_meta->duration);
-        if (preview_meta->thumbnail_url) item->metadata->thumbnail_url = g_strdup(preview_meta->thumbnail_url);
-        item->metadata->filesize = preview_meta->filesize;
-        if (preview_meta->thumbnail_pixbuf) {
-            item->metadata->thumbnail_pixbuf = g_object_ref(preview_meta->thumbnail_pixbuf);
-        }
+    if (preview_meta && data->preview_complete && g_strcmp0(url, data->preview_url) == 0) {
+        item->metadata = metadata_copy(preview_meta);
     }
 
-    // Start download
-    if (download_item_start(item)) {
-        // Add to downloads list
-        GtkWidget *download_widget = download_item_widget_new(item);
-        gtk_list_box_append(GTK_LIST_BOX(data->download_list), download_widget);
+    // Hand over to the scheduler, which starts it when a slot is free
+    process_manager_add(item);
 
-        data->active_downloads = g_list_append(data->active_downloads, item);
+    // Add to downloads list
+    GtkWidget *download_widget = download_item_widget_new(item);
+    gtk_list_box_append(GTK_LIST_BOX(data->download_list), download_widget);
 
-        // Clear URL
-        gtk_editable_set_text(GTK_EDITABLE(data->url_entry), "");
-        gtk_widget_set_visible(data->preview_box, FALSE);
-    }
+    data->active_downloads = g_list_append(data->active_downloads, item);
+
+    // Clear URL
+    gtk_editable_set_text(GTK_EDITABLE(data->url_entry), "");
+    gtk_widget_set_visible(data->preview_box, FALSE);
 }
 
 static void on_settings_clicked(GtkButton *button, gpointer user_data) {
@@ -244,7 +307,10 @@ static void on_settings_clicked(GtkButton *button, gpointer user_data) {
     settings_panel_show(window);
 }
 
-static guint url_timeout_id = 0;
+static void on_stats_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    stats_window_show(GTK_WINDOW(user_data));
+}
 
 static gboolean fetch_metadata_timeout(gpointer user_data) {
     MainWindowData *data = (MainWindowData *)user_data;
@@ -253,8 +319,15 @@ static gboolean fetch_metadata_timeout(gpointer user_data) {
     if (string_is_valid_url(url)) {
         gtk_widget_set_visible(data->preview_box, TRUE);
         gtk_label_set_text(GTK_LABEL(data->preview_title), "Fetching video info...");
+        gtk_label_set_text(GTK_LABEL(data->preview_info), "");
 
-        metadata_fetch_async(url, on_metadata_fetched, data);
+        g_free(data->preview_url);
+        data->preview_url = g_strdup(url);
+        data->preview_complete = FALSE;
+
+        // Both phases start at once; whichever answers first fills the preview
+        quick_preview_fetch_async(url, on_quick_preview, window_ref_new(data));
+        metadata_fetch_async(url, on_metadata_fetched, window_ref_new(data));
     }
 
     url_timeout_id = 0;
@@ -269,7 +342,10 @@ static void on_url_changed(GtkEditable *editable, gpointer user_data) {
         g_source_remove(url_timeout_id);
     }
 
-    // Reset preview and options when URL changes
+    // Reset preview and options when URL changes; lookups still running for
+    // the old one are dropped when they answer
+    g_clear_pointer(&data->preview_url, g_free);
+    data->preview_complete = FALSE;
     if (GTK_IS_WIDGET(data->preview_box)) {
         gtk_widget_set_visible(data->preview_box, FALSE);
     }
@@ -278,8 +354,34 @@ static void on_url_changed(GtkEditable *editable, gpointer user_data) {
     url_timeout_id = g_timeout_add(1000, fetch_metadata_timeout, user_data);
 }
 
+static void show_preview_thumbnail(MainWindowData *data, GdkPixbuf *pixbuf) {
+    if (pixbuf) {
+        int width = gdk_pixbuf_get_width(pixbuf);
+        int height = gdk_pixbuf_get_height(pixbuf);
+
+        // Scale to fit 350 width while maintaining aspect ratio
+        int new_width = 350;
+        int new_height = (height * new_width) / width;
+
+        GdkPixbuf *scaled = gdk_pixbuf_scale_simple(pixbuf,
+                                                    new_width, new_height,
+                                                    GDK_INTERP_BILINEAR);
+        GdkTexture *texture = gdk_texture_new_for_pixbuf(scaled);
+        gtk_image_set_from_paintable(GTK_IMAGE(data->preview_thumbnail),
+                                     GDK_PAINTABLE(texture));
+        g_object_unref(scaled);
+        g_object_unref(texture);
+    } else {
+        gtk_image_set_from_icon_name(GTK_IMAGE(data->preview_thumbnail), "video-x-generic");
+    }
+}
+
 static void on_metadata_fetched(VideoMetadata *meta, gpointer user_data) {
-    MainWindowData *data = (MainWindowData *)user_data;
+    MainWindowData *data = window_ref_take(user_data);
+    if (!data) {
+        if (meta) metadata_free(meta);
+        return;
+    }
 
     if (!meta || !meta->title) {
         if (GTK_IS_WIDGET(data->preview_box)) {
@@ -298,31 +400,23 @@ static void on_metadata_fetched(VideoMetadata *meta, gpointer user_data) {
         return;
     }
 
+    data->preview_complete = TRUE;
+
     // Update preview
     if (meta->title) {
         gtk_label_set_text(GTK_LABEL(data->preview_title), meta->title);
     }
 
-    if (meta->thumbnail_pixbuf) {
-        int width = gdk_pixbuf_get_width(meta->thumbnail_pixbuf);
-        int height = gdk_pixbuf_get_height(meta->thumbnail_pixbuf);
-
-        // Scale to fit 350 width while maintaining aspect ratio
-        int new_width = 350;
-        int new_height = (height * new_width) / width;
-
-        GdkPixbuf *scaled = gdk_pixbuf_scale_simple(meta->thumbnail_pixbuf,
-                                                    new_width, new_height,
-                                                    GDK_INTERP_BILINEAR);
-        GdkTexture *texture = gdk_texture_new_for_pixbuf(scaled);
-        gtk_image_set_from_paintable(GTK_IMAGE(data->preview_thumbnail),
-                                     GDK_PAINTABLE(texture));
-        g_object_unref(scaled);
-        g_object_unref(texture);
-    } else {
-        gtk_image_set_from_icon_name(GTK_IMAGE(data->preview_thumbnail), "video-x-generic");
+    // Keep the image the quick phase already loaded instead of fetching again
+    VideoMetadata *quick_meta = g_object_get_data(G_OBJECT(data->preview_box), "metadata");
+    if (!meta->thumbnail_pixbuf && quick_meta && quick_meta->thumbnail_pixbuf) {
+        meta->thumbnail_pixbuf = g_object_ref(quick_meta->thumbnail_pixbuf);
+        g_free(meta->thumbnail_url);
+        meta->thumbnail_url = g_strdup(quick_meta->thumbnail_url);
     }
 
+    show_preview_thumbnail(data, meta->thumbnail_pixbuf);
+
     // Build info text
     GString *info = g_string_new("");
     if (meta->uploader) {
@@ -359,4 +453,64 @@ static void on_metadata_fetched(VideoMetadata *meta, gpointer user_data) {
     g_object_set_data(G_OBJECT(data->preview_box), "metadata", meta);
 
     gtk_widget_set_visible(data->preview_box, TRUE);
+
+    if (meta->thumbnail_url && !meta->thumbnail_pixbuf) {
+        metadata_thumbnail_async(meta->thumbnail_url, WORK_LANE_INTERACTIVE,
+                                 on_thumbnail_fetched, window_ref_new(data));
+    }
+}
+
+// Title, uploader and thumbnail from oEmbed or the page, shown until the
+// full metadata with the formats arrives
+static void on_quick_preview(const char *url, VideoMetadata *meta, gpointer user_data) {
+    MainWindowData *data = window_ref_take(user_data);
+
+    (void)url;
+
+    if (!data || !meta || data->preview_complete || !GTK_IS_WIDGET(data->preview_box)) {
+        if (meta) metadata_free(meta);
+        return;
+    }
+
+    gtk_label_set_text(GTK_LABEL(data->preview_title), meta->title);
+
+    char *info = meta->uploader ? g_strdup_printf("%s • Loading formats...", meta->uploader)
+                                : g_strdup("Loading formats...");
+    gtk_label_set_text(GTK_LABEL(data->preview_info), info);
+    g_free(info);
+
+    show_preview_thumbnail(data, NULL);
+
+    VideoMetadata *old_meta = g_object_get_data(G_OBJECT(data->preview_box), "metadata");
+    if (old_meta) {
+        metadata_free(old_meta);
+    }
+    g_object_set_data(G_OBJECT(data->preview_box), "metadata", meta);
+
+    gtk_widget_set_visible(data->preview_box, TRUE);
+
+    if (meta->thumbnail_url) {
+        metadata_thumbnail_async(meta->thumbnail_url, WORK_LANE_INTERACTIVE,
+                                 on_thumbnail_fetched, window_ref_new(data));
+    }
+}
+
+static void on_thumbnail_fetched(const char *url, GdkPixbuf *pixbuf, gpointer user_data) {
+    MainWindowData *data = window_ref_take(user_data);
+    if (!pixbuf) return;
+    if (!data) {
+        g_object_unref(pixbuf);
+        return;
+    }
+
+    // Ignore the answer for a URL that is no longer previewed
+    VideoMetadata *meta = GTK_IS_WIDGET(data->preview_box)
+        ? g_object_get_data(G_OBJECT(data->preview_box), "metadata") : NULL;
+    if (!meta || meta->thumbnail_pixbuf || g_strcmp0(meta->thumbnail_url, url) != 0) {
+        g_object_unref(pixbuf);
+        return;
+    }
+
+    meta->thumbnail_pixbuf = pixbuf;
+    show_preview_thumbnail(data, pixbuf);
 }
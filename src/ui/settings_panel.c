@@ -1,16 +1,89 @@
 #include "settings_panel.h"
 #include "../core/ytdlp_manager.h"
+#include "../utils/config.h"
 
 typedef struct {
     GtkWidget *version_label;
     GtkWidget *path_label;
     GtkWidget *update_button;
     GtkWidget *status_label;
+    GtkWidget *update_output_scroll;
+    GtkWidget *update_output_view;
+    GCancellable *cancellable;  // Cancelled when the window goes away
 } SettingsPanelData;
 
+static void settings_panel_data_free(SettingsPanelData *data) {
+    g_cancellable_cancel(data->cancellable);
+    g_object_unref(data->cancellable);
+    g_free(data);
+}
+
 static void on_update_clicked(GtkButton *button, gpointer user_data);
 static void on_check_version_clicked(GtkButton *button, gpointer user_data);
 
+// Persist the shared config after a control changed it. config_save()
+// notifies the scheduler, so limits apply to the running instance.
+static void settings_commit(void) {
+    GError *error = NULL;
+    if (!config_save(config_get(), &error)) {
+        g_warning("Failed to save settings: %s", error->message);
+        g_error_free(error);
+    }
+}
+
+static void on_int_setting_changed(GtkSpinButton *spin, gpointer user_data) {
+    gsize offset = GPOINTER_TO_SIZE(user_data);
+    G_STRUCT_MEMBER(int, config_get(), offset) = gtk_spin_button_get_value_as_int(spin);
+    settings_commit();
+}
+
+static void on_bool_setting_toggled(GtkCheckButton *check, gpointer user_data) {
+    gsize offset = GPOINTER_TO_SIZE(user_data);
+    G_STRUCT_MEMBER(gboolean, config_get(), offset) = gtk_check_button_get_active(check);
+    settings_commit();
+}
+
+// Saved once the path is entered or the field is left, not per keystroke
+static void path_setting_commit(GtkEditable *editable) {
+    const char *path = gtk_editable_get_text(editable);
+    if (!path || !*path) return;
+
+    AppConfig *config = config_get();
+    if (g_strcmp0(config->default_download_path, path) == 0) return;
+
+    g_free(config->default_download_path);
+    config->default_download_path = g_strdup(path);
+    settings_commit();
+}
+
+static void on_path_setting_activate(GtkEntry *entry, gpointer user_data) {
+    (void)user_data;
+    path_setting_commit(GTK_EDITABLE(entry));
+}
+
+static void on_path_setting_focus_leave(GtkEventControllerFocus *controller, gpointer user_data) {
+    (void)controller;
+    path_setting_commit(GTK_EDITABLE(user_data));
+}
+
+static GtkWidget* settings_spin_row_new(const char *title, int min, int max,
+                                        gsize offset) {
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    GtkWidget *label = gtk_label_new(title);
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_widget_set_hexpand(label, TRUE);
+    gtk_box_append(GTK_BOX(box), label);
+
+    GtkWidget *spin = gtk_spin_button_new_with_range(min, max, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin),
+                              G_STRUCT_MEMBER(int, config_get(), offset));
+    g_signal_connect(spin, "value-changed", G_CALLBACK(on_int_setting_changed),
+                     GSIZE_TO_POINTER(offset));
+    gtk_box_append(GTK_BOX(box), spin);
+
+    return box;
+}
+
 GtkWidget* settings_panel_new(void) {
     GtkWidget *window = gtk_window_new();
     gtk_window_set_title(GTK_WINDOW(window), "Settings");
@@ -33,6 +106,7 @@ GtkWidget* settings_panel_new(void) {
     gtk_box_append(GTK_BOX(main_box), content);
 
     SettingsPanelData *data = g_malloc0(sizeof(SettingsPanelData));
+    data->cancellable = g_cancellable_new();
 
     // yt-dlp Section
     GtkWidget *ytdlp_frame = gtk_frame_new("yt-dlp Configuration");
@@ -95,6 +169,18 @@ GtkWidget* settings_panel_new(void) {
     gtk_widget_add_css_class(data->status_label, "dim-label");
     gtk_box_append(GTK_BOX(ytdlp_box), data->status_label);
 
+    // Live output of yt-dlp -U (shown once an update starts)
+    data->update_output_scroll = gtk_scrolled_window_new();
+    gtk_widget_set_size_request(data->update_output_scroll, -1, 100);
+    gtk_widget_set_visible(data->update_output_scroll, FALSE);
+    gtk_box_append(GTK_BOX(ytdlp_box), data->update_output_scroll);
+
+    data->update_output_view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(data->update_output_view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(data->update_output_view), TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(data->update_output_scroll),
+                                  data->update_output_view);
+
     // Download Settings Section
     GtkWidget *download_frame = gtk_frame_new("Download Settings");
     gtk_box_append(GTK_BOX(content), download_frame);
@@ -106,41 +192,67 @@ GtkWidget* settings_panel_new(void) {
     gtk_widget_set_margin_end(download_box, 12);
     gtk_frame_set_child(GTK_FRAME(download_frame), download_box);
 
-    // Max concurrent downloads
-    GtkWidget *concurrent_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
-    GtkWidget *concurrent_label = gtk_label_new("Max Concurrent Downloads:");
-    gtk_widget_set_halign(concurrent_label, GTK_ALIGN_START);
-    gtk_widget_set_hexpand(concurrent_label, TRUE);
-    gtk_box_append(GTK_BOX(concurrent_box), concurrent_label);
-
-    GtkWidget *concurrent_spin = gtk_spin_button_new_with_range(1, 10, 1);
-    gtk_spin_button_set_value(GTK_SPIN_BUTTON(concurrent_spin), 3);
-    gtk_box_append(GTK_BOX(concurrent_box), concurrent_spin);
-
-    gtk_box_append(GTK_BOX(download_box), concurrent_box);
+    AppConfig *config = config_get();
+
+    // Default download location
+    GtkWidget *path_setting_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    GtkWidget *path_setting_label = gtk_label_new("Default Location:");
+    gtk_widget_set_halign(path_setting_label, GTK_ALIGN_START);
+    gtk_box_append(GTK_BOX(path_setting_box), path_setting_label);
+
+    GtkWidget *path_setting_entry = gtk_entry_new();
+    gtk_editable_set_text(GTK_EDITABLE(path_setting_entry), config->default_download_path);
+    gtk_widget_set_hexpand(path_setting_entry, TRUE);
+    g_signal_connect(path_setting_entry, "activate", G_CALLBACK(on_path_setting_activate), NULL);
+    GtkEventController *path_focus = gtk_event_controller_focus_new();
+    g_signal_connect(path_focus, "leave", G_CALLBACK(on_path_setting_focus_leave),
+                     path_setting_entry);
+    gtk_widget_add_controller(path_setting_entry, path_focus);
+    gtk_box_append(GTK_BOX(path_setting_box), path_setting_entry);
+
+    gtk_box_append(GTK_BOX(download_box), path_setting_box);
+
+    // Scheduler limits
+    gtk_box_append(GTK_BOX(download_box),
+                   settings_spin_row_new("Max Concurrent Downloads:", 1, 64,
+                                         G_STRUCT_OFFSET(AppConfig, max_concurrent_downloads)));
+    gtk_box_append(GTK_BOX(download_box),
+                   settings_spin_row_new("Rate Limit per Download (KiB/s, 0 = off):", 0, 1024 * 1024,
+                                         G_STRUCT_OFFSET(AppConfig, rate_limit_kib)));
+    gtk_box_append(GTK_BOX(download_box),
+                   settings_spin_row_new("Retries for Failed Downloads:", 0, 20,
+                                         G_STRUCT_OFFSET(AppConfig, max_retries)));
 
     // Auto-update check
     GtkWidget *auto_update = gtk_check_button_new_with_label(
         "Automatically check for yt-dlp updates on startup");
+    gtk_check_button_set_active(GTK_CHECK_BUTTON(auto_update), config->auto_check_updates);
+    g_signal_connect(auto_update, "toggled", G_CALLBACK(on_bool_setting_toggled),
+                     GSIZE_TO_POINTER(G_STRUCT_OFFSET(AppConfig, auto_check_updates)));
     gtk_box_append(GTK_BOX(download_box), auto_update);
 
     // Store data
-    g_object_set_data_full(G_OBJECT(window), "settings-data", data, g_free);
+    g_object_set_data_full(G_OBJECT(window), "settings-data", data,
+                           (GDestroyNotify)settings_panel_data_free);
 
-    // Initial version check
+    // Initial version check (served from the session cache when possible)
     on_check_version_clicked(NULL, data);
 
     return window;
 }
 
-static void on_check_version_clicked(GtkButton *button, gpointer user_data) {
-    (void)button;
-    SettingsPanelData *data = (SettingsPanelData *)user_data;
+static void on_version_checked(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;
+    GError *error = NULL;
+    YtdlpInfo *info = ytdlp_get_info_finish(result, &error);
 
-    gtk_label_set_text(GTK_LABEL(data->version_label), "Checking...");
-    gtk_label_set_text(GTK_LABEL(data->status_label), "");
+    if (!info) {
+        // Cancelled: the window and its widgets are gone
+        g_error_free(error);
+        return;
+    }
 
-    YtdlpInfo *info = ytdlp_get_info();
+    SettingsPanelData *data = (SettingsPanelData *)user_data;
 
     if (info->is_installed) {
         gtk_label_set_text(GTK_LABEL(data->version_label),
@@ -165,29 +277,66 @@ static void on_check_version_clicked(GtkButton *button, gpointer user_data) {
     ytdlp_info_free(info);
 }
 
-static void on_update_clicked(GtkButton *button, gpointer user_data) {
+static void on_check_version_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
     SettingsPanelData *data = (SettingsPanelData *)user_data;
 
-    gtk_widget_set_sensitive(GTK_WIDGET(button), FALSE);
-    gtk_label_set_text(GTK_LABEL(data->status_label), "Updating yt-dlp...");
+    gtk_label_set_text(GTK_LABEL(data->version_label), "Checking...");
+    gtk_label_set_text(GTK_LABEL(data->status_label), "");
+
+    ytdlp_get_info_async(data->cancellable, on_version_checked, data);
+}
+
+static void on_update_output(const char *line, gpointer user_data) {
+    SettingsPanelData *data = (SettingsPanelData *)user_data;
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(data->update_output_view));
+    GtkTextIter end;
+
+    gtk_text_buffer_get_end_iter(buffer, &end);
+    gtk_text_buffer_insert(buffer, &end, line, -1);
+    gtk_text_buffer_insert(buffer, &end, "\n", 1);
+    gtk_label_set_text(GTK_LABEL(data->status_label), line);
+}
 
-    // Run update in background (simplified - should use async)
+static void on_update_finished(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;
     GError *error = NULL;
-    gboolean success = ytdlp_update(&error);
+    gboolean success = ytdlp_update_finish(result, &error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        return;
+    }
+
+    SettingsPanelData *data = (SettingsPanelData *)user_data;
 
     if (success) {
+        // The cache was invalidated, so this re-reads the new version
+        on_check_version_clicked(NULL, data);
         gtk_label_set_text(GTK_LABEL(data->status_label),
                           "✓ yt-dlp updated successfully");
-        on_check_version_clicked(NULL, data);
     } else {
         char *error_msg = g_strdup_printf("✗ Update failed: %s",
                                          error ? error->message : "Unknown error");
         gtk_label_set_text(GTK_LABEL(data->status_label), error_msg);
         g_free(error_msg);
-        if (error) g_error_free(error);
     }
+    g_clear_error(&error);
+
+    gtk_widget_set_sensitive(data->update_button, TRUE);
+}
+
+static void on_update_clicked(GtkButton *button, gpointer user_data) {
+    SettingsPanelData *data = (SettingsPanelData *)user_data;
+
+    gtk_widget_set_sensitive(GTK_WIDGET(button), FALSE);
+    gtk_label_set_text(GTK_LABEL(data->status_label), "Updating yt-dlp...");
+
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(data->update_output_view));
+    gtk_text_buffer_set_text(buffer, "", -1);
+    gtk_widget_set_visible(data->update_output_scroll, TRUE);
 
-    gtk_widget_set_sensitive(GTK_WIDGET(button), TRUE);
+    ytdlp_update_async(on_update_output, data, data->cancellable, on_update_finished, data);
 }
 
 void settings_panel_show(GtkWindow *parent) {
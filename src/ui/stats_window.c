@@ -0,0 +1,235 @@
+#include "stats_window.h"
+#include "../core/metrics.h"
+#include "../core/process_manager.h"
+#include "../core/work_pool.h"
+#include "../utils/string_utils.h"
+
+#define STATS_REFRESH_SECONDS 1
+
+static const MetricCounter shown_counters[] = {
+    METRIC_DOWNLOADS_STARTED,
+    METRIC_DOWNLOADS_COMPLETED,
+    METRIC_DOWNLOADS_FAILED,
+    METRIC_DOWNLOADS_CANCELLED,
+    METRIC_RETRIES,
+    METRIC_STALLS,
+    METRIC_METADATA_FETCHES,
+    METRIC_METADATA_CACHE_HITS,
+    METRIC_METADATA_PREFETCHES,
+    METRIC_PLANS_STREAM_COPY,
+    METRIC_PLANS_TRANSCODE,
+};
+
+typedef struct {
+    GtkWidget *throughput_label;
+    GtkWidget *bytes_label;
+    GtkWidget *counter_labels[G_N_ELEMENTS(shown_counters)];
+    GtkWidget *histogram_labels[METRIC_HISTOGRAM_COUNT][4];  // Count, mean, p50, p90
+    GtkWidget *failure_labels[FAILURE_REASON_COUNT];
+    GtkWidget *policy_labels[QUEUE_POLICY_COUNT][2];  // Completed, mean time to done
+    GtkWidget *lane_labels[WORK_LANE_COUNT][4];  // Queued, running, completed, mean wait
+    guint refresh_id;
+} StatsWindowData;
+
+static char* format_speed(double bytes_per_second) {
+    char *size = string_format_size((int64_t)bytes_per_second);
+    char *speed = g_strdup_printf("%s/s", size);
+    g_free(size);
+    return speed;
+}
+
+static char* format_histogram_value(MetricHistogram histogram, double value) {
+    if (metrics_histogram_is_latency(histogram)) {
+        return value < 1.0 ? g_strdup_printf("%.0f ms", value * 1000)
+                           : g_strdup_printf("%.1f s", value);
+    }
+    return format_speed(value);
+}
+
+static void set_label_take(GtkWidget *label, char *text) {
+    gtk_label_set_text(GTK_LABEL(label), text);
+    g_free(text);
+}
+
+static gboolean stats_refresh(gpointer user_data) {
+    StatsWindowData *data = user_data;
+
+    // Live rate across everything currently transferring
+    double speed = 0.0;
+    for (GList *l = process_manager_get_all(); l != NULL; l = l->next) {
+        DownloadItem *item = l->data;
+        if (item->status == DOWNLOAD_STATUS_DOWNLOADING && !item->stage_suspended) {
+            speed += item->speed;
+        }
+    }
+    set_label_take(data->throughput_label, format_speed(speed));
+    set_label_take(data->bytes_label,
+                   string_format_size((int64_t)metrics_counter_get(METRIC_BYTES_DOWNLOADED)));
+
+    for (gsize i = 0; i < G_N_ELEMENTS(shown_counters); i++) {
+        set_label_take(data->counter_labels[i],
+                       g_strdup_printf("%" G_GUINT64_FORMAT,
+                                       metrics_counter_get(shown_counters[i])));
+    }
+
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        GtkWidget **labels = data->histogram_labels[h];
+        uint64_t count = metrics_histogram_count(h);
+
+        set_label_take(labels[0], g_strdup_printf("%" G_GUINT64_FORMAT, count));
+        if (count == 0) {
+            for (int c = 1; c < 4; c++) gtk_label_set_text(GTK_LABEL(labels[c]), "—");
+            continue;
+        }
+        set_label_take(labels[1], format_histogram_value(h, metrics_histogram_mean(h)));
+        set_label_take(labels[2], format_histogram_value(h, metrics_histogram_quantile(h, 0.5)));
+        set_label_take(labels[3], format_histogram_value(h, metrics_histogram_quantile(h, 0.9)));
+    }
+
+    for (int i = 0; i < FAILURE_REASON_COUNT; i++) {
+        set_label_take(data->failure_labels[i],
+                       g_strdup_printf("%" G_GUINT64_FORMAT, metrics_failure_count(i)));
+    }
+
+    for (int p = 0; p < QUEUE_POLICY_COUNT; p++) {
+        uint64_t count = metrics_time_to_done_count(p);
+        set_label_take(data->policy_labels[p][0], g_strdup_printf("%" G_GUINT64_FORMAT, count));
+        if (count == 0) {
+            gtk_label_set_text(GTK_LABEL(data->policy_labels[p][1]), "—");
+        } else {
+            set_label_take(data->policy_labels[p][1],
+                           format_histogram_value(METRIC_TIME_TO_DONE,
+                                                  metrics_time_to_done_mean(p)));
+        }
+    }
+
+    for (int lane = 0; lane < WORK_LANE_COUNT; lane++) {
+        WorkLaneStats stats;
+        work_pool_get_stats(lane, &stats);
+        set_label_take(data->lane_labels[lane][0], g_strdup_printf("%" G_GUINT64_FORMAT, stats.queued));
+        set_label_take(data->lane_labels[lane][1], g_strdup_printf("%" G_GUINT64_FORMAT, stats.running));
+        set_label_take(data->lane_labels[lane][2], g_strdup_printf("%" G_GUINT64_FORMAT, stats.completed));
+        set_label_take(data->lane_labels[lane][3],
+                       format_histogram_value(METRIC_QUEUE_WAIT, stats.mean_wait));
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void stats_window_data_free(StatsWindowData *data) {
+    if (data->refresh_id > 0) {
+        g_source_remove(data->refresh_id);
+    }
+    g_free(data);
+}
+
+static GtkWidget* grid_label(GtkWidget *grid, const char *text, int column, int row,
+                             gboolean dim) {
+    GtkWidget *label = gtk_label_new(text);
+    gtk_widget_set_halign(label, column == 0 ? GTK_ALIGN_START : GTK_ALIGN_END);
+    if (dim) {
+        gtk_widget_add_css_class(label, "dim-label");
+    }
+    gtk_grid_attach(GTK_GRID(grid), label, column, row, 1, 1);
+    return label;
+}
+
+static GtkWidget* stats_section_new(GtkWidget *content, const char *title) {
+    GtkWidget *frame = gtk_frame_new(title);
+    gtk_box_append(GTK_BOX(content), frame);
+
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 6);
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 18);
+    gtk_widget_set_margin_top(grid, 12);
+    gtk_widget_set_margin_bottom(grid, 12);
+    gtk_widget_set_margin_start(grid, 12);
+    gtk_widget_set_margin_end(grid, 12);
+    gtk_frame_set_child(GTK_FRAME(frame), grid);
+
+    return grid;
+}
+
+void stats_window_show(GtkWindow *parent) {
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), "Statistics");
+    gtk_window_set_default_size(GTK_WINDOW(window), 520, 560);
+    gtk_window_set_transient_for(GTK_WINDOW(window), parent);
+
+    GtkWidget *header = gtk_header_bar_new();
+    gtk_window_set_titlebar(GTK_WINDOW(window), header);
+
+    GtkWidget *scroll = gtk_scrolled_window_new();
+    gtk_window_set_child(GTK_WINDOW(window), scroll);
+
+    GtkWidget *content = gtk_box_new(GTK_ORIENTATION_VERTICAL, 12);
+    gtk_widget_set_margin_top(content, 24);
+    gtk_widget_set_margin_bottom(content, 24);
+    gtk_widget_set_margin_start(content, 24);
+    gtk_widget_set_margin_end(content, 24);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scroll), content);
+
+    StatsWindowData *data = g_malloc0(sizeof(StatsWindowData));
+
+    // Totals
+    GtkWidget *grid = stats_section_new(content, "Totals");
+    int row = 0;
+    grid_label(grid, "Current throughput", 0, row, FALSE);
+    data->throughput_label = grid_label(grid, "", 1, row++, FALSE);
+    grid_label(grid, "Bytes downloaded", 0, row, FALSE);
+    data->bytes_label = grid_label(grid, "", 1, row++, FALSE);
+    for (gsize i = 0; i < G_N_ELEMENTS(shown_counters); i++) {
+        grid_label(grid, metrics_counter_label(shown_counters[i]), 0, row, FALSE);
+        data->counter_labels[i] = grid_label(grid, "", 1, row++, FALSE);
+    }
+
+    // Distributions
+    grid = stats_section_new(content, "Latency and Throughput");
+    static const char *columns[] = { "Count", "Mean", "p50", "p90" };
+    for (gsize c = 0; c < G_N_ELEMENTS(columns); c++) {
+        grid_label(grid, columns[c], c + 1, 0, TRUE);
+    }
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        grid_label(grid, metrics_histogram_label(h), 0, h + 1, FALSE);
+        for (int c = 0; c < 4; c++) {
+            data->histogram_labels[h][c] = grid_label(grid, "", c + 1, h + 1, FALSE);
+        }
+    }
+
+    // Failures
+    grid = stats_section_new(content, "Failed Attempts");
+    for (int i = 0; i < FAILURE_REASON_COUNT; i++) {
+        grid_label(grid, metrics_failure_label(i), 0, i, FALSE);
+        data->failure_labels[i] = grid_label(grid, "", 1, i, FALSE);
+    }
+
+    // Queue policies, compared on mean time to done
+    grid = stats_section_new(content, "Queue Policies");
+    grid_label(grid, "Completed", 1, 0, TRUE);
+    grid_label(grid, "Mean time to done", 2, 0, TRUE);
+    for (int p = 0; p < QUEUE_POLICY_COUNT; p++) {
+        grid_label(grid, metrics_queue_policy_label(p), 0, p + 1, FALSE);
+        data->policy_labels[p][0] = grid_label(grid, "", 1, p + 1, FALSE);
+        data->policy_labels[p][1] = grid_label(grid, "", 2, p + 1, FALSE);
+    }
+
+    // Helper thread lanes
+    grid = stats_section_new(content, "Worker Lanes");
+    static const char *lane_headers[] = { "Queued", "Running", "Completed", "Mean wait" };
+    for (int c = 0; c < 4; c++) {
+        grid_label(grid, lane_headers[c], c + 1, 0, TRUE);
+    }
+    for (int lane = 0; lane < WORK_LANE_COUNT; lane++) {
+        grid_label(grid, work_pool_lane_label(lane), 0, lane + 1, FALSE);
+        for (int c = 0; c < 4; c++) {
+            data->lane_labels[lane][c] = grid_label(grid, "", c + 1, lane + 1, FALSE);
+        }
+    }
+
+    stats_refresh(data);
+    data->refresh_id = g_timeout_add_seconds(STATS_REFRESH_SECONDS, stats_refresh, data);
+    g_object_set_data_full(G_OBJECT(window), "stats-data", data,
+                           (GDestroyNotify)stats_window_data_free);
+
+    gtk_window_present(GTK_WINDOW(window));
+}
@@ -0,0 +1,8 @@
+#ifndef STATS_WINDOW_H
+#define STATS_WINDOW_H
+
+#include "common.h"
+
+void stats_window_show(GtkWindow *parent);
+
+#endif
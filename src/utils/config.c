@@ -1,27 +1,752 @@
 #include "config.h"
+#include <gio/gio.h>
+#include <errno.h>
+#include <stddef.h>
 
-AppConfig *config_load(void) {
-    AppConfig *config = g_malloc0(sizeof(AppConfig));
+#define CONFIG_DIR_NAME "datareel"
+#define CONFIG_FILE_NAME "config.ini"
+#define CONFIG_RELOAD_DELAY_MS 250
+#define SCHEDULE_GROUP_PREFIX "schedule:"
+
+// Typed schema: every persisted setting is described once here and
+// loaded, validated and saved generically from this table.
+typedef enum {
+    CONFIG_TYPE_STRING,
+    CONFIG_TYPE_STRING_LIST,
+    CONFIG_TYPE_INT,
+    CONFIG_TYPE_BOOLEAN,
+    CONFIG_TYPE_ENUM
+} ConfigValueType;
+
+typedef struct {
+    const char *group;
+    const char *key;
+    ConfigValueType type;
+    size_t offset;
+    int min;                        // INT only
+    int max;                        // INT only
+    const char * const *names;      // ENUM only, NULL-terminated
+} ConfigField;
+
+static const char * const quality_names[] = {
+    "best", "1080p", "720p", "480p", "360p", "audio", "custom", NULL
+};
+
+static const char * const launch_mode_names[] = {
+    "binary", "python-module", "zipapp", NULL
+};
+
+static const char * const pause_mode_names[] = {
+    "stop", "terminate", NULL
+};
+
+static const char * const queue_policy_names[] = {
+    "fifo", "smallest-first", "aged-sjf", "priority", NULL
+};
+
+static const char * const priority_names[] = {
+    "normal", "high", "low", NULL
+};
+
+static const char * const format_names[] = {
+    "mp4", "webm", "mkv", "mp3", "m4a", "opus", NULL
+};
+
+#define FIELD_STRING(g, k, m) \
+    { g, k, CONFIG_TYPE_STRING, offsetof(AppConfig, m), 0, 0, NULL }
+#define FIELD_STRING_LIST(g, k, m) \
+    { g, k, CONFIG_TYPE_STRING_LIST, offsetof(AppConfig, m), 0, 0, NULL }
+#define FIELD_INT(g, k, m, lo, hi) \
+    { g, k, CONFIG_TYPE_INT, offsetof(AppConfig, m), lo, hi, NULL }
+#define FIELD_BOOL(g, k, m) \
+    { g, k, CONFIG_TYPE_BOOLEAN, offsetof(AppConfig, m), 0, 0, NULL }
+#define FIELD_ENUM(g, k, m, n) \
+    { g, k, CONFIG_TYPE_ENUM, offsetof(AppConfig, m), 0, 0, n }
+
+static const ConfigField config_schema[] = {
+    FIELD_STRING("paths", "download_path", default_download_path),
+    FIELD_STRING("paths", "ytdlp_binary", ytdlp_binary),
+
+    FIELD_ENUM("launcher", "mode", ytdlp_launch_mode, launch_mode_names),
+    FIELD_STRING("launcher", "python", python_interpreter),
+    FIELD_STRING("launcher", "venv", python_venv),
+    FIELD_STRING_LIST("launcher", "interpreter_flags", interpreter_flags),
+
+    FIELD_INT("concurrency", "max_downloads", max_concurrent_downloads, 1, 64),
+    FIELD_INT("concurrency", "max_processing", max_concurrent_processing, 0, 256),
+
+    FIELD_BOOL("adaptive", "enabled", adaptive_concurrency),
+    FIELD_INT("adaptive", "min_downloads", adaptive_min_downloads, 1, 64),
+    FIELD_INT("adaptive", "max_downloads", adaptive_max_downloads, 1, 256),
+    FIELD_INT("adaptive", "interval_seconds", adaptive_interval_seconds, 1, 3600),
+    FIELD_INT("adaptive", "gain_percent", adaptive_gain_percent, 0, 100),
+    FIELD_INT("adaptive", "error_backoff_percent", adaptive_error_backoff_percent, 1, 99),
+    FIELD_INT("adaptive", "flat_backoff_percent", adaptive_flat_backoff_percent, 1, 99),
+
+    FIELD_ENUM("queue", "policy", queue_policy, queue_policy_names),
+    FIELD_INT("queue", "aging_mib_per_minute", aging_mib_per_minute, 0, 1024 * 1024),
+
+    FIELD_INT("rate-limits", "per_download_kib", rate_limit_kib, 0, 10 * 1024 * 1024),
+
+    FIELD_BOOL("resources", "use_cgroups", use_cgroups),
+    FIELD_INT("resources", "download_nice", download_nice, 0, 19),
+    FIELD_INT("resources", "processing_nice", processing_nice, 0, 19),
+    FIELD_INT("resources", "download_cpu_weight", download_cpu_weight, 1, 10000),
+    FIELD_INT("resources", "processing_cpu_weight", processing_cpu_weight, 1, 10000),
+    FIELD_INT("resources", "processing_cpu_max_percent", processing_cpu_max_percent, 0, 100),
+    FIELD_INT("resources", "memory_max_mb", memory_max_mb, 0, 1024 * 1024),
+    FIELD_INT("resources", "download_io_level", download_io_level, 0, 7),
+    FIELD_INT("resources", "processing_io_level", processing_io_level, 0, 7),
+    FIELD_INT("resources", "download_io_weight", download_io_weight, 1, 10000),
+    FIELD_INT("resources", "processing_io_weight", processing_io_weight, 1, 10000),
+
+    FIELD_INT("fragments", "budget", fragment_budget, 1, 256),
+    FIELD_INT("fragments", "max_per_item", max_fragments_per_item, 1, 64),
+    FIELD_INT("fragments", "http_chunk_size_kib", http_chunk_size_kib, 0, 1024 * 1024),
+    FIELD_INT("fragments", "buffer_size_kib", buffer_size_kib, 0, 64 * 1024),
+
+    FIELD_STRING_LIST("storage", "output_roots", output_roots),
+    FIELD_INT("storage", "min_free_mb", min_free_mb, 0, 1024 * 1024),
+    FIELD_INT("storage", "unknown_size_mb", unknown_size_mb, 0, 1024 * 1024),
+
+    FIELD_INT("cache", "metadata_entries", metadata_cache_size, 0, 10000),
+
+    FIELD_BOOL("native", "enabled", native_downloads),
+    FIELD_INT("native", "connections", native_connections, 1, 16),
+    FIELD_INT("native", "min_segment_mib", native_min_segment_mib, 1, 1024),
+
+    FIELD_BOOL("aria2", "enabled", aria2_downloads),
+    FIELD_STRING("aria2", "binary", aria2_binary),
+    FIELD_INT("aria2", "port", aria2_port, 1024, 65535),
+    FIELD_INT("aria2", "max_connections", aria2_max_connections, 1, 256),
+    FIELD_INT("aria2", "connections_per_file", aria2_connections_per_file, 1, 16),
+    FIELD_INT("aria2", "max_overall_kib", aria2_max_overall_kib, 0, 10 * 1024 * 1024),
+
+    FIELD_INT("clips", "parallel", clip_parallel, 0, 64),
+    FIELD_BOOL("clips", "keep_source", clip_keep_source),
+
+    FIELD_STRING_LIST("formats", "prefer_vcodecs", format_vcodecs),
+    FIELD_STRING_LIST("formats", "prefer_acodecs", format_acodecs),
+    FIELD_INT("formats", "max_height", format_max_height, 0, 8640),
+    FIELD_INT("formats", "min_fps", format_min_fps, 0, 240),
+    FIELD_INT("formats", "max_size_mib", format_max_size_mib, 0, 1024 * 1024),
+    FIELD_BOOL("formats", "prefer_smaller", format_prefer_smaller),
+
+    FIELD_BOOL("preview", "quick", quick_preview),
+    FIELD_INT("preview", "quick_timeout_ms", quick_preview_timeout_ms, 100, 30000),
+    FIELD_STRING("preview", "oembed_endpoint", oembed_endpoint),
+
+    FIELD_INT("prefetch", "depth", prefetch_depth, 0, 64),
+    FIELD_INT("workers", "interactive", interactive_workers, 1, 16),
+    FIELD_INT("workers", "background", background_workers, 1, 16),
+
+    FIELD_INT("watchdog", "stall_seconds", stall_seconds, 0, 24 * 3600),
+    FIELD_INT("watchdog", "min_speed_kib", min_speed_kib, 0, 1024 * 1024),
+    FIELD_INT("watchdog", "extract_seconds", extract_seconds, 0, 24 * 3600),
+
+    FIELD_INT("cancel", "kill_timeout_seconds", kill_timeout_seconds, 1, 300),
+    FIELD_ENUM("pause", "mode", pause_mode, pause_mode_names),
+
+    FIELD_INT("retry", "max_retries", max_retries, 0, 20),
+    FIELD_INT("retry", "backoff_seconds", retry_backoff_seconds, 0, 3600),
+    FIELD_INT("retry", "ytdlp_retries", ytdlp_retries, 0, 100),
 
-    // Set defaults
+    FIELD_BOOL("updates", "auto_check", auto_check_updates),
+
+    FIELD_ENUM("download-defaults", "quality", default_options.quality, quality_names),
+    FIELD_ENUM("download-defaults", "format", default_options.format, format_names),
+    FIELD_BOOL("download-defaults", "audio_only", default_options.audio_only),
+    FIELD_BOOL("download-defaults", "subtitles", default_options.subtitles),
+    FIELD_BOOL("download-defaults", "embed_thumbnail", default_options.embed_thumbnail),
+    FIELD_BOOL("download-defaults", "playlist", default_options.playlist),
+    FIELD_STRING("download-defaults", "output_template", default_options.output_template),
+    FIELD_INT("download-defaults", "concurrent_fragments", default_options.concurrent_fragments, 0, 64),
+    FIELD_ENUM("download-defaults", "priority", default_options.priority, priority_names),
+};
+
+typedef struct {
+    guint id;
+    ConfigChangedFunc func;
+    gpointer user_data;
+} ConfigWatch;
+
+static AppConfig *shared_config = NULL;
+static GList *config_watches = NULL;
+static guint next_watch_id = 1;
+static GFileMonitor *config_monitor = NULL;
+static guint reload_timeout_id = 0;
+static char *last_written_data = NULL;
+
+static void config_set_defaults(AppConfig *config) {
     config->default_download_path = g_strdup(g_get_home_dir());
+    config->ytdlp_binary = g_strdup("yt-dlp");
+    config->ytdlp_launch_mode = YTDLP_LAUNCH_BINARY;
+    config->python_interpreter = g_strdup("python3");
     config->max_concurrent_downloads = 3;
-    config->auto_start_downloads = FALSE;
+    config->adaptive_concurrency = FALSE;
+    config->adaptive_min_downloads = 1;
+    config->adaptive_max_downloads = 16;
+    config->adaptive_interval_seconds = 10;
+    config->adaptive_gain_percent = 5;
+    config->adaptive_error_backoff_percent = 50;
+    config->adaptive_flat_backoff_percent = 80;
+    config->queue_policy = QUEUE_POLICY_AGED_SJF;
+    config->aging_mib_per_minute = 256;
+    config->rate_limit_kib = 0;
+    config->native_downloads = TRUE;
+    config->native_connections = 4;
+    config->native_min_segment_mib = 4;
+    config->aria2_downloads = FALSE;
+    config->aria2_binary = g_strdup("aria2c");
+    config->aria2_port = 6801;
+    config->aria2_max_connections = 16;
+    config->aria2_connections_per_file = 4;
+    config->aria2_max_overall_kib = 0;
+    config->clip_parallel = 0;
+    config->clip_keep_source = FALSE;
+    config->format_max_height = 0;
+    config->format_min_fps = 0;
+    config->format_max_size_mib = 0;
+    config->format_prefer_smaller = FALSE;
+    config->use_cgroups = TRUE;
+    config->download_nice = 5;
+    config->processing_nice = 10;
+    config->download_cpu_weight = 100;
+    config->processing_cpu_weight = 25;
+    config->processing_cpu_max_percent = 0;
+    config->memory_max_mb = 0;
+    config->download_io_level = 4;
+    config->processing_io_level = 7;
+    config->download_io_weight = 100;
+    config->processing_io_weight = 10;
+    config->fragment_budget = 16;
+    config->max_fragments_per_item = 8;
+    config->http_chunk_size_kib = 10 * 1024;
+    config->buffer_size_kib = 0;
+    config->min_free_mb = 512;
+    config->unknown_size_mb = 256;
+    config->metadata_cache_size = 64;
+    config->quick_preview = TRUE;
+    config->quick_preview_timeout_ms = 2000;
+    config->prefetch_depth = 4;
+    config->interactive_workers = 2;
+    config->background_workers = 2;
+    config->stall_seconds = 120;
+    config->min_speed_kib = 0;
+    config->extract_seconds = 600;
+    config->kill_timeout_seconds = 5;
+    config->pause_mode = PAUSE_MODE_STOP;
+    config->max_retries = 2;
+    config->retry_backoff_seconds = 5;
+    config->ytdlp_retries = 10;
+    config->auto_check_updates = FALSE;
+
+    config->default_options.quality = QUALITY_BEST;
+    config->default_options.format = FORMAT_MP4;
+    config->default_options.embed_thumbnail = TRUE;
+}
+
+static int config_enum_from_string(const ConfigField *field, const char *value) {
+    for (int i = 0; field->names[i] != NULL; i++) {
+        if (g_ascii_strcasecmp(field->names[i], value) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Read a single field; invalid values are reported and the default is kept
+static void config_read_field(GKeyFile *keyfile, const ConfigField *field,
+                              AppConfig *config) {
+    if (!g_key_file_has_key(keyfile, field->group, field->key, NULL)) {
+        return;
+    }
+
+    gpointer member = G_STRUCT_MEMBER_P(config, field->offset);
+    GError *error = NULL;
+
+    switch (field->type) {
+        case CONFIG_TYPE_STRING: {
+            char *value = g_key_file_get_string(keyfile, field->group, field->key, &error);
+            if (value) {
+                // Empty strings fall back to the built-in default
+                char **target = member;
+                g_free(*target);
+                *target = NULL;
+                if (*value) {
+                    *target = value;
+                } else {
+                    g_free(value);
+                }
+            }
+            break;
+        }
+        case CONFIG_TYPE_STRING_LIST: {
+            char **value = g_key_file_get_string_list(keyfile, field->group, field->key,
+                                                      NULL, &error);
+            if (!error) {
+                char ***target = member;
+                g_strfreev(*target);
+                *target = value;
+            }
+            break;
+        }
+        case CONFIG_TYPE_INT: {
+            int value = g_key_file_get_integer(keyfile, field->group, field->key, &error);
+            if (!error) {
+                if (value < field->min || value > field->max) {
+                    g_warning("Config %s.%s=%d out of range [%d, %d], clamping",
+                              field->group, field->key, value, field->min, field->max);
+                }
+                *(int *)member = CLAMP(value, field->min, field->max);
+            }
+            break;
+        }
+        case CONFIG_TYPE_BOOLEAN: {
+            gboolean value = g_key_file_get_boolean(keyfile, field->group, field->key, &error);
+            if (!error) {
+                *(gboolean *)member = value;
+            }
+            break;
+        }
+        case CONFIG_TYPE_ENUM: {
+            char *value = g_key_file_get_string(keyfile, field->group, field->key, &error);
+            if (value) {
+                int index = config_enum_from_string(field, value);
+                if (index >= 0) {
+                    *(int *)member = index;
+                } else {
+                    g_warning("Config %s.%s: unknown value '%s'",
+                              field->group, field->key, value);
+                }
+                g_free(value);
+            }
+            break;
+        }
+    }
+
+    if (error) {
+        g_warning("Config %s.%s: %s", field->group, field->key, error->message);
+        g_error_free(error);
+    }
+}
+
+static void config_write_field(GKeyFile *keyfile, const ConfigField *field,
+                               AppConfig *config) {
+    gpointer member = G_STRUCT_MEMBER_P(config, field->offset);
+
+    switch (field->type) {
+        case CONFIG_TYPE_STRING: {
+            const char *value = *(char **)member;
+            g_key_file_set_string(keyfile, field->group, field->key, value ? value : "");
+            break;
+        }
+        case CONFIG_TYPE_STRING_LIST: {
+            char **value = *(char ***)member;
+            g_key_file_set_string_list(keyfile, field->group, field->key,
+                                       (const char * const *)value,
+                                       value ? g_strv_length(value) : 0);
+            break;
+        }
+        case CONFIG_TYPE_INT:
+            g_key_file_set_integer(keyfile, field->group, field->key, *(int *)member);
+            break;
+        case CONFIG_TYPE_BOOLEAN:
+            g_key_file_set_boolean(keyfile, field->group, field->key, *(gboolean *)member);
+            break;
+        case CONFIG_TYPE_ENUM:
+            g_key_file_set_string(keyfile, field->group, field->key,
+                                  field->names[*(int *)member]);
+            break;
+    }
+}
+
+char *config_get_path(void) {
+    return g_build_filename(g_get_user_config_dir(), CONFIG_DIR_NAME,
+                            CONFIG_FILE_NAME, NULL);
+}
+
+static const char * const day_names[] = {
+    "mon", "tue", "wed", "thu", "fri", "sat", "sun", NULL
+};
+
+static int day_from_string(const char *value) {
+    for (int i = 0; day_names[i] != NULL; i++) {
+        if (g_ascii_strncasecmp(value, day_names[i], 3) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// "HH:MM" to minutes after midnight, -1 if malformed
+static int minute_from_string(const char *value) {
+    int hour, minute;
+    if (!value || sscanf(value, "%d:%d", &hour, &minute) != 2 ||
+        hour < 0 || hour > 24 || minute < 0 || minute > 59 || hour * 60 + minute > 24 * 60) {
+        return -1;
+    }
+    return hour * 60 + minute;
+}
+
+// Days are given as names or ranges, e.g. "mon-fri;sun"
+static guint8 days_from_list(char **list, const char *group) {
+    guint8 days = 0;
+    for (int i = 0; list && list[i]; i++) {
+        char **range = g_strsplit(list[i], "-", 2);
+        int first = day_from_string(g_strstrip(range[0]));
+        int last = range[1] ? day_from_string(g_strstrip(range[1])) : first;
+
+        if (first < 0 || last < 0) {
+            g_warning("Config %s.days: unknown day '%s'", group, list[i]);
+        } else {
+            for (int d = first; ; d = (d + 1) % 7) {
+                days |= 1 << d;
+                if (d == last) break;
+            }
+        }
+        g_strfreev(range);
+    }
+    return days;
+}
+
+static int schedule_get_int(GKeyFile *keyfile, const char *group, const char *key,
+                            int min, int max) {
+    GError *error = NULL;
+    int value = g_key_file_get_integer(keyfile, group, key, &error);
+    if (error) {
+        if (!g_error_matches(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+            g_warning("Config %s.%s: %s", group, key, error->message);
+        }
+        g_error_free(error);
+        return -1;
+    }
+    return CLAMP(value, min, max);
+}
+
+// [schedule:NAME] groups are open-ended, so they are read outside the schema
+static void config_read_schedule(GKeyFile *keyfile, AppConfig *config) {
+    char **groups = g_key_file_get_groups(keyfile, NULL);
+    GArray *windows = g_array_new(FALSE, TRUE, sizeof(ScheduleWindow));
 
-    // TODO: Load from config file (e.g., ~/.config/youtube-dl-gtk/config.ini)
+    for (int i = 0; groups[i] != NULL; i++) {
+        if (!g_str_has_prefix(groups[i], SCHEDULE_GROUP_PREFIX)) continue;
 
+        const char *group = groups[i];
+        char *start = g_key_file_get_string(keyfile, group, "start", NULL);
+        char *end = g_key_file_get_string(keyfile, group, "end", NULL);
+        ScheduleWindow window = {
+            .start_minute = start ? minute_from_string(start) : 0,
+            .end_minute = end ? minute_from_string(end) : 24 * 60,
+        };
+        g_free(start);
+        g_free(end);
+
+        if (window.start_minute < 0 || window.end_minute < 0) {
+            g_warning("Config %s: start and end must be HH:MM, ignoring the window", group);
+            continue;
+        }
+
+        char **days = g_key_file_get_string_list(keyfile, group, "days", NULL, NULL);
+        window.days = days_from_list(days, group);
+        g_strfreev(days);
+
+        window.name = g_strdup(group + strlen(SCHEDULE_GROUP_PREFIX));
+        window.domains = g_key_file_get_string_list(keyfile, group, "domains", NULL, NULL);
+        window.max_downloads = schedule_get_int(keyfile, group, "max_downloads", 0, 64);
+        window.rate_limit_kib = schedule_get_int(keyfile, group, "rate_kib", 0, 10 * 1024 * 1024);
+        g_array_append_val(windows, window);
+    }
+
+    config->schedule_window_count = windows->len;
+    config->schedule_windows = (ScheduleWindow *)g_array_free(windows, FALSE);
+    g_strfreev(groups);
+}
+
+static void config_write_schedule(GKeyFile *keyfile, AppConfig *config) {
+    for (int i = 0; i < config->schedule_window_count; i++) {
+        ScheduleWindow *window = &config->schedule_windows[i];
+        char *group = g_strconcat(SCHEDULE_GROUP_PREFIX, window->name, NULL);
+
+        if (window->days != 0) {
+            const char *days[8];
+            gsize n = 0;
+            for (int d = 0; d < 7; d++) {
+                if (window->days & (1 << d)) days[n++] = day_names[d];
+            }
+            g_key_file_set_string_list(keyfile, group, "days", days, n);
+        }
+
+        char *start = g_strdup_printf("%02d:%02d", window->start_minute / 60, window->start_minute % 60);
+        char *end = g_strdup_printf("%02d:%02d", window->end_minute / 60, window->end_minute % 60);
+        g_key_file_set_string(keyfile, group, "start", start);
+        g_key_file_set_string(keyfile, group, "end", end);
+        g_free(start);
+        g_free(end);
+
+        if (window->domains) {
+            g_key_file_set_string_list(keyfile, group, "domains",
+                                       (const char * const *)window->domains,
+                                       g_strv_length(window->domains));
+        }
+        if (window->max_downloads >= 0) {
+            g_key_file_set_integer(keyfile, group, "max_downloads", window->max_downloads);
+        }
+        if (window->rate_limit_kib >= 0) {
+            g_key_file_set_integer(keyfile, group, "rate_kib", window->rate_limit_kib);
+        }
+        g_free(group);
+    }
+}
+
+// Parse config data on top of the defaults. Returns NULL if the data is not
+// a valid key file, so a half-written edit never clobbers a running config.
+static AppConfig *config_load_from_data(const char *data, gsize length, GError **error) {
+    GKeyFile *keyfile = g_key_file_new();
+
+    if (!g_key_file_load_from_data(keyfile, data, length, G_KEY_FILE_NONE, error)) {
+        g_key_file_free(keyfile);
+        return NULL;
+    }
+
+    AppConfig *config = g_malloc0(sizeof(AppConfig));
+    config_set_defaults(config);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(config_schema); i++) {
+        config_read_field(keyfile, &config_schema[i], config);
+    }
+    config_read_schedule(keyfile, config);
+
+    if (!config->default_download_path) {
+        config->default_download_path = g_strdup(g_get_home_dir());
+    }
+    if (!config->ytdlp_binary) {
+        config->ytdlp_binary = g_strdup("yt-dlp");
+    }
+    if (!config->aria2_binary) {
+        config->aria2_binary = g_strdup("aria2c");
+    }
+    if (!config->python_interpreter) {
+        config->python_interpreter = g_strdup("python3");
+    }
+
+    g_key_file_free(keyfile);
     return config;
 }
 
-void config_save(AppConfig *config) {
-    if (!config) return;
+AppConfig *config_load(void) {
+    char *path = config_get_path();
+    char *data = NULL;
+    gsize length = 0;
+    GError *error = NULL;
+    AppConfig *config = NULL;
+
+    if (g_file_get_contents(path, &data, &length, &error)) {
+        config = config_load_from_data(data, length, &error);
+        if (!config) {
+            g_warning("Failed to parse %s: %s", path, error->message);
+        }
+    } else if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+        g_warning("Failed to read %s: %s", path, error->message);
+    }
+
+    g_clear_error(&error);
+    g_free(data);
+    g_free(path);
+
+    if (!config) {
+        config = g_malloc0(sizeof(AppConfig));
+        config_set_defaults(config);
+    }
+
+    return config;
+}
+
+static void config_notify_watches(void) {
+    for (GList *l = config_watches; l != NULL; l = l->next) {
+        ConfigWatch *watch = l->data;
+        watch->func(shared_config, watch->user_data);
+    }
+}
+
+// Saving goes through g_file_set_contents(), which writes a temporary file
+// and renames it over the old one, so readers never see a partial config.
+gboolean config_save(AppConfig *config, GError **error) {
+    if (!config) return FALSE;
+
+    GKeyFile *keyfile = g_key_file_new();
+    for (gsize i = 0; i < G_N_ELEMENTS(config_schema); i++) {
+        config_write_field(keyfile, &config_schema[i], config);
+    }
+    config_write_schedule(keyfile, config);
 
-    // TODO: Save to config file
+    gsize length = 0;
+    char *data = g_key_file_to_data(keyfile, &length, NULL);
+    g_key_file_free(keyfile);
+
+    char *path = config_get_path();
+    char *dir = g_path_get_dirname(path);
+    gboolean ok = FALSE;
+
+    if (g_mkdir_with_parents(dir, 0700) != 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Failed to create %s: %s", dir, g_strerror(errno));
+    } else {
+        ok = g_file_set_contents(path, data, length, error);
+    }
+
+    if (ok && config == shared_config) {
+        // Remember what we wrote so the monitor doesn't reload our own save
+        g_free(last_written_data);
+        last_written_data = data;
+        data = NULL;
+        config_notify_watches();
+    }
+
+    g_free(data);
+    g_free(dir);
+    g_free(path);
+    return ok;
 }
 
 void config_free(AppConfig *config) {
     if (!config) return;
 
     g_free(config->default_download_path);
+    g_free(config->ytdlp_binary);
+    g_free(config->python_interpreter);
+    g_free(config->python_venv);
+    g_free(config->oembed_endpoint);
+    g_free(config->aria2_binary);
+    g_strfreev(config->interpreter_flags);
+    g_strfreev(config->output_roots);
+    g_strfreev(config->format_vcodecs);
+    g_strfreev(config->format_acodecs);
+    for (int i = 0; i < config->schedule_window_count; i++) {
+        g_free(config->schedule_windows[i].name);
+        g_strfreev(config->schedule_windows[i].domains);
+    }
+    g_free(config->schedule_windows);
+    g_free(config->default_options.custom_format);
+    g_free(config->default_options.time_range_start);
+    g_free(config->default_options.time_range_end);
+    g_free(config->default_options.output_template);
     g_free(config);
 }
+
+AppConfig *config_get(void) {
+    if (!shared_config) {
+        shared_config = config_load();
+    }
+    return shared_config;
+}
+
+guint config_add_watch(ConfigChangedFunc func, gpointer user_data) {
+    ConfigWatch *watch = g_malloc0(sizeof(ConfigWatch));
+    watch->id = next_watch_id++;
+    watch->func = func;
+    watch->user_data = user_data;
+    config_watches = g_list_append(config_watches, watch);
+    return watch->id;
+}
+
+void config_remove_watch(guint watch_id) {
+    for (GList *l = config_watches; l != NULL; l = l->next) {
+        ConfigWatch *watch = l->data;
+        if (watch->id == watch_id) {
+            config_watches = g_list_delete_link(config_watches, l);
+            g_free(watch);
+            return;
+        }
+    }
+}
+
+static gboolean config_reload_timeout(gpointer user_data) {
+    (void)user_data;
+    reload_timeout_id = 0;
+
+    char *path = config_get_path();
+    char *data = NULL;
+    gsize length = 0;
+    GError *error = NULL;
+
+    if (!g_file_get_contents(path, &data, &length, &error)) {
+        // Deleted or unreadable: keep running with what we have
+        g_clear_error(&error);
+        g_free(path);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (last_written_data && strcmp(data, last_written_data) == 0) {
+        g_free(data);
+        g_free(path);
+        return G_SOURCE_REMOVE;
+    }
+
+    AppConfig *config = config_load_from_data(data, length, &error);
+    if (config) {
+        g_print("Reloaded configuration from %s\n", path);
+        config_free(shared_config);
+        shared_config = config;
+        config_notify_watches();
+    } else {
+        g_warning("Ignoring invalid config %s: %s", path, error->message);
+        g_clear_error(&error);
+    }
+
+    g_free(data);
+    g_free(path);
+    return G_SOURCE_REMOVE;
+}
+
+static void on_config_file_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                   GFileMonitorEvent event, gpointer user_data) {
+    (void)monitor;
+    (void)file;
+    (void)other_file;
+    (void)user_data;
+
+    if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+        event != G_FILE_MONITOR_EVENT_CREATED) {
+        return;
+    }
+
+    // Editors and atomic renames emit bursts of events; reload once
+    if (reload_timeout_id > 0) {
+        g_source_remove(reload_timeout_id);
+    }
+    reload_timeout_id = g_timeout_add(CONFIG_RELOAD_DELAY_MS, config_reload_timeout, NULL);
+}
+
+void config_monitor_start(void) {
+    if (config_monitor) return;
+
+    config_get();
+
+    char *path = config_get_path();
+    GFile *file = g_file_new_for_path(path);
+    GError *error = NULL;
+
+    config_monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, &error);
+    if (config_monitor) {
+        g_signal_connect(config_monitor, "changed", G_CALLBACK(on_config_file_changed), NULL);
+    } else {
+        g_warning("Config live reload unavailable: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(file);
+    g_free(path);
+}
+
+void config_cleanup(void) {
+    if (reload_timeout_id > 0) {
+        g_source_remove(reload_timeout_id);
+        reload_timeout_id = 0;
+    }
+    g_clear_object(&config_monitor);
+    g_list_free_full(config_watches, g_free);
+    config_watches = NULL;
+    g_clear_pointer(&last_written_data, g_free);
+    g_clear_pointer(&shared_config, config_free);
+}
@@ -3,14 +3,174 @@
 
 #include "common.h"
 
+// How yt-dlp is started
+typedef enum {
+    YTDLP_LAUNCH_BINARY,        // ytdlp_binary is executed directly
+    YTDLP_LAUNCH_PYTHON_MODULE, // python -m yt_dlp
+    YTDLP_LAUNCH_ZIPAPP         // python <ytdlp_binary>, a zipapp or script
+} YtdlpLaunchMode;
+
+// Order in which queued downloads are started
+typedef enum {
+    QUEUE_POLICY_FIFO,          // In the order they were added
+    QUEUE_POLICY_SMALLEST_FIRST, // Least remaining bytes first
+    QUEUE_POLICY_AGED_SJF,      // Smallest first, waiting time counts against size
+    QUEUE_POLICY_PRIORITY,      // High, normal, low class, aged SJF within a class
+    QUEUE_POLICY_COUNT
+} QueuePolicy;
+
+// How a download is paused
+typedef enum {
+    PAUSE_MODE_STOP,            // SIGSTOP the process group, continue it later
+    PAUSE_MODE_TERMINATE        // End the process, restart it with --continue
+} PauseMode;
+
+// A time-of-day rule from a [schedule:NAME] group. While it is open, the
+// downloads it matches get its concurrency and rate limits.
+typedef struct {
+    char *name;
+    guint8 days;                    // Bit 0 = Monday, 0 = every day
+    int start_minute;               // Minutes after local midnight
+    int end_minute;                 // Exclusive; before start_minute wraps past midnight
+    char **domains;                 // Host suffixes, NULL = all downloads
+    int max_downloads;              // Matching downloads running at once, 0 = pause them, -1 = no limit
+    int rate_limit_kib;             // Per-download limit, 0 = unlimited, -1 = the item's own
+} ScheduleWindow;
+
 typedef struct {
+    // Paths
     char *default_download_path;
-    int max_concurrent_downloads;
-    gboolean auto_start_downloads;
+    char *ytdlp_binary;
+
+    // Launcher
+    YtdlpLaunchMode ytdlp_launch_mode;
+    char *python_interpreter;       // Name or path, ignored when python_venv is set
+    char *python_venv;              // Pinned virtualenv, its bin/python is used
+    char **interpreter_flags;       // Extra interpreter options, e.g. -I or -S
+
+    // Concurrency and ordering
+    QueuePolicy queue_policy;
+    int aging_mib_per_minute;       // Aged SJF: size credit per minute waited
+    int max_concurrent_downloads;   // Network stage
+    int max_concurrent_processing;  // Post-processing stage, 0 = CPU cores
+
+    // Adaptive network concurrency (AIMD), max_concurrent_downloads is the start value
+    gboolean adaptive_concurrency;
+    int adaptive_min_downloads;
+    int adaptive_max_downloads;
+    int adaptive_interval_seconds;  // Throughput is compared once per interval
+    int adaptive_gain_percent;      // Rise that counts as "still improving"
+    int adaptive_error_backoff_percent; // Limit kept after a 429/403 or stall
+    int adaptive_flat_backoff_percent;  // Limit kept when an increase didn't help
+
+    // Built-in HTTP downloader for direct media links
+    gboolean native_downloads;
+    int native_connections;         // Ranged requests per file
+    int native_min_segment_mib;     // Smaller files use fewer connections
+
+    // Shared aria2c daemon for resolved media URLs, driven over JSON-RPC
+    gboolean aria2_downloads;
+    char *aria2_binary;
+    int aria2_port;                 // RPC port on 127.0.0.1
+    int aria2_max_connections;      // All connections of the daemon together
+    int aria2_connections_per_file; // aria2 --split for each file
+    int aria2_max_overall_kib;      // Rate limit of the daemon in KiB/s, 0 = unlimited
+
+    // Cutting clips from a downloaded source
+    int clip_parallel;              // ffmpeg cuts at once, 0 = one per CPU
+    gboolean clip_keep_source;
+
+    // Format selection rules, applied once the format list is known
+    char **format_vcodecs;          // Preferred video codecs, best first ("av01", "vp9")
+    char **format_acodecs;          // Preferred audio codecs, best first
+    int format_max_height;          // 0 = only the quality option caps it
+    int format_min_fps;             // 0 = any frame rate
+    int format_max_size_mib;        // Video and audio together, 0 = no budget
+    gboolean format_prefer_smaller; // At equal resolution the smaller stream wins
+
+    // Rate limits
+    int rate_limit_kib;             // Per-download limit in KiB/s, 0 = unlimited
+
+    // Resource control per stage (download / post-processing)
+    gboolean use_cgroups;           // Use a delegated cgroup v2 subtree when available
+    int download_nice;
+    int processing_nice;            // Only raised, never lowered, without privileges
+    int download_cpu_weight;        // cgroup cpu.weight, 1-10000
+    int processing_cpu_weight;
+    int processing_cpu_max_percent; // Share of all cores, 0 = unlimited
+    int memory_max_mb;              // Per stage cgroup or per process, 0 = unlimited
+    int download_io_level;          // Best-effort IO priority, 0 (high) to 7 (low)
+    int processing_io_level;
+    int download_io_weight;         // cgroup io.weight, 1-10000
+    int processing_io_weight;
+
+    // Fragment downloading (DASH/HLS)
+    int fragment_budget;            // Parallel fragments shared by all running items
+    int max_fragments_per_item;
+    int http_chunk_size_kib;        // 0 = not chunked
+    int buffer_size_kib;            // 0 = yt-dlp default
+
+    // Storage planning
+    char **output_roots;            // Extra volumes new downloads may spread to
+    int min_free_mb;                // Space always kept free on every volume
+    int unknown_size_mb;            // Reservation when the size is not known
+
+    // Cache sizes
+    int metadata_cache_size;        // Number of cached metadata entries
+
+    // Quick first preview from oEmbed or page metadata, before yt-dlp answers
+    gboolean quick_preview;
+    int quick_preview_timeout_ms;
+    char *oembed_endpoint;          // Used for every URL instead of the provider's, e.g. a local stand-in
+
+    // Metadata prefetch for queued items
+    int prefetch_depth;             // Queued items looked up ahead, 0 = off
+
+    // Helper threads for lookups and thumbnails, per lane
+    int interactive_workers;        // Preview of the entered URL
+    int background_workers;         // Prefetches and queued items' thumbnails, niced
+
+    // Stall watchdog
+    int stall_seconds;              // No new bytes for this long kills the item, 0 = off
+    int min_speed_kib;              // Average over a stall window below this kills, 0 = off
+    int extract_seconds;            // Silence before the first bytes that kills, 0 = off
+
+    // Cancellation and pausing
+    int kill_timeout_seconds;       // SIGTERM grace period before the group is killed
+    PauseMode pause_mode;
+
+    // Download windows, in file order; the first open match applies
+    ScheduleWindow *schedule_windows;
+    int schedule_window_count;
+
+    // Retry policy
+    int max_retries;                // Scheduler-level restarts of a failed item
+    int retry_backoff_seconds;      // Base delay, doubled on every attempt
+    int ytdlp_retries;              // Passed to yt-dlp --retries
+
+    // Updates
+    gboolean auto_check_updates;
+
+    // Defaults applied to new downloads
+    DownloadOptions default_options;
 } AppConfig;
 
+typedef void (*ConfigChangedFunc)(AppConfig *config, gpointer user_data);
+
 AppConfig *config_load(void);
-void config_save(AppConfig *config);
+gboolean config_save(AppConfig *config, GError **error);
 void config_free(AppConfig *config);
+char *config_get_path(void);
+
+// Shared instance, owned by the config module (main thread only).
+// Never keep the pointer across main loop iterations: a reload replaces it.
+AppConfig *config_get(void);
+
+// Live reload: watchers are called on the main thread whenever the shared
+// instance changes, either from config_save() or an external file edit.
+guint config_add_watch(ConfigChangedFunc func, gpointer user_data);
+void config_remove_watch(guint watch_id);
+void config_monitor_start(void);
+void config_cleanup(void);
 
 #endif
@@ -0,0 +1,152 @@
+#include <glib.h>
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+// Local stand-in for oEmbed endpoints, video pages and media hosts, serving
+// recorded responses so the quick preview (src/core/quick_preview.c) and the
+// native downloader (src/core/http_backend.c) can be tested offline. Point
+// the preview at it with
+//
+//   [preview]
+//   oembed_endpoint=http://127.0.0.1:8088/oembed
+//
+// Layout of the responses directory:
+//   oembed/<key>.json   answer for /oembed?url=<url>, where <key> is the URL
+//                       with every character other than [A-Za-z0-9] replaced
+//                       by '_'; oembed/default.json is used when missing,
+//                       and 404 is returned when neither exists
+//   anything else       served as a static file, e.g. recorded pages
+//                       (http://127.0.0.1:8088/watch.html), thumbnails and
+//                       media (http://127.0.0.1:8088/clip.mp4); Range
+//                       requests are answered with 206 by libsoup
+//
+// A missing oEmbed answer makes the app fall back to the page itself.
+// --no-ranges answers every request in full, for the single-connection path.
+
+static int opt_port = 8088;
+static int opt_delay_ms = 0;
+static gboolean opt_no_ranges = FALSE;
+static char *opt_dir = NULL;
+
+static GOptionEntry entries[] = {
+    { "port", 'p', 0, G_OPTION_ARG_INT, &opt_port, "Port on 127.0.0.1", "PORT" },
+    { "dir", 'd', 0, G_OPTION_ARG_FILENAME, &opt_dir, "Recorded responses", "DIR" },
+    { "delay-ms", 0, 0, G_OPTION_ARG_INT, &opt_delay_ms, "Delay before every answer", "MS" },
+    { "no-ranges", 0, 0, G_OPTION_ARG_NONE, &opt_no_ranges, "Ignore Range headers", NULL },
+    { NULL }
+};
+
+static char *oembed_key(const char *url) {
+    char *key = g_strdup(url);
+    for (char *p = key; *p; p++) {
+        if (!g_ascii_isalnum(*p)) *p = '_';
+    }
+    return key;
+}
+
+static void serve_file(SoupServerMessage *msg, const char *path) {
+    char *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(path, &contents, &length, NULL)) {
+        soup_server_message_set_status(msg, SOUP_STATUS_NOT_FOUND, NULL);
+        return;
+    }
+
+    char *content_type = g_content_type_guess(path, (const guchar *)contents, length, NULL);
+    char *mime_type = g_content_type_get_mime_type(content_type);
+
+    soup_server_message_set_status(msg, SOUP_STATUS_OK, NULL);
+    soup_server_message_set_response(msg, mime_type ? mime_type : "application/octet-stream",
+                                     SOUP_MEMORY_TAKE, contents, length);
+    g_free(mime_type);
+    g_free(content_type);
+}
+
+static void serve_oembed(SoupServerMessage *msg, GHashTable *query) {
+    const char *url = query ? g_hash_table_lookup(query, "url") : NULL;
+    if (!url) {
+        soup_server_message_set_status(msg, SOUP_STATUS_BAD_REQUEST, NULL);
+        return;
+    }
+
+    char *key = oembed_key(url);
+    char *name = g_strconcat(key, ".json", NULL);
+    char *path = g_build_filename(opt_dir, "oembed", name, NULL);
+
+    if (!g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+        g_free(path);
+        path = g_build_filename(opt_dir, "oembed", "default.json", NULL);
+    }
+    serve_file(msg, path);
+
+    g_print("oembed %s -> %u\n", url, soup_server_message_get_status(msg));
+    g_free(path);
+    g_free(name);
+    g_free(key);
+}
+
+static void handle_request(SoupServer *server, SoupServerMessage *msg, const char *path,
+                           GHashTable *query, gpointer user_data) {
+    (void)server;
+    (void)user_data;
+
+    if (opt_delay_ms > 0) {
+        g_usleep((gulong)opt_delay_ms * 1000);
+    }
+
+    if (strcmp(soup_server_message_get_method(msg), SOUP_METHOD_GET) != 0) {
+        soup_server_message_set_status(msg, SOUP_STATUS_NOT_IMPLEMENTED, NULL);
+        return;
+    }
+
+    if (strcmp(path, "/oembed") == 0) {
+        serve_oembed(msg, query);
+        return;
+    }
+
+    if (opt_no_ranges) {
+        soup_message_headers_remove(soup_server_message_get_request_headers(msg), "Range");
+    }
+
+    if (strstr(path, "..")) {
+        soup_server_message_set_status(msg, SOUP_STATUS_FORBIDDEN, NULL);
+        return;
+    }
+
+    char *file = g_build_filename(opt_dir, path, NULL);
+    serve_file(msg, file);
+    g_print("GET %s -> %u\n", path, soup_server_message_get_status(msg));
+    g_free(file);
+}
+
+int main(int argc, char **argv) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- serve recorded preview responses and media");
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    if (!opt_dir) {
+        g_printerr("--dir is required\n");
+        return 2;
+    }
+
+    SoupServer *server = soup_server_new(NULL, NULL);
+    soup_server_add_handler(server, NULL, handle_request, NULL, NULL);
+
+    if (!soup_server_listen_local(server, opt_port, SOUP_SERVER_LISTEN_IPV4_ONLY, &error)) {
+        g_printerr("Can't listen on port %d: %s\n", opt_port, error->message);
+        return 1;
+    }
+    g_print("Serving %s on http://127.0.0.1:%d\n", opt_dir, opt_port);
+
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_main_loop_run(loop);
+    return 0;
+}
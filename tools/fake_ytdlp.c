@@ -0,0 +1,180 @@
+// Stand-in for yt-dlp used by the load harness and for manual testing.
+// Point the configured binary ([paths] ytdlp_binary) at it to exercise the
+// engine and scheduler without network access.
+//
+// Behaviour is controlled through environment variables:
+//   FAKE_YTDLP_LINES          progress lines per file (default 50)
+//   FAKE_YTDLP_INTERVAL_MS    delay between progress lines (default 20)
+//   FAKE_YTDLP_SIZE_MIB       reported size of the video stream (default 100)
+//   FAKE_YTDLP_FAIL_RATE      probability of failing mid-download (0..1)
+//   FAKE_YTDLP_STALL_RATE     probability of going silent mid-download (0..1)
+//   FAKE_YTDLP_STALL_SECONDS  length of a stall (default 3600)
+//   FAKE_YTDLP_MERGE_MS       duration of the simulated merge step (default 0,
+//                             no post-processing)
+//   FAKE_YTDLP_METADATA       file printed for --dump-json instead of the
+//                             built-in document
+//   FAKE_YTDLP_SEED           random seed (default: pid and time)
+//
+// Plain C without GLib so that thousands of instances stay cheap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static int env_int(const char *name, int fallback) {
+    const char *value = getenv(name);
+    return value && *value ? atoi(value) : fallback;
+}
+
+static double env_double(const char *name, double fallback) {
+    const char *value = getenv(name);
+    return value && *value ? atof(value) : fallback;
+}
+
+static double random_unit(void) {
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+// One of the intermediate progress lines, -1 if there are none
+static int random_line(int lines) {
+    return lines > 1 ? 1 + rand() % (lines - 1) : -1;
+}
+
+static void sleep_ms(int ms) {
+    if (ms <= 0) return;
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static const char *failure_messages[] = {
+    "ERROR: unable to download video data: HTTP Error 403: Forbidden",
+    "ERROR: [youtube] fake: Unable to download webpage: HTTP Error 429: Too Many Requests",
+    "ERROR: unable to download video data: <urlopen error [Errno 104] Connection reset by peer>",
+    "ERROR: [youtube] fake: Video unavailable",
+};
+
+static int dump_json(const char *url) {
+    const char *path = getenv("FAKE_YTDLP_METADATA");
+
+    if (path && *path) {
+        FILE *file = fopen(path, "r");
+        if (!file) {
+            fprintf(stderr, "ERROR: cannot open %s\n", path);
+            return 1;
+        }
+        char buffer[8192];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            fwrite(buffer, 1, n, stdout);
+        }
+        fclose(file);
+        return 0;
+    }
+
+    int size_mib = env_int("FAKE_YTDLP_SIZE_MIB", 100);
+    printf("{\"id\": \"fake\", \"title\": \"Fake video\", \"uploader\": \"fake-ytdlp\", "
+           "\"duration\": 600, \"webpage_url\": \"%s\", \"thumbnail\": null, "
+           "\"formats\": ["
+           "{\"format_id\": \"137\", \"ext\": \"mp4\", \"vcodec\": \"avc1\", \"acodec\": \"none\", "
+           "\"width\": 1920, \"height\": 1080, \"fps\": 30, \"filesize\": %lld}, "
+           "{\"format_id\": \"140\", \"ext\": \"m4a\", \"vcodec\": \"none\", \"acodec\": \"mp4a\", "
+           "\"filesize\": %lld}]}\n",
+           url, (long long)size_mib * 1024 * 1024, (long long)size_mib * 1024 * 64);
+    return 0;
+}
+
+// Emit one file's progress. Returns non-zero if the run should end with
+// that exit code (a simulated failure).
+static int download_file(const char *name, double size_mib, int lines, int interval_ms,
+                         double fail_rate, double stall_rate, int stall_seconds) {
+    int fail_at = random_unit() < fail_rate ? random_line(lines) : -1;
+    int stall_at = random_unit() < stall_rate ? random_line(lines) : -1;
+
+    printf("[download] Destination: %s\n", name);
+    printf("[download]   0.0%% of %10.2fMiB at  Unknown B/s ETA Unknown\n", size_mib);
+    fflush(stdout);
+
+    for (int i = 1; i < lines; i++) {
+        sleep_ms(interval_ms);
+
+        if (i == stall_at) {
+            sleep(stall_seconds);
+        }
+        if (i == fail_at) {
+            printf("%s\n", failure_messages[rand() % (sizeof(failure_messages) /
+                                                      sizeof(failure_messages[0]))]);
+            fflush(stdout);
+            return 1;
+        }
+
+        double percent = 100.0 * i / lines;
+        double speed = 1.0 + random_unit() * 10.0;
+        int eta = (int)((100.0 - percent) / 100.0 * size_mib / speed);
+        printf("[download] %5.1f%% of %10.2fMiB at %7.2fMiB/s ETA %02d:%02d\n",
+               percent, size_mib, speed, eta / 60, eta % 60);
+        fflush(stdout);
+    }
+
+    printf("[download] 100%% of %10.2fMiB in 00:00:%02d at 5.00MiB/s\n",
+           size_mib, (lines * interval_ms / 1000) % 60);
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *url = argc > 1 ? argv[argc - 1] : "";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--version") == 0) {
+            printf("2099.01.01-fake\n");
+            return 0;
+        }
+        if (strcmp(argv[i], "-U") == 0 || strcmp(argv[i], "--update") == 0) {
+            printf("Latest version: 2099.01.01-fake\nyt-dlp is up to date (2099.01.01-fake)\n");
+            return 0;
+        }
+    }
+
+    unsigned seed = (unsigned)env_int("FAKE_YTDLP_SEED", 0);
+    srand(seed ? seed : (unsigned)getpid() ^ (unsigned)time(NULL));
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dump-json") == 0 || strcmp(argv[i], "-j") == 0) {
+            return dump_json(url);
+        }
+    }
+
+    int lines = env_int("FAKE_YTDLP_LINES", 50);
+    int interval_ms = env_int("FAKE_YTDLP_INTERVAL_MS", 20);
+    double size_mib = env_double("FAKE_YTDLP_SIZE_MIB", 100);
+    double fail_rate = env_double("FAKE_YTDLP_FAIL_RATE", 0);
+    double stall_rate = env_double("FAKE_YTDLP_STALL_RATE", 0);
+    int stall_seconds = env_int("FAKE_YTDLP_STALL_SECONDS", 3600);
+    int merge_ms = env_int("FAKE_YTDLP_MERGE_MS", 0);
+
+    if (lines < 1) lines = 1;
+
+    printf("[generic] Extracting URL: %s\n", url);
+    printf("[info] fake: Downloading 1 format(s): 137+140\n");
+    fflush(stdout);
+
+    // Video and audio streams, like a bestvideo+bestaudio selection
+    if (download_file("Fake video [fake].f137.mp4", size_mib, lines, interval_ms,
+                      fail_rate, stall_rate, stall_seconds) ||
+        download_file("Fake video [fake].f140.m4a", size_mib / 16, lines / 4 + 1, interval_ms,
+                      fail_rate / 4, 0, stall_seconds)) {
+        return 1;
+    }
+
+    if (merge_ms > 0) {
+        printf("[Merger] Merging formats into \"Fake video [fake].mp4\"\n");
+        fflush(stdout);
+        sleep_ms(merge_ms);
+        printf("Deleting original file Fake video [fake].f137.mp4 (pass -k to keep)\n");
+        printf("Deleting original file Fake video [fake].f140.m4a (pass -k to keep)\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include "common.h"
+#include "core/download_engine.h"
+#include "core/metrics.h"
+#include "core/process_manager.h"
+#include "utils/config.h"
+#include <dirent.h>
+#include <sys/resource.h>
+
+// End-to-end load test for the download engine and scheduler. Queues
+// thousands of downloads against the fake yt-dlp (tools/fake_ytdlp.c) and
+// reports main-loop latency, CPU per download, memory growth, and leaked
+// file descriptors or zombie processes. Runs entirely offline.
+//
+// The fake's behaviour is set through its FAKE_YTDLP_* environment
+// variables, which are inherited by every spawned process.
+
+#define PROBE_INTERVAL_MS 10
+#define PROGRESS_INTERVAL_MS 1000
+
+static int opt_downloads = 1000;
+static int opt_concurrency = 16;
+static int opt_retries = 0;
+static char *opt_binary = NULL;
+
+static GOptionEntry entries[] = {
+    { "downloads", 'n', 0, G_OPTION_ARG_INT, &opt_downloads, "Downloads to queue", "N" },
+    { "concurrency", 'c', 0, G_OPTION_ARG_INT, &opt_concurrency, "Network slots", "N" },
+    { "retries", 'r', 0, G_OPTION_ARG_INT, &opt_retries, "Scheduler retries per item", "N" },
+    { "binary", 'b', 0, G_OPTION_ARG_FILENAME, &opt_binary, "yt-dlp stand-in to run", "PATH" },
+    { NULL }
+};
+
+typedef struct {
+    GMainLoop *loop;
+    GPtrArray *items;
+    GArray *latencies;          // Main loop wake-up delays in microseconds
+    gint64 last_probe;
+    gint64 start_time;
+    long peak_rss_kib;
+} Harness;
+
+static long current_rss_kib(void) {
+    long pages = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if (statm) {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(statm);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int open_fd_count(void) {
+    DIR *dir = opendir("/proc/self/fd");
+    int count = 0;
+
+    if (!dir) return -1;
+    for (struct dirent *entry; (entry = readdir(dir)) != NULL;) {
+        if (entry->d_name[0] != '.') count++;
+    }
+    closedir(dir);
+    return count - 1;  // The descriptor of the listing itself
+}
+
+// Children of this process that have exited but were never reaped
+static int zombie_count(void) {
+    DIR *dir = opendir("/proc");
+    int zombies = 0;
+    pid_t self = getpid();
+
+    if (!dir) return -1;
+    for (struct dirent *entry; (entry = readdir(dir)) != NULL;) {
+        if (!g_ascii_isdigit(entry->d_name[0])) continue;
+
+        char *path = g_build_filename("/proc", entry->d_name, "stat", NULL);
+        char *contents = NULL;
+        if (g_file_get_contents(path, &contents, NULL, NULL)) {
+            // "pid (comm) state ppid ...", comm may contain spaces
+            const char *rest = strrchr(contents, ')');
+            char state;
+            int ppid;
+            if (rest && sscanf(rest + 1, " %c %d", &state, &ppid) == 2 &&
+                ppid == self && state == 'Z') {
+                zombies++;
+            }
+        }
+        g_free(contents);
+        g_free(path);
+    }
+    closedir(dir);
+    return zombies;
+}
+
+static double timeval_ms(struct timeval tv) {
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int compare_int64(gconstpointer a, gconstpointer b) {
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+// Fires every PROBE_INTERVAL_MS; any extra delay is time the main loop
+// spent busy with engine or scheduler work
+static gboolean latency_probe(gpointer user_data) {
+    Harness *harness = user_data;
+    gint64 now = g_get_monotonic_time();
+    gint64 delay = now - harness->last_probe - PROBE_INTERVAL_MS * 1000;
+
+    g_array_append_val(harness->latencies, delay);
+    harness->last_probe = now;
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean is_terminal(DownloadItem *item) {
+    return item->status == DOWNLOAD_STATUS_COMPLETED ||
+           item->status == DOWNLOAD_STATUS_FAILED ||
+           item->status == DOWNLOAD_STATUS_CANCELLED;
+}
+
+static gboolean progress_check(gpointer user_data) {
+    Harness *harness = user_data;
+    guint finished = 0;
+
+    for (guint i = 0; i < harness->items->len; i++) {
+        if (is_terminal(g_ptr_array_index(harness->items, i))) finished++;
+    }
+
+    harness->peak_rss_kib = MAX(harness->peak_rss_kib, current_rss_kib());
+    g_print("\r%u/%u finished, %u active", finished, harness->items->len,
+            g_list_length(process_manager_get_all()));
+
+    if (finished == harness->items->len) {
+        g_print("\n");
+        g_main_loop_quit(harness->loop);
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void configure(const char *binary, const char *output_dir) {
+    AppConfig *config = config_get();
+
+    g_free(config->ytdlp_binary);
+    config->ytdlp_binary = g_strdup(binary);
+    g_free(config->default_download_path);
+    config->default_download_path = g_strdup(output_dir);
+
+    config->max_concurrent_downloads = opt_concurrency;
+    config->max_retries = opt_retries;
+    config->retry_backoff_seconds = 0;
+    config->min_free_mb = 0;
+    config->unknown_size_mb = 0;
+}
+
+static void report(Harness *harness, long rss_before) {
+    double wall = (g_get_monotonic_time() - harness->start_time) / (double)G_USEC_PER_SEC;
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+
+    int n = harness->items->len;
+    int completed = 0, failed = 0;
+    for (int i = 0; i < n; i++) {
+        DownloadItem *item = g_ptr_array_index(harness->items, i);
+        if (item->status == DOWNLOAD_STATUS_COMPLETED) completed++;
+        if (item->status == DOWNLOAD_STATUS_FAILED) failed++;
+    }
+
+    GArray *latencies = harness->latencies;
+    g_array_sort(latencies, compare_int64);
+    gint64 p50 = 0, p99 = 0, max = 0;
+    if (latencies->len > 0) {
+        p50 = g_array_index(latencies, gint64, latencies->len / 2);
+        p99 = g_array_index(latencies, gint64, latencies->len * 99 / 100);
+        max = g_array_index(latencies, gint64, latencies->len - 1);
+    }
+
+    g_print("Downloads:        %d (%d completed, %d failed) in %.1f s\n",
+            n, completed, failed, wall);
+    g_print("Main loop delay:  p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+            p50 / 1000.0, p99 / 1000.0, max / 1000.0);
+    g_print("CPU / download:   %.3f ms engine, %.3f ms yt-dlp\n",
+            (timeval_ms(self.ru_utime) + timeval_ms(self.ru_stime)) / n,
+            (timeval_ms(children.ru_utime) + timeval_ms(children.ru_stime)) / n);
+    g_print("Memory:           %ld KiB before, %ld KiB peak, %ld KiB after\n",
+            rss_before, harness->peak_rss_kib, current_rss_kib());
+    g_print("Retries:          %" G_GUINT64_FORMAT "\n", metrics_counter_get(METRIC_RETRIES));
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- load test the download engine");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    // Private config and output directories: nothing from the user's setup
+    // leaks into the run, and nothing from the run into the user's setup
+    char *work_dir = g_dir_make_tmp("datareel-load-XXXXXX", &error);
+    if (!work_dir) {
+        g_printerr("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    g_setenv("XDG_CONFIG_HOME", work_dir, TRUE);
+    configure(opt_binary ? opt_binary : FAKE_YTDLP_PATH, work_dir);
+
+    Harness harness = { 0 };
+    harness.loop = g_main_loop_new(NULL, FALSE);
+    harness.items = g_ptr_array_new_with_free_func((GDestroyNotify)download_item_free);
+    harness.latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+    long rss_before = current_rss_kib();
+    int fds_before = open_fd_count();
+    harness.peak_rss_kib = rss_before;
+
+    process_manager_init();
+
+    harness.start_time = g_get_monotonic_time();
+    for (int i = 0; i < opt_downloads; i++) {
+        char *url = g_strdup_printf("https://example.invalid/video/%d", i);
+        DownloadOptions *opts = g_malloc0(sizeof(DownloadOptions));
+        DownloadItem *item = download_item_new(url, work_dir, opts);
+        g_ptr_array_add(harness.items, item);
+        process_manager_add(item);
+        g_free(url);
+    }
+
+    harness.last_probe = g_get_monotonic_time();
+    g_timeout_add(PROBE_INTERVAL_MS, latency_probe, &harness);
+    g_timeout_add(PROGRESS_INTERVAL_MS, progress_check, &harness);
+    g_main_loop_run(harness.loop);
+
+    report(&harness, rss_before);
+
+    process_manager_cleanup();
+    g_ptr_array_free(harness.items, TRUE);
+
+    int leaked_fds = open_fd_count() - fds_before;
+    int zombies = zombie_count();
+    g_print("Leaked fds:       %d\nZombies:          %d\n", leaked_fds, zombies);
+
+    g_array_free(harness.latencies, TRUE);
+    g_main_loop_unref(harness.loop);
+    g_rmdir(work_dir);
+    g_free(work_dir);
+
+    return leaked_fds > 0 || zombies > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}